@@ -1,114 +1,796 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 #include <unistd.h>
+#include <time.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/mman.h>
 
 
 struct block_meta
 {
   size_t size;
-  struct block_meta *next;
+  struct block_meta *prev_free;  // 所在空闲链表的前后块 (仅空闲时有效)
+  struct block_meta *next_free;
   int free;
-}; 
+};
 
-#define META_SIZE sizeof(struct block_meta) // sizeof(struct block_meta) = 24
+// 边界标记: 每块内容之后再记录一次 size, 释放时由此找到物理上的前一块
+struct block_footer
+{
+  size_t size;
+};
+
+// 每次 mmap 得到的一块 ARENA_SIZE 的内存: [heap_arena][哨兵头块][块 ...][哨兵尾块][未使用]
+struct heap_arena
+{
+  struct heap_arena *next;
+  struct block_meta *epilogue; // 哨兵尾块, 向后切出新块时被新块覆盖
+  char *end;
+};
+
+#define META_SIZE    sizeof(struct block_meta)   // sizeof(struct block_meta) = 32
+#define FOOTER_SIZE  sizeof(struct block_footer) // sizeof(struct block_footer) = 8
+#define ARENA_HEADER_SIZE sizeof(struct heap_arena)
+
+/*
+  空闲块按大小分类 (size class) 挂在各自的链表上:
+  - 不超过 SMALL_MAX 的请求按 ALIGNMENT 取整, 每个取整后的大小一类, 链表中的块大小全部相同;
+  - 更大的请求按 2 的幂分类, [2^k, 2^(k+1)) 为一类;
+  - bin_map 记录哪些链表非空, 分配时取第一个能容纳 size 的非空链表的头, 不再遍历所有块
+  分配到的块多出的部分切分成新的空闲块; 释放时借助前一块的 footer 与后一块的头,
+  常数时间内与物理上相邻的空闲块合并, 因此不会有两个相邻的空闲块。
+  arena 中已使用部分的首尾各有一个 size 为 0、不空闲的哨兵块, 合并不会越过 arena 的边界
+*/
+#define ALIGNMENT         8
+#define SMALL_MAX         512
+#define NUM_SMALL_CLASSES (SMALL_MAX / ALIGNMENT)
+#define NUM_LARGE_CLASSES 40
+#define NUM_CLASSES       (NUM_SMALL_CLASSES + NUM_LARGE_CLASSES)
+#define BIN_MAP_WORDS     ((NUM_CLASSES + 63) / 64)
+#define MIN_SPLIT_SIZE    (META_SIZE + FOOTER_SIZE + ALIGNMENT) // 切出的空闲块至少要能放下的大小
+
+/*
+  内存全部来自 mmap, 不使用 sbrk:
+  - 中心堆由若干 ARENA_SIZE 的 arena 组成 (MAP_NORESERVE, 只有用到的页才占用物理内存),
+    新块从最后一个 arena 的哨兵尾块处切出, 放不下时再映射一个 arena;
+  - 不小于 MMAP_THRESHOLD 的请求单独映射, free 为 BLOCK_MMAPPED, 释放时直接 munmap;
+  - 合并后不小于 RELEASE_THRESHOLD 的空闲块, 内容中完整的页用 madvise(MADV_DONTNEED) 还给操作系统,
+    再次使用时由内核补零页。这样的块都已释放过, 合并时只需处理原先未释放的部分
+*/
+#define ARENA_SIZE         (64UL << 20)
+#define MMAP_THRESHOLD     (128UL << 10)
+#define RELEASE_THRESHOLD  (64UL << 10)
+#define BLOCK_MMAPPED      3
+
+/*
+  不超过 SLAB_MAX 的小对象由 slab 分配, 对象没有 struct block_meta 头:
+  - slab 是 SLAB_SIZE 对齐的 SLAB_SIZE 内存, 开头为 struct slab, 之后是同一大小的对象;
+  - 对象的地址按 SLAB_SIZE 向下对齐即得到所在的 slab, 对象大小记录在 slab 中;
+  - 所有 slab 都从一段预留的地址空间 [slab_base, slab_end) 中切出, 由地址即可判断是否为 slab 对象;
+  - slab 内从未分配过的对象按顺序切出, 释放的对象挂在 slab 的空闲链表上 (链接指针存放在对象内容中);
+  - 还有空闲对象的 slab 挂在所属大小类的 partial_slabs 上; 对象全部释放后,
+    若该类还有其他可用的 slab, 就把它的页还给操作系统, 放入 free_slabs 供任意大小类复用
+  slab 的状态与中心堆一样由 heap_lock 保护
+*/
+#define SLAB_MAX          128
+#define NUM_SLAB_CLASSES  (SLAB_MAX / ALIGNMENT)
+#define SLAB_SIZE         (64UL << 10)
+#define SLAB_REGION_SIZE  (4UL << 30)
+
+struct slab
+{
+  size_t object_size;
+  int index;                // 大小类
+  int num_used;             // 已分配出去的对象数 (包括线程缓存中的)
+  char *unused;             // 从未分配过的对象从这里开始
+  void *free_list;          // 释放回来的对象
+  struct slab *prev;        // partial_slabs 或 free_slabs 中的前后 slab
+  struct slab *next;
+};
 
-void *global_base = NULL;
+#define SLAB_HEADER_SIZE  ((sizeof(struct slab) + ALIGNMENT - 1) & ~(ALIGNMENT - 1))
+
+/*
+  线程缓存 (tcache): 每个线程为每个小块类保留一个单链表, 链接指针存放在块的内容中:
+  - 分配先从本线程的链表取, 不加锁; 链表为空时加锁从 slab 或中心堆一次取 TCACHE_BATCH 块;
+  - 释放 (包括释放其他线程分配的块) 先放入本线程的链表, 超过 TCACHE_COUNT 块时
+    加锁一次把 TCACHE_BATCH 块还给所在的 slab 或中心堆; 线程退出时全部归还;
+  - 缓存中带头部的块 free 为 BLOCK_CACHED, 对中心堆而言仍是已分配的, 不参与合并
+  中心堆 (上面的空闲链表与各个 arena) 由 heap_lock 保护
+*/
+#define TCACHE_COUNT  64
+#define TCACHE_BATCH  16
+#define BLOCK_CACHED  2
+
+struct tcache_entry
+{
+  struct tcache_entry *next;
+};
+
+struct thread_cache
+{
+  struct tcache_entry *bins[NUM_SMALL_CLASSES];
+  int counts[NUM_SMALL_CLASSES];
+  int registered; // 已注册线程退出时的归还
+};
+
+void *global_base = NULL;                             // 第一个 arena
+struct heap_arena *last_arena = NULL;                 // 最后一个 arena, 新块从它的哨兵尾块处切出
+struct block_meta *free_bins[NUM_CLASSES];            // 各大小类的空闲链表
+uint64_t bin_map[BIN_MAP_WORDS];                      // 第 i 位为 1 表示 free_bins[i] 非空
+pthread_mutex_t heap_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_key_t tcache_key;
+pthread_once_t tcache_key_once = PTHREAD_ONCE_INIT;
+__thread struct thread_cache tcache;
+char *slab_base = NULL;                               // 预留给 slab 的地址空间
+char *slab_end = NULL;
+char *slab_top = NULL;                                // 尚未用过的部分从这里开始
+struct slab *partial_slabs[NUM_SLAB_CLASSES];         // 各大小类中还有空闲对象的 slab
+struct slab *free_slabs = NULL;                       // 对象全部释放、页已归还的 slab
 
 
-struct block_meta *find_free_block(struct block_meta **last, size_t size);  /* 按地址序, 搜索满足条件的空闲块 */
-struct block_meta *request_space(struct block_meta *last, size_t size);     /* 申请内存 */
+size_t align_size(size_t size);                                             /* 按 ALIGNMENT 取整 */
+int size_class(size_t size);                                                /* 计算大小所属的类 */
+void bin_insert(struct block_meta *block);                                  /* 空闲块放入对应链表 */
+void bin_remove(struct block_meta *block);                                  /* 空闲块移出所在链表 */
+struct block_footer *get_footer(struct block_meta *block);                  /* 块的 footer */
+void set_size(struct block_meta *block, size_t size);                       /* 设置块大小并同步 footer */
+struct block_meta *next_block(struct block_meta *block);                    /* 物理上的后一块 */
+struct block_meta *prev_block(struct block_meta *block);                    /* 物理上的前一块 */
+void split_block(struct block_meta *block, size_t size);                    /* 切出多余部分放回空闲链表 */
+struct block_meta *coalesce(struct block_meta *block);                      /* 与相邻的空闲块合并 */
+struct block_meta *find_free_block(size_t size);                            /* 按大小类, 取出满足条件的空闲块 */
+size_t os_page_size();                                                      /* 系统页大小 */
+struct block_meta *request_space(size_t size);                              /* 申请内存 */
+struct block_meta *mmap_alloc(size_t size);                                 /* 单独映射大块 */
+void release_pages(struct block_meta *block, char *start, char *end);       /* 空闲块中的整页还给操作系统 */
+int is_slab_object(void *ptr);                                              /* 是否为 slab 中的对象 */
+struct slab *get_slab(void *ptr);                                           /* 对象所在的 slab */
+struct slab *slab_new(int index);                                           /* 新建一个 slab */
+void *slab_alloc(int index);                                                /* 从 slab 分配对象, 调用方持有 heap_lock */
+void slab_free(void *ptr);                                                  /* 对象还给所在的 slab, 调用方持有 heap_lock */
+struct block_meta *heap_alloc(size_t size);                                 /* 从中心堆分配, 调用方持有 heap_lock */
+void heap_free(struct block_meta *block);                                   /* 归还中心堆, 调用方持有 heap_lock */
+void *tcache_refill(int index, size_t size);                                /* 从 slab 或中心堆批量取块填充线程缓存 */
+void tcache_flush(int index, int count);                                    /* 把线程缓存中的块批量还给 slab 或中心堆 */
 void *my_malloc(size_t size);                                               /* 简易实现 malloc */
 struct block_meta *get_block_ptr(void *ptr);                                /* 由实内容的地址，获取 struct block_meta 头地址*/
 void *get_real_ptr(struct block_meta *ptr);                                 /* 由struct block_meta 头地址，获得实内容的地址 */
 void my_free(void *ptr);                                                    /* 模拟实现内存回收 */
 void *my_realloc(void *ptr, size_t size);                                   /* 实现简易版 realloc */
+size_t usable_size(void *ptr);                                              /* 可用的内容大小 */
 
 
+size_t align_size(size_t size)
+{
+  return (size + ALIGNMENT - 1) & ~(size_t)(ALIGNMENT - 1);
+}
+
 /**
- * 从列表开始位置搜索，找到满足 (空闲 && 大小合适) 的空闲块
- *  last: 记录目的 block 的上一block，用于设置 next；
- *  size: 不含 struct block_meta 的 size
+ * 小块: size / ALIGNMENT - 1; 大块: 按最高位所在的 2 的幂
+ *  size: 已按 ALIGNMENT 取整
 */
-struct block_meta *find_free_block(struct block_meta **last, size_t size)
+int size_class(size_t size)
+{
+  if (size <= SMALL_MAX)
+  {
+    return size / ALIGNMENT - 1;
+  }
+  int log2 = 63 - __builtin_clzl(size);
+  int index = NUM_SMALL_CLASSES + log2 - 9; // 2^9 = SMALL_MAX
+  return index < NUM_CLASSES ? index : NUM_CLASSES - 1;
+}
+
+void bin_insert(struct block_meta *block)
+{
+  int index = size_class(block->size);
+  block->prev_free = NULL;
+  block->next_free = free_bins[index];
+  if (free_bins[index])
+  {
+    free_bins[index]->prev_free = block;
+  }
+  free_bins[index] = block;
+  bin_map[index / 64] |= 1ULL << (index % 64);
+}
+
+void bin_remove(struct block_meta *block)
 {
-  struct block_meta *current = global_base;
-  while (current && !(current->free && current->size >= size))
+  int index = size_class(block->size);
+  if (block->prev_free)
+  {
+    block->prev_free->next_free = block->next_free;
+  }
+  else
+  {
+    free_bins[index] = block->next_free;
+  }
+  if (block->next_free)
+  {
+    block->next_free->prev_free = block->prev_free;
+  }
+  if (!free_bins[index])
   {
-    *last = current;
-    current = current->next;
+    bin_map[index / 64] &= ~(1ULL << (index % 64));
   }
-  return current;
+}
+
+struct block_footer *get_footer(struct block_meta *block)
+{
+  return (struct block_footer *)((char *)(block + 1) + block->size);
+}
+
+void set_size(struct block_meta *block, size_t size)
+{
+  block->size = size;
+  get_footer(block)->size = size;
+}
+
+struct block_meta *next_block(struct block_meta *block)
+{
+  return (struct block_meta *)(get_footer(block) + 1);
+}
+
+struct block_meta *prev_block(struct block_meta *block)
+{
+  struct block_footer *prev_footer = (struct block_footer *)block - 1;
+  return (struct block_meta *)((char *)prev_footer - prev_footer->size) - 1;
 }
 
 /**
- * 内部使用 sbrk 申请内存
- *  size：不含 struct block_meta 的 size
+ * block 只保留 size, 剩余部分足够大时切成一个新的空闲块
+ *  后一块一定不空闲 (相邻的空闲块已合并), 新块不需要再合并
 */
-struct block_meta *request_space(struct block_meta *last, size_t size)
+void split_block(struct block_meta *block, size_t size)
 {
-  void *old_addr;
-  old_addr = sbrk(0); // 原地址 
+  if (block->size < size + MIN_SPLIT_SIZE)
+  {
+    return;
+  }
+  size_t rest = block->size - size - META_SIZE - FOOTER_SIZE;
+  set_size(block, size);
+  struct block_meta *remainder = next_block(block);
+  set_size(remainder, rest);
+  remainder->free = 1;
+  bin_insert(remainder);
+}
 
-  void *request = sbrk(size + META_SIZE);
-  assert(old_addr == request);   // Not thread safe.
-  if (request == (void *)-1)
+/**
+ * 与物理上相邻的空闲块合并, 返回合并后的块 (不在空闲链表中)
+*/
+struct block_meta *coalesce(struct block_meta *block)
+{
+  struct block_meta *next = next_block(block);
+  if (next->free == 1)
+  {
+    bin_remove(next);
+    set_size(block, block->size + META_SIZE + FOOTER_SIZE + next->size);
+  }
+  struct block_meta *prev = prev_block(block);
+  if (prev->free == 1)
   {
-    return NULL; // sbrk failed.
+    bin_remove(prev);
+    set_size(prev, prev->size + META_SIZE + FOOTER_SIZE + block->size);
+    block = prev;
   }
+  return block;
+}
 
-  struct block_meta* block = (struct block_meta*)old_addr;
-  if (last)
+/**
+ * 取出一个满足条件的空闲块:
+ *  - 先看 size 所属类的链表头 (小块类中的块大小都相同, 大块类的头不一定够大);
+ *  - 再由 bin_map 找到更大的第一个非空类, 其中任意一块都足够大
+ *  size: 不含 struct block_meta 的 size, 已按 ALIGNMENT 取整
+*/
+struct block_meta *find_free_block(size_t size)
+{
+  int index = size_class(size);
+  struct block_meta *block = free_bins[index];
+  if (!block || block->size < size)
   {
-    last->next = block;
+    block = NULL;
+    for (int word = (index + 1) / 64; word < BIN_MAP_WORDS; word++)
+    {
+      uint64_t bits = bin_map[word];
+      if (word == (index + 1) / 64)
+      {
+        bits &= ~0ULL << ((index + 1) % 64);
+      }
+      if (bits)
+      {
+        block = free_bins[word * 64 + __builtin_ctzll(bits)];
+        break;
+      }
+    }
+  }
+  if (block)
+  {
+    bin_remove(block);
   }
-  block->size = size;
-  block->next = NULL;
-  block->free = 0;
   return block;
 }
 
+size_t os_page_size()
+{
+  static size_t page_size = 0;
+  if (!page_size)
+  {
+    page_size = sysconf(_SC_PAGESIZE);
+  }
+  return page_size;
+}
+
 /**
- * 简易实现 malloc 
+ * 从最后一个 arena 的哨兵尾块处切出新块, arena 末尾的空闲块一并合并; 放不下时映射新的 arena
+ *  size：不含 struct block_meta 的 size, 小于 MMAP_THRESHOLD
 */
-void *my_malloc(size_t size)
+struct block_meta *request_space(size_t size)
 {
   struct block_meta *block;
+  if (last_arena)
+  {
+    block = last_arena->epilogue;
+    struct block_meta *tail = prev_block(block);
+    if (tail->free == 1 && tail->size >= size)
+    {
+      // 大块类只比较了链表头, 末尾的空闲块可能已经够大
+      bin_remove(tail);
+      tail->free = 0;
+      split_block(tail, size);
+      return tail;
+    }
+    size_t extend = META_SIZE + size + FOOTER_SIZE;
+    if (tail->free == 1)
+    {
+      // 末尾的空闲块不够大, 只补足差额
+      extend = size - tail->size;
+    }
+    if ((char *)(block + 1) + extend <= last_arena->end)
+    {
+      if (tail->free == 1)
+      {
+        bin_remove(tail);
+        block = tail;
+      }
+      set_size(block, size);
+      block->free = 0;
+      last_arena->epilogue = next_block(block);
+      last_arena->epilogue->size = 0;
+      last_arena->epilogue->free = 0;
+      return block;
+    }
+  }
 
-  if (size <= 0)
+  // 最后一个 arena 已放不下, 剩余部分从未被访问, 不占物理内存
+  struct heap_arena *arena = mmap(NULL, ARENA_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (arena == MAP_FAILED)
   {
-    return NULL;
+    return NULL; // mmap failed.
+  }
+  arena->next = NULL;
+  arena->end = (char *)arena + ARENA_SIZE;
+  if (last_arena)
+  {
+    last_arena->next = arena;
+  }
+  else
+  {
+    global_base = arena;
+  }
+  last_arena = arena;
+
+  struct block_meta *prologue = (struct block_meta *)(arena + 1);
+  set_size(prologue, 0);
+  prologue->free = 0;
+  block = next_block(prologue);
+  set_size(block, size);
+  block->free = 0;
+  arena->epilogue = next_block(block);
+  arena->epilogue->size = 0;
+  arena->epilogue->free = 0;
+  return block;
+}
+
+/**
+ * 大块单独映射, 按页取整后多出的部分也计入 size
+*/
+struct block_meta *mmap_alloc(size_t size)
+{
+  size_t page_size = os_page_size();
+  size_t length = (META_SIZE + size + page_size - 1) & ~(page_size - 1);
+  struct block_meta *block = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (block == MAP_FAILED)
+  {
+    return NULL; // mmap failed.
+  }
+  block->size = length - META_SIZE;
+  block->free = BLOCK_MMAPPED;
+  return block;
+}
+
+/**
+ * 把空闲块内容中的整页还给操作系统, 只处理与 [start, end) 相交的页 (其余的页已经释放过)
+ *  block 的头与 footer 所在的页仍然保留
+*/
+void release_pages(struct block_meta *block, char *start, char *end)
+{
+  uintptr_t page_size = os_page_size();
+  uintptr_t first = ((uintptr_t)(block + 1) + page_size - 1) & ~(page_size - 1);
+  uintptr_t last = (uintptr_t)get_footer(block) & ~(page_size - 1);
+  uintptr_t from = (uintptr_t)start & ~(page_size - 1);
+  uintptr_t to = ((uintptr_t)end + page_size - 1) & ~(page_size - 1);
+  if (from > first)
+  {
+    first = from;
+  }
+  if (to < last)
+  {
+    last = to;
+  }
+  if (first < last)
+  {
+    madvise((void *)first, last - first, MADV_DONTNEED);
+  }
+}
+
+int is_slab_object(void *ptr)
+{
+  return (char *)ptr >= slab_base && (char *)ptr < slab_end;
+}
+
+struct slab *get_slab(void *ptr)
+{
+  return (struct slab *)((uintptr_t)ptr & ~(SLAB_SIZE - 1));
+}
+
+/**
+ * 优先复用 free_slabs, 否则从预留的地址空间切出; 首次调用时预留地址空间
+*/
+struct slab *slab_new(int index)
+{
+  struct slab *slab = free_slabs;
+  if (slab)
+  {
+    free_slabs = slab->next;
+  }
+  else
+  {
+    if (!slab_base)
+    {
+      // 多预留一个 SLAB_SIZE 用于对齐; MAP_NORESERVE, 只有用到的页才占用物理内存
+      char *region = mmap(NULL, SLAB_REGION_SIZE + SLAB_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+      if (region == MAP_FAILED)
+      {
+        return NULL; // mmap failed.
+      }
+      slab_base = (char *)(((uintptr_t)region + SLAB_SIZE - 1) & ~(SLAB_SIZE - 1));
+      slab_end = slab_base + SLAB_REGION_SIZE;
+      slab_top = slab_base;
+    }
+    if (slab_top == slab_end)
+    {
+      return NULL; // 地址空间用完, 调用方改用带头部的块
+    }
+    slab = (struct slab *)slab_top;
+    slab_top += SLAB_SIZE;
+  }
+
+  slab->object_size = (index + 1) * ALIGNMENT;
+  slab->index = index;
+  slab->num_used = 0;
+  slab->unused = (char *)slab + SLAB_HEADER_SIZE;
+  slab->free_list = NULL;
+  slab->prev = NULL;
+  slab->next = partial_slabs[index];
+  if (partial_slabs[index])
+  {
+    partial_slabs[index]->prev = slab;
+  }
+  partial_slabs[index] = slab;
+  return slab;
+}
+
+static void slab_unlink(struct slab *slab)
+{
+  if (slab->prev)
+  {
+    slab->prev->next = slab->next;
+  }
+  else
+  {
+    partial_slabs[slab->index] = slab->next;
   }
+  if (slab->next)
+  {
+    slab->next->prev = slab->prev;
+  }
+}
 
-  if (!global_base)
+/**
+ * 从所属大小类的第一个可用 slab 取一个对象, slab 用完后移出 partial_slabs
+*/
+void *slab_alloc(int index)
+{
+  struct slab *slab = partial_slabs[index];
+  if (!slab)
   {
-    // 首次调用
-    block = request_space(NULL, size);
-    if (!block)
+    slab = slab_new(index);
+    if (!slab)
     {
       return NULL;
     }
-    global_base = block;
+  }
+
+  void *object;
+  if (slab->free_list)
+  {
+    struct tcache_entry *entry = slab->free_list;
+    slab->free_list = entry->next;
+    entry->next = NULL; // 释放时内容已清空
+    object = entry;
   }
   else
   {
-    // 非首次调用
-    struct block_meta *last = global_base;
-    block = find_free_block(&last, size);
-    if (!block)
+    object = slab->unused;
+    slab->unused += slab->object_size;
+  }
+  slab->num_used += 1;
+
+  if (!slab->free_list && slab->unused + slab->object_size > (char *)slab + SLAB_SIZE)
+  {
+    slab_unlink(slab);
+  }
+  return object;
+}
+
+/**
+ * 对象挂回所在 slab 的空闲链表; slab 由满变为可用时放回 partial_slabs,
+ * 对象全部释放且该类还有其他可用的 slab 时, 把它的页还给操作系统
+*/
+void slab_free(void *ptr)
+{
+  struct slab *slab = get_slab(ptr);
+  int was_full = !slab->free_list && slab->unused + slab->object_size > (char *)slab + SLAB_SIZE;
+  struct tcache_entry *entry = ptr;
+  entry->next = slab->free_list;
+  slab->free_list = entry;
+  slab->num_used -= 1;
+
+  if (was_full)
+  {
+    slab->prev = NULL;
+    slab->next = partial_slabs[slab->index];
+    if (slab->next)
+    {
+      slab->next->prev = slab;
+    }
+    partial_slabs[slab->index] = slab;
+  }
+  if (slab->num_used == 0 && (slab->prev || slab->next))
+  {
+    slab_unlink(slab);
+    size_t page_size = os_page_size();
+    if (page_size < SLAB_SIZE)
+    {
+      // 保留 slab 头所在的页
+      madvise((char *)slab + page_size, SLAB_SIZE - page_size, MADV_DONTNEED);
+    }
+    slab->next = free_slabs;
+    free_slabs = slab;
+  }
+}
+
+/**
+ * 从中心堆分配, 调用方持有 heap_lock
+ *  size: 已按 ALIGNMENT 取整
+*/
+struct block_meta *heap_alloc(size_t size)
+{
+  struct block_meta *block = find_free_block(size);
+  if (!block)
+  {
+    // 没有找到可用的空闲块
+    return request_space(size);
+  }
+  // 找到可用的空闲块, 多余部分切分出去
+  block->free = 0;
+  split_block(block, size);
+  return block;
+}
+
+/**
+ * 归还中心堆, 与相邻的空闲块合并后放回空闲链表, 调用方持有 heap_lock
+*/
+void heap_free(struct block_meta *block)
+{
+  // 将要合并的相邻空闲块若小于 RELEASE_THRESHOLD, 其中的页还未释放
+  char *start = (char *)block;
+  char *end = (char *)next_block(block);
+  struct block_meta *prev = prev_block(block);
+  struct block_meta *next = next_block(block);
+  if (prev->free == 1 && prev->size < RELEASE_THRESHOLD)
+  {
+    start = (char *)prev;
+  }
+  if (next->free == 1 && next->size < RELEASE_THRESHOLD)
+  {
+    end = (char *)next_block(next);
+  }
+
+  block = coalesce(block);
+  block->free = 1;
+  bin_insert(block);
+  if (block->size >= RELEASE_THRESHOLD)
+  {
+    release_pages(block, start, end);
+  }
+}
+
+// 线程退出时把缓存的块全部还给中心堆
+static void tcache_release(void *arg)
+{
+  (void)arg;
+  for (int index = 0; index < NUM_SMALL_CLASSES; index++)
+  {
+    tcache_flush(index, tcache.counts[index]);
+  }
+}
+
+static void tcache_key_create()
+{
+  pthread_key_create(&tcache_key, tcache_release);
+}
+
+static void tcache_register()
+{
+  if (!tcache.registered)
+  {
+    pthread_once(&tcache_key_once, tcache_key_create);
+    pthread_setspecific(tcache_key, &tcache);
+    tcache.registered = 1;
+  }
+}
+
+/**
+ * 加锁一次取 TCACHE_BATCH 块: 前面的放入线程缓存, 最后一块返回给调用方
+ *  - 不超过 SLAB_MAX 的从 slab 取对象;
+ *  - 其余 (或 slab 的地址空间用完时) 从中心堆取一整段, 切成 TCACHE_BATCH 块
+ *  size: 小块类的大小
+*/
+void *tcache_refill(int index, size_t size)
+{
+  if (size <= SLAB_MAX)
+  {
+    void *objects[TCACHE_BATCH];
+    int count = 0;
+    pthread_mutex_lock(&heap_lock);
+    while (count < TCACHE_BATCH && (objects[count] = slab_alloc(index)) != NULL)
+    {
+      count += 1;
+    }
+    pthread_mutex_unlock(&heap_lock);
+    if (count > 0)
     {
-      // 没有找到可用的空闲块
-      block = request_space(last, size);
-      if (!block)
+      // 倒序放入, 之后按地址顺序取出
+      for (int i = count - 1; i > 0; i--)
       {
-        return NULL;
+        struct tcache_entry *entry = objects[i];
+        entry->next = tcache.bins[index];
+        tcache.bins[index] = entry;
+        tcache.counts[index] += 1;
       }
+      return objects[0];
+    }
+  }
+
+  size_t stride = META_SIZE + size + FOOTER_SIZE;
+  pthread_mutex_lock(&heap_lock);
+  struct block_meta *block = heap_alloc(TCACHE_BATCH * stride - META_SIZE - FOOTER_SIZE);
+  pthread_mutex_unlock(&heap_lock);
+  if (!block)
+  {
+    return NULL;
+  }
+
+  size_t rest = block->size;
+  for (int i = 0; i < TCACHE_BATCH - 1; i++)
+  {
+    rest -= stride;
+    set_size(block, size);
+    block->free = BLOCK_CACHED;
+    struct tcache_entry *entry = get_real_ptr(block);
+    entry->next = tcache.bins[index];
+    tcache.bins[index] = entry;
+    tcache.counts[index] += 1;
+    block = next_block(block);
+  }
+  // 最后一块可能因为没有切分而略大
+  set_size(block, rest);
+  block->free = 0;
+  return get_real_ptr(block);
+}
+
+/**
+ * 从线程缓存取出 count 块, 加锁一次全部还给所在的 slab 或中心堆
+*/
+void tcache_flush(int index, int count)
+{
+  struct tcache_entry *batch = NULL;
+  for (int i = 0; i < count; i++)
+  {
+    struct tcache_entry *entry = tcache.bins[index];
+    tcache.bins[index] = entry->next;
+    entry->next = batch;
+    batch = entry;
+  }
+  tcache.counts[index] -= count;
+
+  pthread_mutex_lock(&heap_lock);
+  while (batch)
+  {
+    struct tcache_entry *next = batch->next;
+    batch->next = NULL;
+    if (is_slab_object(batch))
+    {
+      slab_free(batch);
     }
     else
     {
-      // 找到可用的空闲块
-      block->free = 0;
+      heap_free(get_block_ptr(batch));
+    }
+    batch = next;
+  }
+  pthread_mutex_unlock(&heap_lock);
+}
+
+/**
+ * 简易实现 malloc: 小块先查本线程的缓存 (不超过 SLAB_MAX 的来自 slab), 大块单独映射, 其余加锁从中心堆分配
+*/
+void *my_malloc(size_t size)
+{
+  struct block_meta *block;
+
+  if (size <= 0)
+  {
+    return NULL;
+  }
+
+  size = align_size(size);
+  if (size <= SMALL_MAX)
+  {
+    int index = size_class(size);
+    struct tcache_entry *entry = tcache.bins[index];
+    if (entry)
+    {
+      tcache.bins[index] = entry->next;
+      tcache.counts[index] -= 1;
+      entry->next = NULL; // 释放时内容已清空
+      if (!is_slab_object(entry))
+      {
+        get_block_ptr(entry)->free = 0;
+      }
+      return entry;
     }
+    tcache_register();
+    return tcache_refill(index, size);
+  }
+
+  if (size >= MMAP_THRESHOLD)
+  {
+    block = mmap_alloc(size);
+  }
+  else
+  {
+    pthread_mutex_lock(&heap_lock);
+    block = heap_alloc(size);
+    pthread_mutex_unlock(&heap_lock);
+  }
+  if (!block)
+  {
+    return NULL;
   }
   return (block + 1);
 }
@@ -131,7 +813,8 @@ void *get_real_ptr(struct block_meta *ptr) {
 
 
 /**
- * 通过真正内容的地址，标记 struct block_meta.free 为 真
+ * 通过真正内容的地址回收内存: 小块放入本线程的缓存 (不论由哪个线程分配), 缓存满时批量还给中心堆;
+ * 单独映射的大块直接 munmap; 其余加锁标记 struct block_meta.free 为 真, 与相邻的空闲块合并后放回空闲链表
 */
 void my_free(void *ptr)
 {
@@ -139,11 +822,49 @@ void my_free(void *ptr)
   {
     return;
   }
-  
-  struct block_meta *block_ptr = get_block_ptr(ptr);
-  assert(block_ptr->free == 0);
-  block_ptr->free = 1;
-  memset(ptr, 0, block_ptr->size);
+
+  struct block_meta *block_ptr = NULL;
+  size_t size;
+  if (is_slab_object(ptr))
+  {
+    // slab 对象没有头部, 大小记录在 slab 中
+    size = get_slab(ptr)->object_size;
+  }
+  else
+  {
+    block_ptr = get_block_ptr(ptr);
+    if (block_ptr->free == BLOCK_MMAPPED)
+    {
+      // 单独映射的大块直接归还
+      munmap(block_ptr, META_SIZE + block_ptr->size);
+      return;
+    }
+    assert(block_ptr->free == 0);
+    size = block_ptr->size;
+  }
+  memset(ptr, 0, size);
+  if (size <= SMALL_MAX)
+  {
+    int index = size_class(size);
+    struct tcache_entry *entry = ptr;
+    tcache_register();
+    if (block_ptr)
+    {
+      block_ptr->free = BLOCK_CACHED;
+    }
+    entry->next = tcache.bins[index];
+    tcache.bins[index] = entry;
+    tcache.counts[index] += 1;
+    if (tcache.counts[index] > TCACHE_COUNT)
+    {
+      tcache_flush(index, TCACHE_BATCH);
+    }
+    return;
+  }
+
+  pthread_mutex_lock(&heap_lock);
+  heap_free(block_ptr);
+  pthread_mutex_unlock(&heap_lock);
 }
 
 /**
@@ -156,8 +877,8 @@ void *my_realloc(void *ptr, size_t size)
     return my_malloc(size);
   }
 
-  struct block_meta *block_ptr = get_block_ptr(ptr);
-  if (block_ptr->size >= size)
+  size_t old_size = usable_size(ptr);
+  if (old_size >= size)
   {
     return ptr;
   }
@@ -168,21 +889,335 @@ void *my_realloc(void *ptr, size_t size)
   {
     return NULL; // TODO: set errno on failure.
   }
-  memcpy(new_ptr, ptr, block_ptr->size);
+  memcpy(new_ptr, ptr, old_size);
   my_free(ptr);
   return new_ptr;
 }
 
+/**
+ * 可用的内容大小: slab 对象为所在 slab 的对象大小, 其余为块头中的 size
+*/
+size_t usable_size(void *ptr)
+{
+  if (is_slab_object(ptr))
+  {
+    return get_slab(ptr)->object_size;
+  }
+  return get_block_ptr(ptr)->size;
+}
+
 void log_mem() {
-  struct block_meta *cur = global_base;
-  while (cur) {
-    printf("addr: %p, is_free: %d, size: %ld, content: %s\n", cur, cur->free, cur->size, (const char*)get_real_ptr(cur));
-    cur = cur->next;
+  int cached = 0; // 线程缓存中的块内容是链接指针, 只计数
+  for (struct heap_arena *arena = global_base; arena; arena = arena->next) {
+    struct block_meta *cur = next_block((struct block_meta *)(arena + 1));
+    while (cur != arena->epilogue) {
+      if (cur->free == BLOCK_CACHED) {
+        cached += 1;
+      } else {
+        printf("addr: %p, is_free: %d, size: %ld, content: %s\n", cur, cur->free, cur->size, (const char*)get_real_ptr(cur));
+      }
+      cur = next_block(cur);
+    }
+  }
+  printf("cached blocks: %d\n", cached);
+  // slab 对象没有头部, 不在 slab 空闲链表与本线程缓存中的即为已分配 (仅用于调试, 逐个查找)
+  for (char *cur = slab_base; cur < slab_top; cur += SLAB_SIZE) {
+    struct slab *slab = (struct slab *)cur;
+    if (slab->num_used == 0) {
+      continue;
+    }
+    for (char *object = cur + SLAB_HEADER_SIZE; object < slab->unused; object += slab->object_size) {
+      int listed = 0;
+      for (struct tcache_entry *entry = slab->free_list; entry && !listed; entry = entry->next) {
+        listed = ((char *)entry == object);
+      }
+      for (struct tcache_entry *entry = tcache.bins[slab->index]; entry && !listed; entry = entry->next) {
+        listed = ((char *)entry == object);
+      }
+      if (!listed) {
+        printf("addr: %p, slab object, size: %ld, content: %s\n", object, slab->object_size, object);
+      }
+    }
+  }
+}
+
+static double now_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static size_t heap_size()
+{
+  size_t total = 0;
+  for (struct heap_arena *arena = global_base; arena; arena = arena->next)
+  {
+    total += (char *)(arena->epilogue + 1) - (char *)arena;
+  }
+  return total;
+}
+
+/**
+ * 分配延迟随堆增长的变化: 持续分配随机大小的块, 每 4 次分配随机释放 1 块,
+ * 存活块数增长到 total 个, 每 window 次分配输出一次平均耗时
+*/
+int bench_malloc(size_t total, size_t window)
+{
+  void **live = malloc(total * sizeof(void *));
+  size_t num_live = 0;
+  unsigned int seed = 1;
+
+  printf("%12s %12s %10s\n", "blocks", "heap(MB)", "ns/malloc");
+  while (num_live < total)
+  {
+    double start = now_ns();
+    for (size_t i = 0; i < window && num_live < total; i++)
+    {
+      seed = seed * 1103515245 + 12345;
+      size_t size = (seed >> 16) % 8 == 0 ? 512 + (seed >> 8) % 4096 : 8 + (seed >> 8) % 248;
+      live[num_live++] = my_malloc(size);
+      if (i % 4 == 3)
+      {
+        size_t victim = (seed >> 4) % num_live;
+        my_free(live[victim]);
+        live[victim] = live[--num_live];
+      }
+    }
+    double elapsed = now_ns() - start;
+    printf("%12zu %12.1f %10.1f\n", num_live, heap_size() / 1048576.0, elapsed / window);
+  }
+  free(live);
+  return 0;
+}
+
+/**
+ * 长时间运行下的堆大小: 保持 live 个随机大小的存活块, 每次随机释放一块再分配一块,
+ * 共 rounds 轮, 每轮 live 次替换, 输出每轮结束时的堆大小与碎片率
+*/
+int bench_churn(size_t live, size_t rounds)
+{
+  void **blocks = malloc(live * sizeof(void *));
+  size_t *sizes = malloc(live * sizeof(size_t));
+  size_t live_bytes = 0;
+  unsigned int seed = 1;
+
+  for (size_t i = 0; i < live; i++)
+  {
+    seed = seed * 1103515245 + 12345;
+    sizes[i] = 8 + (seed >> 8) % 2048;
+    blocks[i] = my_malloc(sizes[i]);
+    live_bytes += sizes[i];
+  }
+
+  printf("%8s %12s %12s %12s\n", "round", "live(MB)", "heap(MB)", "overhead");
+  for (size_t round = 1; round <= rounds; round++)
+  {
+    for (size_t i = 0; i < live; i++)
+    {
+      seed = seed * 1103515245 + 12345;
+      size_t victim = (seed >> 4) % live;
+      my_free(blocks[victim]);
+      live_bytes -= sizes[victim];
+      seed = seed * 1103515245 + 12345;
+      sizes[victim] = 8 + (seed >> 8) % 2048;
+      blocks[victim] = my_malloc(sizes[victim]);
+      live_bytes += sizes[victim];
+    }
+    printf("%8zu %12.1f %12.1f %11.1f%%\n", round, live_bytes / 1048576.0, heap_size() / 1048576.0,
+           100.0 * (heap_size() - live_bytes) / heap_size());
+  }
+  free(blocks);
+  free(sizes);
+  return 0;
+}
+
+static size_t rss_bytes()
+{
+  long size = 0, pages = 0;
+  FILE *statm = fopen("/proc/self/statm", "r");
+  if (statm)
+  {
+    if (fscanf(statm, "%ld %ld", &size, &pages) != 2)
+    {
+      pages = 0;
+    }
+    fclose(statm);
+  }
+  return pages * os_page_size();
+}
+
+/**
+ * 负载尖峰后的 RSS: 每轮分配共 bytes 字节随机大小的块 (其中少量为单独映射的大块) 并写满,
+ * 再按随机顺序全部释放, 输出峰值与释放后的 RSS
+*/
+int bench_spike(size_t bytes, int rounds)
+{
+  size_t capacity = bytes / 16;
+  void **blocks = malloc(capacity * sizeof(void *));
+  unsigned int seed = 1;
+
+  printf("%8s %14s %14s\n", "round", "peak RSS(MB)", "freed RSS(MB)");
+  for (int round = 1; round <= rounds; round++)
+  {
+    size_t num_blocks = 0;
+    size_t total = 0;
+    while (total < bytes && num_blocks < capacity)
+    {
+      seed = seed * 1103515245 + 12345;
+      size_t size = (seed >> 16) % 256 == 0 ? MMAP_THRESHOLD + (seed >> 4) % (1 << 20) : 16 + (seed >> 8) % 4096;
+      blocks[num_blocks] = my_malloc(size);
+      memset(blocks[num_blocks], 1, size);
+      num_blocks += 1;
+      total += size;
+    }
+    size_t peak = rss_bytes();
+
+    for (size_t i = num_blocks; i > 0; i--)
+    {
+      seed = seed * 1103515245 + 12345;
+      size_t victim = (seed >> 4) % i;
+      my_free(blocks[victim]);
+      blocks[victim] = blocks[i - 1];
+    }
+    printf("%8d %14.1f %14.1f\n", round, peak / 1048576.0, rss_bytes() / 1048576.0);
+  }
+  free(blocks);
+  return 0;
+}
+
+/**
+ * 小对象的占用与耗时: 分配 count 个 size 字节的对象, 再全部释放
+*/
+int bench_small(size_t count, size_t size)
+{
+  void **objects = malloc(count * sizeof(void *));
+  memset(objects, 1, count * sizeof(void *)); // 先占用页, 不计入对象
+
+  size_t rss = rss_bytes();
+  double start = now_ns();
+  for (size_t i = 0; i < count; i++)
+  {
+    objects[i] = my_malloc(size);
+  }
+  double alloc_ns = now_ns() - start;
+  size_t used = rss_bytes() - rss;
+
+  start = now_ns();
+  for (size_t i = 0; i < count; i++)
+  {
+    my_free(objects[i]);
+  }
+  double free_ns = now_ns() - start;
+
+  printf("objects: %zu, size: %zu, bytes/object: %.1f, ns/malloc: %.1f, ns/free: %.1f\n",
+         count, size, (double)used / count, alloc_ns / count, free_ns / count);
+  free(objects);
+  return 0;
+}
+
+#define BENCH_ROUND 4096
+
+struct bench_thread
+{
+  int id;
+  int num_threads;
+  size_t rounds;
+  void **slots;                 // 所有线程的 slots, 每线程 BENCH_ROUND 个
+  pthread_barrier_t *barrier;
+};
+
+/**
+ * 每轮先分配 BENCH_ROUND 个 8 ~ 256 字节的块, 再释放下一个线程在本轮分配的块 (跨线程释放)
+*/
+static void *bench_thread_run(void *arg)
+{
+  struct bench_thread *bench = arg;
+  void **mine = bench->slots + bench->id * BENCH_ROUND;
+  void **other = bench->slots + (bench->id + 1) % bench->num_threads * BENCH_ROUND;
+  unsigned int seed = bench->id + 1;
+
+  for (size_t round = 0; round < bench->rounds; round++)
+  {
+    for (int i = 0; i < BENCH_ROUND; i++)
+    {
+      seed = seed * 1103515245 + 12345;
+      mine[i] = my_malloc(8 + (seed >> 8) % 248);
+    }
+    pthread_barrier_wait(bench->barrier);
+    for (int i = 0; i < BENCH_ROUND; i++)
+    {
+      my_free(other[i]);
+    }
+    pthread_barrier_wait(bench->barrier);
   }
+  return NULL;
 }
 
-int main()
+/**
+ * 1 ~ max_threads 个线程同时分配 / 跨线程释放, 输出总吞吐量
+*/
+int bench_threads(int max_threads, size_t rounds)
+{
+  printf("%8s %14s %14s\n", "threads", "Mops/s", "Mops/s/thread");
+  for (int num_threads = 1; num_threads <= max_threads; num_threads *= 2)
+  {
+    pthread_t threads[num_threads];
+    struct bench_thread benches[num_threads];
+    void **slots = malloc(num_threads * BENCH_ROUND * sizeof(void *));
+    pthread_barrier_t barrier;
+    pthread_barrier_init(&barrier, NULL, num_threads);
+
+    double start = now_ns();
+    for (int i = 0; i < num_threads; i++)
+    {
+      benches[i] = (struct bench_thread){i, num_threads, rounds, slots, &barrier};
+      pthread_create(&threads[i], NULL, bench_thread_run, &benches[i]);
+    }
+    for (int i = 0; i < num_threads; i++)
+    {
+      pthread_join(threads[i], NULL);
+    }
+    double elapsed = now_ns() - start;
+
+    // 每个块一次 malloc + 一次 free
+    double mops = 2.0 * num_threads * rounds * BENCH_ROUND / elapsed * 1e3;
+    printf("%8d %14.2f %14.2f\n", num_threads, mops, mops / num_threads);
+    pthread_barrier_destroy(&barrier);
+    free(slots);
+  }
+  return 0;
+}
+
+int main(int argc, char *argv[])
 {
+  if (argc > 1 && strcmp(argv[1], "bench") == 0)
+  {
+    size_t total = argc > 2 ? strtoul(argv[2], NULL, 10) : 2000000;
+    return bench_malloc(total, 250000);
+  }
+  if (argc > 1 && strcmp(argv[1], "churn") == 0)
+  {
+    size_t live = argc > 2 ? strtoul(argv[2], NULL, 10) : 100000;
+    return bench_churn(live, 10);
+  }
+  if (argc > 1 && strcmp(argv[1], "threads") == 0)
+  {
+    int max_threads = argc > 2 ? atoi(argv[2]) : 8;
+    return bench_threads(max_threads, 200);
+  }
+  if (argc > 1 && strcmp(argv[1], "small") == 0)
+  {
+    size_t count = argc > 2 ? strtoul(argv[2], NULL, 10) : 10000000;
+    size_t size = argc > 3 ? strtoul(argv[3], NULL, 10) : 24;
+    return bench_small(count, size);
+  }
+  if (argc > 1 && strcmp(argv[1], "spike") == 0)
+  {
+    size_t megabytes = argc > 2 ? strtoul(argv[2], NULL, 10) : 512;
+    return bench_spike(megabytes << 20, 5);
+  }
+
   void* p1 = my_malloc(16);
   strcpy(p1, "hello");
 
@@ -204,4 +1239,4 @@ int main()
   log_mem();
 
   return 0;
-}
\ No newline at end of file
+}
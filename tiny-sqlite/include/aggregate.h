@@ -0,0 +1,51 @@
+#ifndef _AGGREGATE_H_
+#define _AGGREGATE_H_
+
+#include "config.h"
+#include "record.h"
+#include "table.h"
+#include "batch.h"
+
+#define AGGREGATE_MAX_FUNCTIONS 8
+#define AGGREGATE_MIN_SLOTS     64 // 分组哈希表的初始槽数, 2 的幂
+
+/*
+  select <聚合>[, <聚合>...] [where ...] [group by <列> | group by domain(<文本列>)]
+  聚合: count(*) | min(<列>) | max(<列>); domain() 取 '@' 之后的部分, 没有 '@' 时为空串
+  - 在向量化扫描 (见 batch.h) 中单趟完成, 只读取用到的列 (不需要 email 时不读溢出页);
+  - 不分组时每批在选择向量上跑紧凑循环, 一批只更新一次结果;
+  - 没有 where 的 count(*) 直接读取文件头中的行数, 不扫描;
+  - 分组保存在开放寻址 (线性探测) 的哈希表中, 记录最近命中的分组, 相邻行同组时跳过哈希与探测
+  结果按分组 key 排序后输出
+*/
+
+typedef enum {
+    AGGREGATE_COUNT,
+    AGGREGATE_MIN,
+    AGGREGATE_MAX,
+} AggregateFunction;
+
+typedef struct {
+    AggregateFunction function;
+    const ColumnInfo* column; // count(*) 时为 NULL
+} AggregateSpec;
+
+typedef enum {
+    GROUP_NONE,
+    GROUP_COLUMN,
+    GROUP_DOMAIN,
+} GroupKind;
+
+typedef struct {
+    uint32_t num_functions;
+    AggregateSpec functions[AGGREGATE_MAX_FUNCTIONS];
+    GroupKind group_kind;
+    const ColumnInfo* group_column;
+} AggregateQuery;
+
+// 解析 "select " 之后的部分, where 条件写入 filter, 语法错误时返回 false
+bool aggregate_parse(const char* sql, AggregateQuery* query, Filter* filter);
+
+// 扫描全表并打印每个分组的结果
+void aggregate_execute(AggregateQuery* query, Filter* filter, Table* table);
+#endif
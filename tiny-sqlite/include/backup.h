@@ -0,0 +1,52 @@
+#ifndef _BACKUP_H_
+#define _BACKUP_H_
+
+#include "config.h"
+#include "page.h"
+#include "table.h"
+
+#define BACKUP_STEP_PAGES 1024  // 每步最多复制的页数 (4 MB)
+
+/*
+  在线备份 (.backup <path>, 服务端 BACKUP 请求):
+  - 每一步按页号顺序复制一段页: 缓存中的页直接写出 (文件里可能是旧内容),
+    其余连续页用 copy_file_range 在内核中从原文件拷贝, 不经过用户态也不占用页缓存;
+  - 备份期间 get_page 访问过的页登记在位图中 (不区分读写, 修改页之前必然先经过 get_page),
+    顺序复制完成后分步补拷这些页;
+  - 剩余页不超过一步时, 在同一次调用内补拷全部剩余页, 截断到当前页数, fsync 后
+    rename 为目标文件: 调用期间没有语句执行, 因此得到的是该时刻的一致快照。
+  两步之间可以照常执行语句, 写入只需在位图中置位, 不会被阻塞
+*/
+
+typedef enum {
+    BACKUP_MORE,
+    BACKUP_DONE,
+    BACKUP_ERROR,
+} BackupResult;
+
+typedef struct Backup {
+    Pager* pager;
+    int fd;
+    char* path;
+    char* tmp_path;
+    uint32_t next_page;      // 顺序复制的下一页
+    uint8_t* touched;        // 已复制之后又被访问过的页
+    uint32_t touched_size;   // 位图可容纳的页数
+    uint32_t num_touched;
+    uint32_t scan_page;      // 补拷时位图的扫描位置
+    uint32_t recopy_budget;  // 补拷的页数上限, 用尽后直接完成 (避免热点页反复补拷)
+    uint64_t pages_copied;
+} Backup;
+
+// 开始备份到 path (先写入 path-backup, 完成后 rename), 失败或已有备份进行中时返回 NULL
+Backup* backup_start(Table* table, const char* path);
+
+// 最多复制 max_pages 页; 返回 BACKUP_DONE 时备份已落盘
+BackupResult backup_step(Backup* backup, uint32_t max_pages);
+
+// 结束备份并释放, 未完成时删除临时文件
+void backup_finish(Backup* backup);
+
+// get_page 调用: 登记被访问的页
+void backup_page_touched(Backup* backup, uint32_t page_num);
+#endif
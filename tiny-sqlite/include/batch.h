@@ -0,0 +1,96 @@
+#ifndef _BATCH_H_
+#define _BATCH_H_
+
+#include "config.h"
+#include "record.h"
+#include "table.h"
+#include "text_tree.h"
+
+#define BATCH_SIZE           1024 // 每批最多行数
+#define FILTER_MAX_PREDICATES 4
+
+/*
+  select 的向量化执行: 扫描 -> 过滤 -> 投影 -> 聚合 / 输出, 算子之间每次传递一批行
+  - 扫描按叶子连续读入最多 BATCH_SIZE 行, 每列存成一个定长数组 (列向量, 由 schema.def 展开);
+    每行只解码前 read_size 字节中的列 (投影下推), 整数主键表的 id 直接取叶子中的 key;
+  - 过滤维护选择向量 (通过的行下标), 每个条件在整批上跑一遍无分支的紧凑循环;
+  - 下游只访问选择向量中的行
+*/
+
+// 列向量
+#define TABLE(type, suffix)                         typedef struct {
+#define COLUMN_U64(type, suffix, name)              uint64_t name[BATCH_SIZE];
+#define COLUMN_TEXT(type, suffix, name, size)       char name[BATCH_SIZE][size];
+#define COLUMN_TAIL_TEXT(type, suffix, name, size)  char name[BATCH_SIZE][size];
+#define TABLE_END(type, suffix)                     } type##Vectors;
+#include "schema.def"
+
+typedef struct {
+    uint32_t count;                 // 本批读入的行数
+    uint32_t num_selected;          // 通过过滤的行数
+    uint16_t selection[BATCH_SIZE]; // 通过过滤的行下标, 递增
+    RowVectors columns;
+} Batch;
+
+typedef enum {
+    PREDICATE_EQ,
+    PREDICATE_NE,
+    PREDICATE_LT,
+    PREDICATE_LE,
+    PREDICATE_GT,
+    PREDICATE_GE,
+} PredicateOp;
+
+// <列> <op> <值>
+typedef struct {
+    const ColumnInfo* column;
+    PredicateOp op;
+    uint64_t number;                    // 整数列的值
+    char text[COLUMN_EMAIL_SIZE + 1];   // 原始文本
+} Predicate;
+
+// 多个条件之间为 and
+typedef struct {
+    uint32_t num_predicates;
+    Predicate predicates[FILTER_MAX_PREDICATES];
+} Filter;
+
+typedef struct {
+    Table* table;
+    uint32_t read_size;      // 每行读取的记录前缀长度
+    bool done;
+    uint32_t page_num;       // 整数主键表的当前叶子
+    uint32_t cell_num;
+    TextCursor text_cursor;  // 文本主键表
+} BatchScan;
+
+/*
+  解析 sql 开头的 " where <列> <op> <值> [and ...]", op 为 = != < <= > >=;
+  返回消耗的字符数, 没有 where 时返回 0, 语法错误时返回 -1
+*/
+int filter_parse(const char* sql, Filter* filter);
+
+// 按列类型设置条件的值, 整数列不是数字或文本超过列宽时返回 false
+bool predicate_set_value(Predicate* predicate, const char* text);
+
+// 单行是否满足全部条件 (二级索引查找得到的行逐行检查)
+bool filter_match(const Filter* filter, Row* row);
+
+// 过滤条件用到的记录前缀长度, 与 read_size 取较大值
+uint32_t filter_read_size(const Filter* filter, uint32_t read_size);
+
+// read_size 为 0 时只读 id (整数主键表不读记录)
+void batch_scan_init(BatchScan* scan, Table* table, uint32_t read_size);
+
+// 读入下一批并全部选中, 表已读完时返回 false
+bool batch_scan_next(BatchScan* scan, Batch* batch);
+
+// 按条件收缩选择向量
+void batch_filter(Batch* batch, const Filter* filter);
+
+// 第 row 行某一列在列向量中的地址
+void* batch_column(Batch* batch, const ColumnInfo* column, uint32_t row);
+
+// 组装第 row 行
+void batch_row(Batch* batch, uint32_t row, Row* destination);
+#endif
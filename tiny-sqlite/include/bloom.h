@@ -0,0 +1,30 @@
+#ifndef _BLOOM_H_
+#define _BLOOM_H_
+
+#include "config.h"
+
+/*
+  分块 Bloom filter: 每个 key 只落在一个 32 字节的块中, 在块内 8 个 32 位字里各置 1 位,
+  查询只访问一条 cache line; 每个 key 约 BLOOM_BITS_PER_KEY 位, 误判率约 1%
+*/
+#define BLOOM_BITS_PER_KEY  10
+#define BLOOM_BLOCK_WORDS   8
+
+typedef struct {
+    uint32_t (*blocks)[BLOOM_BLOCK_WORDS];
+    uint32_t num_blocks;  // 2 的幂
+    uint32_t capacity;    // 按 BLOOM_BITS_PER_KEY 计算可容纳的 key 数, 超过后误判率上升
+    uint32_t num_keys;
+    uint32_t num_removed; // 已删除的 key 无法从位图中清除, 只计数, 由使用方决定何时重建
+} BloomFilter;
+
+// 创建可容纳 capacity 个 key 的过滤器
+BloomFilter* bloom_new(uint32_t capacity);
+
+void bloom_free(BloomFilter* filter);
+
+void bloom_add(BloomFilter* filter, uint64_t key);
+
+// 返回 false 时 key 一定不存在
+bool bloom_may_contain(BloomFilter* filter, uint64_t key);
+#endif
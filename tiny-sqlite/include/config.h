@@ -13,18 +13,24 @@
 #include <string.h>
 
 
-#define TABLE_MAX_PAGES 64  // 页数量
-#define PAGE_SIZE  4096     // 页大小
+#define PAGE_CACHE_DEFAULT_SIZE (4 << 20) // 全局页缓存默认容量 (字节), 见 page_cache.h
+#define SORT_DEFAULT_MEMORY (8 << 20)  // order by 排序默认内存预算, 见 sorter.h
+#define RESULT_CACHE_DEFAULT_SIZE 0    // 查询结果缓存默认容量 (字节), 0 表示关闭, 见 result_cache.h
+// 页大小在新建数据库时选择并记录在文件头中, 进程内打开的数据库页大小相同 (见 page.h)
+#define PAGE_SIZE_MIN      4096
+#define PAGE_SIZE_MAX      65536
+#define PAGE_SIZE_DEFAULT  4096
+#define PAGE_SIZE          db_page_size
+
+extern uint32_t db_page_size;
 
 
 // 针对特定表设计
-// id - 4; username - 32; email - 255
-// total = 291
+// id - 8; username - 32; email - 255
+// total = 295
 #define COLUMN_USERNAME_SIZE 32
 #define COLUMN_EMAIL_SIZE    255
-#define ROW_SIZE             768
-
-#define INTERNAL_NODE_MAX_CELLS 3
+#define ROW_SIZE             295
 
 
 // 公共: 节点类型 + 是否根节点 + 父节点指针
@@ -48,19 +54,28 @@
 
 
 // 叶子body：
-// 数据内容: [(key : Row), (key : Row), ...]
-#define LEAF_NODE_KEY_SIZE      sizeof(uint32_t)
-#define LEAF_NODE_VALUE_SIZE    ROW_SIZE
-#define LEAF_NODE_CELL_SIZE     (LEAF_NODE_KEY_SIZE + LEAF_NODE_VALUE_SIZE)
-
-#define LEAF_NODE_KEY_OFFSET        0
-#define LEAF_NODE_VALUE_OFFSET      (LEAF_NODE_KEY_OFFSET + LEAF_NODE_KEY_SIZE)
+// 数据内容: [(key : payload 长度 : 溢出页 : 内联 payload), ...]
+// payload 为序列化后的 Row, 超出 LEAF_NODE_VALUE_SIZE 的部分写入溢出页链表
+// 内联部分取页大小的 1/4 (不超过 ROW_SIZE), 只有更大的 payload 才使用溢出页,
+// 避免每个稍长的行各占一个几乎全空的溢出页
+#define LEAF_NODE_KEY_SIZE          sizeof(uint64_t)
+#define LEAF_NODE_PAYLOAD_SIZE_SIZE sizeof(uint32_t)
+#define LEAF_NODE_OVERFLOW_SIZE     sizeof(uint32_t)
+#define LEAF_NODE_VALUE_SIZE        (ROW_SIZE < PAGE_SIZE / 4 ? ROW_SIZE : PAGE_SIZE / 4)
+#define LEAF_NODE_CELL_SIZE         (LEAF_NODE_KEY_SIZE + LEAF_NODE_PAYLOAD_SIZE_SIZE + LEAF_NODE_OVERFLOW_SIZE + LEAF_NODE_VALUE_SIZE)
+
+#define LEAF_NODE_KEY_OFFSET          0
+#define LEAF_NODE_PAYLOAD_SIZE_OFFSET (LEAF_NODE_KEY_OFFSET + LEAF_NODE_KEY_SIZE)
+#define LEAF_NODE_OVERFLOW_OFFSET     (LEAF_NODE_PAYLOAD_SIZE_OFFSET + LEAF_NODE_PAYLOAD_SIZE_SIZE)
+#define LEAF_NODE_VALUE_OFFSET        (LEAF_NODE_OVERFLOW_OFFSET + LEAF_NODE_OVERFLOW_SIZE)
 #define LEAF_NODE_SPACE_FOR_CELLS   (PAGE_SIZE - LEAF_NODE_HEADER_SIZE)
 #define LEAF_NODE_MAX_CELLS         ((LEAF_NODE_SPACE_FOR_CELLS) / (LEAF_NODE_CELL_SIZE))
 
 // 节点分裂
 #define LEAF_NODE_RIGHT_SPLIT_COUNT  ((LEAF_NODE_MAX_CELLS + 1) / 2)
 #define LEAF_NODE_LEFT_SPLIT_COUNT   ((LEAF_NODE_MAX_CELLS + 1) - LEAF_NODE_RIGHT_SPLIT_COUNT)
+// 在最右叶子末尾追加导致的分裂按 90/10 划分: 左侧接近写满, 少量空位留给稍晚到达的乱序 key
+#define LEAF_NODE_APPEND_LEFT_SPLIT_COUNT  ((LEAF_NODE_MAX_CELLS + 1) * 9 / 10)
 
 // 内部节点 header：key 个数 + right child pointer
 #define INTERNAL_NODE_NUM_KEYS_SIZE     sizeof(uint32_t)
@@ -71,12 +86,67 @@
 #define INTERNAL_NODE_HEADER_SIZE         (COMMON_NODE_HEADER_SIZE + INTERNAL_NODE_NUM_KEYS_SIZE + INTERNAL_NODE_RIGHT_CHILD_SIZE)
 
 // 内部节点 body: child + key
-#define INTERNAL_NODE_KEY_SIZE      sizeof(uint32_t)
+#define INTERNAL_NODE_KEY_SIZE      sizeof(uint64_t)
 #define INTERNAL_NODE_CHILD_SIZE    sizeof(uint32_t)
 #define INTERNAL_NODE_CELL_SIZE     (INTERNAL_NODE_CHILD_SIZE + INTERNAL_NODE_KEY_SIZE)
-
-#define DEBUG(msg) printf("debug: %s\n", msg)
-#define DEBUGS(format, args...) printf("debug: ", args)
+#define INTERNAL_NODE_SPACE_FOR_CELLS (PAGE_SIZE - INTERNAL_NODE_HEADER_SIZE)
+#define INTERNAL_NODE_MAX_CELLS     ((INTERNAL_NODE_SPACE_FOR_CELLS) / (INTERNAL_NODE_CELL_SIZE))
+// 最右内部节点末尾追加孩子导致的分裂同样按 90/10 划分 (分裂时共 MAX + 2 个孩子)
+#define INTERNAL_NODE_APPEND_LEFT_SPLIT_COUNT  ((INTERNAL_NODE_MAX_CELLS + 2) * 9 / 10)
+
+// 文本 key 节点 (前缀压缩):
+// 公共头 + cell 个数 + 右指针 (叶子: 下一叶子; 内部: right child) + 节点前缀长度 + cell 区起点
+// header 之后依次为: 节点内所有 key 的公共前缀, cell 偏移数组; cell 区自页尾向前增长
+#define TEXT_NODE_NUM_CELLS_SIZE        sizeof(uint16_t)
+#define TEXT_NODE_RIGHT_SIZE            sizeof(uint32_t)
+#define TEXT_NODE_PREFIX_SIZE_SIZE      sizeof(uint16_t)
+#define TEXT_NODE_CONTENT_START_SIZE    sizeof(uint32_t)
+
+#define TEXT_NODE_NUM_CELLS_OFFSET      COMMON_NODE_HEADER_SIZE
+#define TEXT_NODE_RIGHT_OFFSET          (TEXT_NODE_NUM_CELLS_OFFSET + TEXT_NODE_NUM_CELLS_SIZE)
+#define TEXT_NODE_PREFIX_SIZE_OFFSET    (TEXT_NODE_RIGHT_OFFSET + TEXT_NODE_RIGHT_SIZE)
+#define TEXT_NODE_CONTENT_START_OFFSET  (TEXT_NODE_PREFIX_SIZE_OFFSET + TEXT_NODE_PREFIX_SIZE_SIZE)
+#define TEXT_NODE_HEADER_SIZE           (TEXT_NODE_CONTENT_START_OFFSET + TEXT_NODE_CONTENT_START_SIZE)
+#define TEXT_NODE_OFFSET_SIZE           sizeof(uint16_t)
+
+// 叶子 cell: 后缀长度 + value 长度 + 后缀 + value
+#define TEXT_LEAF_CELL_HEADER_SIZE      (2 * sizeof(uint16_t))
+// 内部 cell: 孩子页号 + 后缀长度 + 后缀 (截断后的分隔 key)
+#define TEXT_INTERNAL_CELL_HEADER_SIZE  (sizeof(uint32_t) + sizeof(uint16_t))
+
+#define TEXT_KEY_MAX_SIZE               (COLUMN_EMAIL_SIZE + 1 + sizeof(uint64_t)) // 二级索引的 key: 列值 + '\0' + id
+#define TEXT_VALUE_MAX_SIZE             512
+
+// 溢出页: 下一溢出页 + 数据
+#define OVERFLOW_PAGE_NEXT_SIZE     sizeof(uint32_t)
+#define OVERFLOW_PAGE_DATA_SIZE     (PAGE_SIZE - OVERFLOW_PAGE_NEXT_SIZE)
+
+// 哈希索引目录页: 全局深度 + [桶页号, ...] (2^全局深度 项)
+#define HASH_DIR_DEPTH_SIZE         sizeof(uint32_t)
+#define HASH_DIR_ENTRY_SIZE         sizeof(uint32_t)
+#define HASH_DIR_MAX_DEPTH          9   // 2^9 项, 一页目录可容纳
+
+// 哈希桶页: 局部深度 + 项数 + 溢出桶页号 + [key : 叶子页号, ...]
+#define HASH_BUCKET_DEPTH_OFFSET    0
+#define HASH_BUCKET_COUNT_OFFSET    sizeof(uint32_t)
+#define HASH_BUCKET_NEXT_OFFSET     (2 * sizeof(uint32_t))
+#define HASH_BUCKET_HEADER_SIZE     (3 * sizeof(uint32_t))
+#define HASH_ENTRY_KEY_SIZE         sizeof(uint64_t)
+#define HASH_ENTRY_PAGE_SIZE        sizeof(uint32_t)
+#define HASH_ENTRY_SIZE             (HASH_ENTRY_KEY_SIZE + HASH_ENTRY_PAGE_SIZE)
+#define HASH_BUCKET_MAX_ENTRIES     ((PAGE_SIZE - HASH_BUCKET_HEADER_SIZE) / HASH_ENTRY_SIZE)
+
+// 运行时日志级别, 默认只输出错误
+typedef enum {
+    LOG_LEVEL_ERROR,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_DEBUG,
+} LogLevel;
+
+extern LogLevel db_log_level;
+
+#define DEBUG(msg) do { if (db_log_level >= LOG_LEVEL_DEBUG) printf("debug: %s\n", msg); } while (0)
+#define DEBUGS(format, args...) do { if (db_log_level >= LOG_LEVEL_DEBUG) printf("debug: " format "\n", ##args); } while (0)
 
 #define ERROR(msg) printf("error: %s\n", msg)
 #endif
\ No newline at end of file
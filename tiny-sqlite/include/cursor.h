@@ -3,6 +3,7 @@
 
 #include "config.h"
 #include "table.h"
+#include "record.h"
 
 
 typedef struct {
@@ -20,10 +21,20 @@ Cursor* table_end(Table* table);
 
 // 如果key 存在, 返回所在游标；
 // 如果不存在, 返回需要插入的位置；
-Cursor* table_find(Table* table, uint32_t key_to_insert);
+Cursor* table_find(Table* table, uint64_t key_to_insert);
+
+// key 大于表中所有 key 时返回最右叶子末尾的游标 (使用缓存的最右叶子页号, 不经过树的查找), 否则返回 NULL
+Cursor* table_append_cursor(Table* table, uint64_t key);
+
+// 点查: key 存在时返回所在游标, 否则返回 NULL; 启用哈希索引时不经过树的内部节点
+Cursor* table_lookup(Table* table, uint64_t key);
 
 // 移动游标
 void cursor_advance(Cursor* cursor); 
 
+// 内联 payload 起始地址
 void* cursor_value(Cursor* cursor);
+
+// 读取游标所指行的前 size 字节并反序列化, 只需要 id、username 时传 EMAIL_OFFSET 可避免访问溢出页
+void cursor_row(Cursor* cursor, Row* row, uint32_t size);
 #endif
\ No newline at end of file
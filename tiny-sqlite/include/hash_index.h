@@ -0,0 +1,33 @@
+#ifndef _HASH_INDEX_H_
+#define _HASH_INDEX_H_
+
+#include "config.h"
+#include "page.h"
+#include "table.h"
+
+/*
+  主键 id -> 所在叶子页号 的可扩展哈希索引 (布局见 config.h), 目录页号记录在文件头中:
+  - 目录按 hash 低 全局深度 位定位桶, 点查只需读目录页 + 桶页, 与树高无关;
+  - 桶满时分裂 (必要时目录翻倍), 目录达到最大深度后改为挂溢出桶;
+  - 树中 cell 移动到其他叶子时 (分裂、根节点变化) 需同步更新; 删除不合并桶
+*/
+
+bool hash_index_enabled(Pager* pager);
+
+// 为整数主键表建立索引 (扫描全部叶子)
+void hash_index_create(Table* table);
+
+// 删除索引并回收全部页
+void hash_index_drop(Pager* pager);
+
+// 插入或更新 key 所在的叶子页
+void hash_index_put(Pager* pager, uint64_t key, uint32_t page_num);
+
+// 将叶子中所有 key 指向该叶子 (cell 整体移动后调用)
+void hash_index_put_leaf(Pager* pager, uint32_t page_num);
+
+void hash_index_delete(Pager* pager, uint64_t key);
+
+// 返回 key 所在叶子页号, 不存在时返回 0 (page 0 为文件头, 不会是叶子)
+uint32_t hash_index_get(Pager* pager, uint64_t key);
+#endif
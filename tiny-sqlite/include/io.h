@@ -0,0 +1,29 @@
+#ifndef _IO_H_
+#define _IO_H_
+
+#include "config.h"
+
+/*
+  数据库文件的读写与刷盘都经过这一层 (page / shadow / vacuum),
+  默认直接调用系统调用; 测试可替换为模拟掉电、撕裂写的实现 (见 tests/crash_test.c)
+  备份与排序的临时文件不经过这一层
+*/
+
+typedef struct {
+    ssize_t (*pread)(int fd, void* buffer, size_t size, off_t offset);
+    ssize_t (*pwrite)(int fd, const void* buffer, size_t size, off_t offset);
+    int (*fsync)(int fd);
+    int (*fdatasync)(int fd);
+} IoMethods;
+
+// 替换 I/O 实现, NULL 恢复为系统调用
+void io_set_methods(const IoMethods* methods);
+
+ssize_t io_pread(int fd, void* buffer, size_t size, off_t offset);
+
+ssize_t io_pwrite(int fd, const void* buffer, size_t size, off_t offset);
+
+int io_fsync(int fd);
+
+int io_fdatasync(int fd);
+#endif
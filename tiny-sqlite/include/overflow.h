@@ -0,0 +1,20 @@
+#ifndef _OVERFLOW_H_
+#define _OVERFLOW_H_
+
+#include "config.h"
+#include "page.h"
+
+/*
+  溢出页链表: [next : data] -> [next : data] -> ... -> 0
+  用于存放 cell 内联部分放不下的 payload 尾部
+*/
+
+// 写入 size 字节, 返回首个溢出页页号 (size 为 0 时返回 0)
+uint32_t overflow_write(Pager* pager, void* data, uint32_t size);
+
+// 从 page_num 开始读取 size 字节到 buffer
+void overflow_read(Pager* pager, uint32_t page_num, void* buffer, uint32_t size);
+
+// 释放整条溢出页链表
+void overflow_free(Pager* pager, uint32_t page_num);
+#endif
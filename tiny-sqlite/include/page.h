@@ -2,20 +2,101 @@
 #define _PAGE_H_
 
 #include "config.h"
+#include "bloom.h"
+
+// 文件头, 固定位于 page 0; 打开数据库只读取这一页
+#define DB_HEADER_MAGIC      "tiny-sqlite 1"
+#define DB_HEADER_MAGIC_SIZE 16
+#define DB_FORMAT_VERSION    1 // 0 为没有以下元数据字段的旧文件, 打开时升级
 
 typedef struct {
+    char magic[DB_HEADER_MAGIC_SIZE];
+    uint32_t root_page_num;   // 根节点所在页
+    uint32_t freelist_trunk;  // 首个空闲 trunk 页, 0 表示没有空闲页
+    uint32_t freelist_count;  // 空闲页总数 (含 trunk 页)
+    uint32_t key_type;        // 主键类型, 见 table.h 中的 KeyType
+    uint32_t hash_index_page; // 哈希索引目录页, 0 表示未启用 (见 hash_index.h)
+    uint32_t format_version;
+    uint32_t page_size;
+    uint32_t page_count;      // 文件页数, 文件头每次写回时更新, 打开时用于检查文件是否被截断
+    uint32_t tree_height;     // 主键树高度, 根分裂和收缩时维护
+    uint64_t row_count;       // 行数, 插入和删除成功时维护, count(*) 直接读取
+    uint32_t index_root_page; // 二级索引根页, 0 表示没有 (见 secondary_index.h)
+    uint32_t index_column;    // 被索引的列与附加列 (row_columns 下标 / 位图)
+    uint32_t index_include;
+} DbHeader;
+
+// 空闲 trunk 页: 下一个 trunk + 叶子个数 + [叶子页号, ...]
+#define FREELIST_TRUNK_NEXT_OFFSET   0
+#define FREELIST_TRUNK_COUNT_OFFSET  sizeof(uint32_t)
+#define FREELIST_TRUNK_HEADER_SIZE   (2 * sizeof(uint32_t))
+#define FREELIST_TRUNK_MAX_LEAVES    ((PAGE_SIZE - FREELIST_TRUNK_HEADER_SIZE) / sizeof(uint32_t))
+
+// 新建数据库时选择的提交方式, 已有文件沿用创建时的方式
+typedef enum {
+    COMMIT_IN_PLACE, // 页在淘汰和关闭时原地写回
+    COMMIT_SHADOW,   // 影子分页, 见 shadow.h
+} CommitMode;
+
+// 同一文件 (st_dev, st_ino) 在进程内只有一个 Pager, 各 Table 句柄共享并引用计数; 页内容在 page_cache 中
+typedef struct Pager {
     int file_descirptor;
+    char *file_name;
+    dev_t dev;
+    ino_t ino;
+    uint32_t ref_count;
     uint32_t file_len;
     uint32_t num_pages; // 记录当前使用 page 的数量
-    void *pages[TABLE_MAX_PAGES];
+    uint64_t version;   // 数据修改计数, 插入 / 删除成功和文件被替换时递增, 查询结果缓存据此失效
+    BloomFilter *key_filter; // 主键 Bloom filter, 由 table 层按需构建, 同一文件的句柄共享
+    uint32_t rightmost_leaf; // 最右叶子页号缓存 (追加快速路径), 0 表示未知; 该页被释放时清零
+    struct Backup *backup;   // 进行中的在线备份, get_page 时登记被访问的页 (见 backup.h)
+    struct Shadow *shadow;   // 影子分页模式的页映射, 原地写回模式为 NULL
+    struct Pager *next; // 已打开的 Pager 链表
 } Pager;
 
+void pager_set_commit_mode(CommitMode mode);
+
+// 新建数据库使用的页大小 (PAGE_SIZE_MIN 到 PAGE_SIZE_MAX 之间的 2 的幂), 不合法时返回 false
+bool pager_set_page_size(uint32_t page_size);
+
+// 打开文件, 该文件已被打开时返回已有的 Pager 并增加引用计数
+// 文件无法打开、格式错误或页大小与已打开的数据库不同时打印错误并返回 NULL
 Pager* pager_open(const char *file_name);
 
+// 减少引用计数, 最后一个引用释放时写回全部缓存页并关闭文件
+void pager_close(Pager* pager);
+
+// 文件已被整体替换 (vacuum): 丢弃缓存页并重新打开
+void pager_reload(Pager* pager);
+
+// 取页用于读取; 修改页内容前需经 pager_mark_dirty 标记, 否则修改不会写回
 void* get_page(Pager* pager, uint32_t page_num);
 
+// 取页并标记为脏
+void* get_page_for_write(Pager* pager, uint32_t page_num);
+
+// 标记页被修改
+void pager_mark_dirty(Pager* pager, uint32_t page_num);
+
+DbHeader* pager_header(Pager* pager);
+
+// 取文件头并标记为脏
+DbHeader* pager_header_for_write(Pager* pager);
+
+// 优先从空闲链表中取页, 没有则追加到文件末尾
 uint32_t get_unused_page_num(Pager* pager);
 
-void pager_flush(Pager *pager, uint32_t page_num);
+// 将不再使用的页放回空闲链表
+void pager_free_page(Pager* pager, uint32_t page_num);
+
+// 写回全部缓存页
+void pager_flush(Pager *pager);
+
+// 影子分页模式: 写回脏页并原子提交; 原地写回模式下不做任何事
+void pager_commit(Pager *pager);
+
+// 将 data 写入文件中的 page_num 处
+void pager_write_page(Pager *pager, uint32_t page_num, void *data);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,60 @@
+#ifndef _PAGE_CACHE_H_
+#define _PAGE_CACHE_H_
+
+#include "config.h"
+#include "page.h"
+
+/*
+  进程内所有 Pager 共享的页缓存:
+  - 以 (Pager, 页号) 为 key, 同一文件的多次打开共享同一个 Pager, 因此以文件身份区分;
+  - 所有页共用一个内存预算, 超出时按 LRU 淘汰, 被修改过的页 (脏页) 淘汰前写回磁盘;
+  - 调用方会在一条语句内持有多个页指针, 因此当前语句访问过的页不会被淘汰 (隐式 pin),
+    这些页全部被 pin 时允许暂时超出预算
+  - 页帧按预算一次性从连续的 arena 中分配 (mmap, 可选大页), 不再逐页 malloc;
+    超出预算的临时帧单独分配, 移除时释放
+*/
+
+typedef enum {
+    PAGE_CACHE_ARENA_NORMAL,
+    PAGE_CACHE_ARENA_THP,     // 普通映射 + madvise(MADV_HUGEPAGE)
+    PAGE_CACHE_ARENA_HUGETLB, // MAP_HUGETLB
+} PageCacheArenaKind;
+
+// 设置内存预算 (字节), 立即淘汰超出的部分
+void page_cache_set_budget(size_t bytes);
+
+size_t page_cache_budget();
+
+// 设置帧大小 (即 PAGE_SIZE), 只能在缓存为空时调用, 由 pager_open 在打开第一个数据库时设置
+void page_cache_set_page_size(uint32_t page_size);
+
+// 之后分配的 arena 尝试使用大页
+void page_cache_set_huge_pages(bool enabled);
+
+// 已分配 arena 使用的页类型
+PageCacheArenaKind page_cache_arena_kind();
+
+// 当前缓存的页数
+uint32_t page_cache_num_pages();
+
+// 解除隐式 pin: 之前访问过的页重新变为可淘汰 (每条语句开始时调用; 调用方不能再持有之前取得的页指针)
+void page_cache_unpin_all();
+
+// 取缓存中的页, 不存在时返回 NULL
+void* page_cache_lookup(Pager* pager, uint32_t page_num);
+
+// 只读地查看缓存中的页: 不标记为脏, 不调整 LRU, 不 pin (在线备份使用)
+void* page_cache_peek(Pager* pager, uint32_t page_num);
+
+// 为页分配缓存空间 (必要时先淘汰其他页), 内容由调用方填充
+void* page_cache_insert(Pager* pager, uint32_t page_num);
+
+// 标记缓存中的页已被修改, 淘汰和 flush 时只写回脏页; 该页不在缓存中时返回 false
+bool page_cache_mark_dirty(Pager* pager, uint32_t page_num);
+
+// 写回 pager 的全部缓存页
+void page_cache_flush_pager(Pager* pager);
+
+// 丢弃 pager 的全部缓存页, 不写回
+void page_cache_drop_pager(Pager* pager);
+#endif
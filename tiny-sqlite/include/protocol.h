@@ -0,0 +1,111 @@
+#ifndef _PROTOCOL_H_
+#define _PROTOCOL_H_
+
+#include "config.h"
+
+/*
+  服务端二进制协议 (Unix domain socket, 整数按主机字节序):
+  帧: [u32 长度 (类型 + payload)][u8 类型][payload]
+
+  请求                                                       响应
+  PREPARE  [sql, 参数位置写 ?]                               PREPARED [u32 stmt_id][u16 参数个数]
+  BIND     [u32 stmt_id][u16 参数下标][参数]                 OK
+  STEP     [u32 stmt_id]                                     ROW* DONE
+  BATCH    [u32 stmt_id][u32 组数] 组数 x (参数个数 x [参数]) ROW* DONE
+  FINALIZE [u32 stmt_id]                                     OK
+  BACKUP   [目标路径]                                        备份完成后 OK (见 backup.h)
+  出错时响应 ERROR [u8 错误码][消息文本]
+
+  参数:  [u8 PARAM_INT][u64] 或 [u8 PARAM_TEXT][u16 长度][bytes]
+  ROW:   [u64 id][u16 长度][username][u16 长度][email]
+  DONE:  [u8 ExecuteResult][u32 成功的语句数][u32 返回的行数]
+         BATCH 中任一组失败时 ExecuteResult 为最后一个失败的结果, 其余组照常执行
+*/
+#define PROTOCOL_LENGTH_SIZE       sizeof(uint32_t)
+#define PROTOCOL_HEADER_SIZE       (PROTOCOL_LENGTH_SIZE + sizeof(uint8_t))
+#define PROTOCOL_MAX_FRAME_SIZE    (1 << 20)
+
+typedef enum {
+    FRAME_PREPARE = 1,
+    FRAME_BIND,
+    FRAME_STEP,
+    FRAME_BATCH,
+    FRAME_FINALIZE,
+    FRAME_BACKUP,
+
+    FRAME_PREPARED = 0x81,
+    FRAME_OK,
+    FRAME_ROW,
+    FRAME_DONE,
+    FRAME_ERROR,
+} FrameType;
+
+typedef enum {
+    PARAM_INT = 1,
+    PARAM_TEXT,
+} ParamKind;
+
+typedef enum {
+    PROTOCOL_ERROR_MALFORMED = 1,   // 帧内容不完整或类型未知
+    PROTOCOL_ERROR_SYNTAX,          // PREPARE 的 sql 无法解析
+    PROTOCOL_ERROR_UNKNOWN_STMT,    // stmt_id 不存在
+    PROTOCOL_ERROR_BAD_PARAM,       // 参数下标越界或值不合法
+    PROTOCOL_ERROR_TOO_MANY_STMTS,  // 连接上预编译语句过多
+    PROTOCOL_ERROR_BACKUP,          // 已有备份进行中或备份失败
+} ProtocolError;
+
+// 可增长的字节缓冲区, 用于组帧和连接的收发缓冲
+typedef struct {
+    uint8_t* data;
+    size_t length;
+    size_t capacity;
+} ByteBuffer;
+
+void buffer_reserve(ByteBuffer* buffer, size_t extra);
+
+void buffer_put(ByteBuffer* buffer, const void* source, size_t size);
+
+void buffer_put_u8(ByteBuffer* buffer, uint8_t value);
+
+void buffer_put_u16(ByteBuffer* buffer, uint16_t value);
+
+void buffer_put_u32(ByteBuffer* buffer, uint32_t value);
+
+void buffer_put_u64(ByteBuffer* buffer, uint64_t value);
+
+// [u16 长度][bytes]
+void buffer_put_text(ByteBuffer* buffer, const char* text, uint16_t size);
+
+// 丢弃前 size 字节
+void buffer_consume(ByteBuffer* buffer, size_t size);
+
+void buffer_free(ByteBuffer* buffer);
+
+// 写入帧头并返回帧起始位置, payload 写完后调用 frame_end 回填长度
+size_t frame_begin(ByteBuffer* buffer, FrameType type);
+
+void frame_end(ByteBuffer* buffer, size_t frame_start);
+
+// data 开头是完整的帧时返回帧总长度 (含长度字段), 否则返回 0
+size_t frame_complete(const void* data, size_t size);
+
+// 顺序读取 payload, 越界时置 overrun 并返回 0
+typedef struct {
+    const uint8_t* position;
+    size_t remaining;
+    bool overrun;
+} FrameReader;
+
+void reader_init(FrameReader* reader, const void* payload, size_t size);
+
+uint8_t reader_u8(FrameReader* reader);
+
+uint16_t reader_u16(FrameReader* reader);
+
+uint32_t reader_u32(FrameReader* reader);
+
+uint64_t reader_u64(FrameReader* reader);
+
+// 读取 [u16 长度][bytes], 返回指向 payload 内部的指针 (不以 '\0' 结尾)
+const char* reader_text(FrameReader* reader, uint16_t* size);
+#endif
@@ -1,29 +1,78 @@
 #ifndef _RECORD_H_
 #define _RECORD_H_
 
+#include <stddef.h>
+
 #include "config.h"
 
 #define size_of_attribute(_struct, _attribute) sizeof(((_struct*)0)->_attribute)
 
-typedef struct {
-    uint32_t id;
-    char username[COLUMN_USERNAME_SIZE];
-    char email[COLUMN_EMAIL_SIZE];
-} Row;
+// 表结构见 schema.def, 以下内容均由其展开
+
+// 内存中的行
+#define TABLE(type, suffix)                         typedef struct {
+#define COLUMN_U64(type, suffix, name)              uint64_t name;
+#define COLUMN_TEXT(type, suffix, name, size)       char name[size];
+#define COLUMN_TAIL_TEXT(type, suffix, name, size)  char name[size];
+#define TABLE_END(type, suffix)                     } type;
+#include "schema.def"
+
+// 磁盘布局: 各列紧密排列, 偏移和最大长度在编译期确定
+#define TABLE(type, suffix)                         typedef struct __attribute__((packed)) {
+#define COLUMN_U64(type, suffix, name)              uint64_t name;
+#define COLUMN_TEXT(type, suffix, name, size)       char name[size];
+#define COLUMN_TAIL_TEXT(type, suffix, name, size)  char name[size];
+#define TABLE_END(type, suffix)                     } type##Disk;
+#include "schema.def"
+
+#define RECORD_OFFSET(type, name)  offsetof(type##Disk, name)
+#define RECORD_MAX_SIZE(type)      sizeof(type##Disk)
 
-#define ID_SIZE         4
-#define USERNAME_SIZE   32
-#define EMAIL_SIZE      255
+#define ID_OFFSET       RECORD_OFFSET(Row, id)
+#define USERNAME_OFFSET RECORD_OFFSET(Row, username)
+#define EMAIL_OFFSET    RECORD_OFFSET(Row, email)
 
-#define ID_OFFSET       0
-#define USERNAME_OFFSET 4
-#define EMAIL_OFFSET    259
+_Static_assert(RECORD_MAX_SIZE(Row) == ROW_SIZE, "ROW_SIZE does not match schema.def");
+
+typedef enum {
+    COLUMN_KIND_U64,
+    COLUMN_KIND_TEXT,
+} ColumnKind;
+
+// 按某一列比较两条记录, 返回值同 strcmp
+typedef int (*RecordCompare)(const void* a, const void* b);
+
+typedef struct {
+    const char* name;
+    ColumnKind kind;
+    uint32_t size;
+    uint32_t offset;        // 在内存结构体中的偏移
+    uint32_t record_end;    // 磁盘布局中该列之后的偏移, 只需该列及之前的列时读取这么多字节即可
+    RecordCompare compare;
+} ColumnInfo;
 
-// 数据库行记录序列化
-void serialize_row(Row *source, void *destination);
+/*
+  每张表生成:
+  uint32_t serialize_<suffix>(type* source, void* destination)
+    序列化, 变长的最后一列末尾 '\0' 不写入, 返回实际长度;
+  void deserialize_<suffix>(void* source, uint32_t size, type* destination)
+    反序列化, size 之后的部分按 '\0' 处理;
+  int compare_<suffix>_<列名>(const void* a, const void* b);
+  const ColumnInfo <suffix>_columns[], const uint32_t <suffix>_num_columns
+*/
+#define TABLE(type, suffix) \
+    uint32_t serialize_##suffix(type* source, void* destination); \
+    void deserialize_##suffix(void* source, uint32_t size, type* destination);
+#define COLUMN_U64(type, suffix, name)              int compare_##suffix##_##name(const void* a, const void* b);
+#define COLUMN_TEXT(type, suffix, name, size)       int compare_##suffix##_##name(const void* a, const void* b);
+#define COLUMN_TAIL_TEXT(type, suffix, name, size)  int compare_##suffix##_##name(const void* a, const void* b);
+#define TABLE_END(type, suffix) \
+    extern const ColumnInfo suffix##_columns[]; \
+    extern const uint32_t suffix##_num_columns;
+#include "schema.def"
 
-// 反序列化
-void deserialize_row(void *source, Row *destination);
+// 按列名查找, 不存在时返回 NULL
+const ColumnInfo* find_column(const ColumnInfo* columns, uint32_t num_columns, const char* name);
 
 void print_row(Row* row);
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,47 @@
+#ifndef _RESULT_CACHE_H_
+#define _RESULT_CACHE_H_
+
+#include "config.h"
+#include "page.h"
+#include "record.h"
+
+#define RESULT_CACHE_MIN_BUCKETS 64
+
+/*
+  查询结果缓存 (select / 点查), 默认关闭, 用 .resultcache <KB> 或 --result-cache=<KB> 设置预算:
+  - 以 (Pager, 规范化的语句) 为 key, 语句由解析并绑定参数后的 Statement 生成, 与原始 SQL 的写法无关;
+  - 每项记录生成时的 pager->version (插入 / 删除成功时递增), 查到版本不一致的项直接丢弃;
+  - 结果按序列化后的行连续存放 ([长度 : 记录] ...), 命中时逐行反序列化输出, 不再扫描叶子;
+  - 所有项共用一个内存预算, 超出时按 LRU 淘汰; 超过预算 1/4 的结果不缓存
+*/
+
+typedef void (*CachedRowSink)(Row* row, void* arg);
+
+// 一次执行过程中收集的结果
+typedef struct ResultBuilder ResultBuilder;
+
+// 设置内存预算 (字节), 0 表示关闭并清空
+void result_cache_set_budget(size_t bytes);
+
+size_t result_cache_budget();
+
+// 已缓存结果占用的字节数
+size_t result_cache_used();
+
+bool result_cache_enabled();
+
+// 命中时把缓存的行依次交给 sink, status 为当时的执行结果, 返回 true
+bool result_cache_replay(Pager* pager, const char* key, CachedRowSink sink, void* arg, uint32_t* status);
+
+// 未命中时开始收集结果
+ResultBuilder* result_builder_new();
+
+// 收集一行, 结果超出可缓存的大小后不再保存
+void result_builder_add(ResultBuilder* builder, Row* row);
+
+// 保存收集到的结果并释放 builder
+void result_cache_store(Pager* pager, const char* key, ResultBuilder* builder, uint32_t status);
+
+// 丢弃 pager 的全部结果 (关闭文件时)
+void result_cache_drop_pager(Pager* pager);
+#endif
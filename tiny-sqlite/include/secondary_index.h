@@ -0,0 +1,40 @@
+#ifndef _SECONDARY_INDEX_H_
+#define _SECONDARY_INDEX_H_
+
+#include "config.h"
+#include "page.h"
+#include "record.h"
+#include "table.h"
+
+/*
+  整数主键表上某一文本列的二级索引, 用文本 key 树保存 (见 text_tree.h), 根页号和列信息记录在文件头中:
+  - key 为 列值 + '\0' + 大端 id, 相同列值的行按 id 排列, 列值相等的行在树中连续;
+  - value 为建索引时指定的附加列 (INCLUDE), 每列为 8 字节整数或 2 字节长度 + 文本;
+  - 索引列、id 和附加列覆盖了整行时 (覆盖索引) 查找只访问索引树, 否则按 id 回表;
+  - 插入 / 删除成功时同步维护; 每个文件最多一个二级索引
+*/
+
+// 索引中得到的行
+typedef void (*IndexRowSink)(Row* row, void* arg);
+
+bool secondary_index_enabled(Pager* pager);
+
+// 被索引的列, 未启用时返回 NULL
+const ColumnInfo* secondary_index_column(Pager* pager);
+
+// 索引是否覆盖整行
+bool secondary_index_covering(Pager* pager);
+
+// 为 column 建立索引 (扫描全表), include 为附加列的位图 (按 row_columns 下标); 已有的索引先删除
+bool secondary_index_create(Table* table, const ColumnInfo* column, uint32_t include);
+
+// 删除索引并回收全部页
+void secondary_index_drop(Pager* pager);
+
+void secondary_index_insert(Table* table, Row* row);
+
+void secondary_index_delete(Table* table, Row* row);
+
+// 找出索引列等于 value 的全部行, 按 id 顺序交给 sink, 返回行数
+uint32_t secondary_index_lookup(Table* table, const char* value, IndexRowSink sink, void* arg);
+#endif
@@ -0,0 +1,25 @@
+#ifndef _SERVER_H_
+#define _SERVER_H_
+
+#include "config.h"
+#include "table.h"
+
+#define SERVER_MAX_EVENTS         64
+#define SERVER_LISTEN_BACKLOG     128
+#define SERVER_READ_SIZE          (64 * 1024)  // 每次可读事件最多读取的字节数, 各连接轮流处理
+#define SERVER_MAX_STATEMENTS     64           // 每个连接的预编译语句数上限
+#define SERVER_MAX_PARAMS         3            // insert 最多 3 个参数
+#define SERVER_MAX_SQL            256
+#define SERVER_OUTPUT_HIGH_WATER  (4 << 20)    // 待发送数据超过该值时暂停处理该连接的请求
+
+/*
+  服务端模式 (db <file> --serve=<socket>), 协议见 protocol.h:
+  - 单线程 epoll 事件循环, 所有连接共享同一个 Table / Pager 和全局页缓存,
+    语句按到达顺序串行执行, 不需要加锁;
+  - PREPARE 时解析一次 sql 并记录每个 ? 对应的列, BIND 直接写入语句中的行, STEP 不再解析;
+  - 查询结果逐行编码进连接的发送缓冲区, 写不完的部分等待 EPOLLOUT;
+  - BACKUP 请求开始在线备份, 之后事件循环每轮复制一步, 其间照常处理其他请求。
+  收到 SIGINT / SIGTERM 后关闭所有连接并返回, 由调用方 db_close 落盘; 监听失败时返回 false
+*/
+bool server_run(Table* table, const char* socket_path);
+#endif
@@ -0,0 +1,65 @@
+#ifndef _SHADOW_H_
+#define _SHADOW_H_
+
+#include <stddef.h>
+
+#include "config.h"
+
+#define SHADOW_MAGIC          "tiny-sqlite cow"
+#define SHADOW_SLOT_SIZE      (PAGE_SIZE_MIN / 2) // 物理页 0 开头的两个提交槽, 与页大小无关
+#define SHADOW_MAX_MAP_PAGES  250
+#define SHADOW_MAP_ENTRIES    (PAGE_SIZE / sizeof(ShadowMapEntry))
+
+/*
+  影子分页 (copy-on-write) 提交模式, 新建数据库时用 --commit=shadow 选择:
+  - 上层照常使用逻辑页号, 页映射表记录每个逻辑页所在的物理页及校验和;
+  - 已提交状态引用的物理页不会被覆盖: 页第一次写回时分配空闲物理页, 同一事务内再次写回覆盖该位置;
+  - 提交: 写回脏页 (内容未变的跳过) -> 写出有变化的映射表页 -> 把新的提交头写入另一个槽
+    -> 一次 fdatasync。之后才释放旧版本占用的物理页;
+  - 物理页 0 的两个槽各存一份提交头 (提交计数、逻辑页数、映射表页及其校验和, 整体带校验和);
+    新建文件时先写入计数为 0 的空库提交并落盘, 之后任何时刻崩溃都有可以退回的提交;
+  - 打开时取校验和正确且计数最大的槽, 校验该次提交写入的页 (与另一槽的映射表不同的页),
+    有任何一页不符说明提交未完成, 退回另一个槽; 不需要日志重放
+  逻辑页数上限为 SHADOW_MAX_MAP_PAGES * SHADOW_MAP_ENTRIES
+*/
+
+typedef struct {
+    uint32_t physical; // 0 表示未分配
+    uint32_t checksum;
+} ShadowMapEntry;
+
+typedef struct {
+    char magic[16];
+    uint64_t commit;
+    uint32_t num_pages;       // 逻辑页数
+    uint32_t num_map_pages;
+    uint32_t page_size;
+    uint32_t map_pages[SHADOW_MAX_MAP_PAGES];     // 映射表所在物理页
+    uint32_t map_checksums[SHADOW_MAX_MAP_PAGES];
+    uint32_t checksum;        // 以上内容的校验和
+} ShadowHeader;
+
+_Static_assert(sizeof(ShadowHeader) <= SHADOW_SLOT_SIZE, "shadow header does not fit in a slot");
+
+typedef struct Shadow Shadow;
+
+// 文件开头 2 个槽 (first) 中记录的页大小, 不是影子分页格式时返回 0
+uint32_t shadow_file_page_size(const void* first);
+
+// 文件为空时新建; 文件不是影子分页格式时返回 NULL
+Shadow* shadow_open(int fd, off_t file_len, bool create);
+
+void shadow_close(Shadow* shadow);
+
+// 已提交状态的逻辑页数
+uint32_t shadow_num_pages(Shadow* shadow);
+
+// 读取逻辑页, 未分配时返回 false
+bool shadow_read_page(Shadow* shadow, uint32_t page_num, void* page);
+
+// 写回逻辑页到影子位置
+void shadow_write_page(Shadow* shadow, uint32_t page_num, void* page);
+
+// 提交当前事务 (调用方先写回全部脏页), 没有变化时不写盘
+void shadow_commit(Shadow* shadow, uint32_t num_pages);
+#endif
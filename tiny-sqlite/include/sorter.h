@@ -0,0 +1,34 @@
+#ifndef _SORTER_H_
+#define _SORTER_H_
+
+#include "config.h"
+#include "record.h"
+
+#define SORT_MIN_MEMORY   (64 * 1024)
+#define SORT_MAX_FAN_IN   64           // 一次归并的最多顺串数, 超过时先多路归并成更长的顺串
+#define SORT_RUN_BUFFER   (64 * 1024)  // 每个顺串文件的最小读缓冲
+
+/*
+  select order by <列> [limit N] 使用的排序器, 内存预算由 sorter_set_budget 设置 (.sortmem):
+  - 有 limit 且 N 行放得进预算时维护 N 行的大顶堆 (top-N), 扫描结束后只排序这 N 行;
+  - 否则行缓冲满预算时排序成一个顺串, 序列化后顺序写入临时文件;
+    扫描结束后对所有顺串做 k 路归并 (每个顺串顺序读), 顺串过多时分多趟归并。
+  比较列相同的行再按 id、username 排序, 结果稳定
+*/
+
+typedef void (*SortedRowSink)(Row* row, void* arg);
+
+typedef struct Sorter Sorter;
+
+void sorter_set_budget(size_t bytes);
+
+size_t sorter_budget();
+
+// limit 为 0 表示不限行数
+Sorter* sorter_new(RecordCompare compare, uint32_t limit);
+
+void sorter_add(Sorter* sorter, Row* row);
+
+// 按顺序输出全部 (或前 limit) 行, 并释放排序器
+void sorter_finish(Sorter* sorter, SortedRowSink sink, void* arg);
+#endif
@@ -0,0 +1,55 @@
+#ifndef _STATEMENT_H_
+#define _STATEMENT_H_
+
+#include "config.h"
+#include "record.h"
+#include "table.h"
+#include "stats.h"
+#include "aggregate.h"
+
+typedef enum {
+    PREPARE_SUCCESS,
+    PREPARE_SYNTAX_ERROR,
+    PREPARE_STRING_TOO_LONG,
+    PREPARE_NEGATIVE_ID,
+    PREPARE_UNRECOGNIZED_STATEMENT,
+} PrepareResult;
+
+typedef enum {
+    STATEMENT_INSERT,
+    STATEMENT_SELECT,
+    STATEMENT_SELECT_KEY, // select where <列> = X, 列为主键时点查, 否则按条件扫描
+    STATEMENT_DELETE,
+    STATEMENT_AGGREGATE, // select count(*) / min / max [group by ...], 只打印到 stdout
+} StatementType;
+
+// 查询结果的输出方式: REPL 打印到 stdout, 服务端编码后写回客户端
+typedef void (*RowSink)(Row* row, void* arg);
+
+typedef struct {
+    StatementType type;
+    Row row_to_insert;
+    const ColumnInfo* order_by; // select order by <列>, NULL 时按主键顺序
+    uint32_t limit;             // 0 表示不限
+    Filter filter;              // select / 聚合的 where 条件
+    AggregateQuery aggregate;
+    RowSink row_sink;  // NULL 时使用 print_row
+    void* sink_arg;
+} Statement;
+
+typedef enum {
+    EXECUTE_DUPLICATE_KEY,
+    EXECUTE_KEY_NOT_FOUND,
+    EXECUTE_TABLE_FULL,
+    EXECUTE_SUCCESS,
+} ExecuteResult;
+
+// 解析insert、select 等命令, row_sink 置为 NULL
+PrepareResult prepare_statement(const char* sql, Statement* statement);
+
+// 根据 statement-> type 执行相应的sql语句
+ExecuteResult execute_statement(Statement* statement, Table* table);
+
+// 语句对应的统计类型
+StatsStatementType statement_stats_type(StatementType type);
+#endif
@@ -0,0 +1,97 @@
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include "config.h"
+#include "table.h"
+
+#define CACHE_LINE_SIZE         64
+#define STATS_LATENCY_BUCKETS   32   // 按 log2(微秒) 分桶: [2^i, 2^(i+1)) us
+
+// 统计的语句类型
+typedef enum {
+    STATS_STMT_INSERT,
+    STATS_STMT_SELECT,
+    STATS_STMT_DELETE,
+    STATS_STMT_TYPES,
+} StatsStatementType;
+
+// 每组计数器独占 cache line，避免不同组之间的伪共享
+typedef struct {
+    uint64_t page_hits;       // get_page 命中缓存
+    uint64_t page_misses;     // get_page 未命中
+    uint64_t page_reads;      // 实际从磁盘读取的页数
+    uint64_t page_writes;     // 实际写入磁盘的页数
+    uint64_t page_evictions;  // 超出缓存预算被淘汰的页数
+    uint64_t bytes_read;
+    uint64_t bytes_flushed;
+    uint64_t commits;         // 影子分页模式下的提交次数 (见 shadow.h)
+} __attribute__((aligned(CACHE_LINE_SIZE))) PagerStats;
+
+typedef struct {
+    uint64_t leaf_splits;
+    uint64_t internal_splits;
+    uint64_t root_splits;
+    uint64_t append_inserts;  // 走追加快速路径的插入
+    uint64_t filter_skips;    // Bloom filter 判定不存在, 跳过重复检查的插入
+} __attribute__((aligned(CACHE_LINE_SIZE))) TreeStats;
+
+typedef struct {
+    uint64_t result_hits;      // 查询结果缓存命中 (见 result_cache.h)
+    uint64_t result_misses;
+    uint64_t result_evictions;
+} __attribute__((aligned(CACHE_LINE_SIZE))) QueryStats;
+
+typedef struct {
+    uint64_t count;
+    uint64_t total_us;
+    uint64_t max_us;
+    uint64_t buckets[STATS_LATENCY_BUCKETS];
+} __attribute__((aligned(CACHE_LINE_SIZE))) LatencyHistogram;
+
+typedef struct {
+    PagerStats pager;
+    TreeStats tree;
+    QueryStats query;
+    LatencyHistogram latency[STATS_STMT_TYPES];
+} Stats;
+
+// 对外暴露的快照: 计数器副本 + 文件头中的树高和行数
+typedef struct {
+    Stats counters;
+    uint32_t tree_height;
+    uint64_t num_rows;
+    uint32_t num_pages;
+    uint32_t free_pages;
+    uint32_t cached_pages;    // 全局页缓存 (所有打开的文件) 中的页数
+    uint32_t cache_budget;    // 全局页缓存预算 (页)
+    uint32_t page_size;
+    uint32_t cache_arena;     // 页缓存 arena 的页类型, 见 page_cache.h 中的 PageCacheArenaKind
+    uint64_t result_cache_used;   // 查询结果缓存占用 / 预算 (字节)
+    uint64_t result_cache_budget;
+} StatsSnapshot;
+
+#ifdef DB_STATS
+extern Stats db_stats;
+
+#define STATS_INC(group, field)     (db_stats.group.field++)
+#define STATS_ADD(group, field, n)  (db_stats.group.field += (n))
+#else
+#define STATS_INC(group, field)     ((void)0)
+#define STATS_ADD(group, field, n)  ((void)0)
+#endif
+
+// 单调时钟, 微秒
+uint64_t stats_now_us();
+
+// 记录一次语句执行耗时
+void stats_record_latency(StatsStatementType type, uint64_t elapsed_us);
+
+// 获取当前统计快照
+void stats_snapshot(Table* table, StatsSnapshot* snapshot);
+
+// 清零所有计数器
+void stats_reset();
+
+// 打印统计信息 (.stats)
+void print_stats(Table* table);
+#endif
@@ -4,17 +4,39 @@
 #include "config.h"
 #include "page.h"
 
+// 主键类型: 整数 id 或 username (文本 key 树, 见 text_tree.h)
+typedef enum {
+    KEY_TYPE_INTEGER,
+    KEY_TYPE_TEXT,
+} KeyType;
+
 typedef struct {
     Pager *pager;
     uint32_t root_page_num; // root所在页的索引
+    KeyType key_type;
 } Table; 
 
 // 创建表
 Table* db_open(const char* file_name);
 
+// 创建表, 新建数据库时使用 key_type 作为主键类型; 已有数据库以文件头为准
+// 数据库无法打开时返回 NULL (错误已打印, 见 pager_open)
+Table* db_open_keyed(const char* file_name, KeyType key_type);
+
 // 释放
 void db_close(Table* table);
 
+/*
+  主键 Bloom filter (整数主键表), 第一次需要时扫描全表构建:
+  返回 false 时 key 一定不存在, 插入可跳过重复检查
+*/
+bool table_key_may_exist(Table* table, uint64_t key);
+
+// 插入 / 删除后维护 Bloom filter
+void table_key_inserted(Table* table, uint64_t key);
+
+void table_key_deleted(Table* table, uint64_t key);
+
 // 获取该行写入的地址
 void* row_slot(Table *table, uint32_t row_num);
 #endif
\ No newline at end of file
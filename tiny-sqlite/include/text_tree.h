@@ -0,0 +1,58 @@
+#ifndef _TEXT_TREE_H_
+#define _TEXT_TREE_H_
+
+#include "config.h"
+#include "page.h"
+#include "tree_node.h"
+
+/*
+  以变长字节串为 key 的 B+ 树 (布局见 config.h 中的文本 key 节点):
+  - 节点内所有 key 的公共前缀只存一次, cell 中只存后缀;
+  - 内部节点的分隔 key 截断为能区分左右两侧的最短前缀, 孩子 i 中的 key 满足 key < 分隔 key i;
+  - 节点内通过 cell 偏移数组二分查找, 查找时先与节点前缀比较, 循环中只比较后缀;
+  - 根节点始终位于 root_page_num, 分裂时把原根的内容移到新申请的页中
+*/
+
+typedef struct {
+    Pager* pager;
+    uint32_t page_num;
+    uint32_t cell_num;
+    bool end_of_tree;
+} TextCursor;
+
+// 将 page_num 初始化为空的根叶子
+void text_tree_init(Pager* pager, uint32_t root_page_num);
+
+// 插入 key -> value, key 已存在时返回 false
+bool text_tree_insert(Pager* pager, uint32_t root_page_num, const void* key, uint32_t key_size,
+                      const void* value, uint32_t value_size);
+
+// 删除 key, 不存在时返回 false; 叶子被删空时回收该页
+bool text_tree_delete(Pager* pager, uint32_t root_page_num, const void* key, uint32_t key_size);
+
+// 回收整棵树的全部页 (含根)
+void text_tree_free(Pager* pager, uint32_t root_page_num);
+
+// 点查: 找到时将 value 复制到 value (至少 TEXT_VALUE_MAX_SIZE 字节) 并返回长度, 否则返回 -1
+int32_t text_tree_get(Pager* pager, uint32_t root_page_num, const void* key, uint32_t key_size, void* value);
+
+// 定位到首个 >= key 的位置
+void text_tree_seek(Pager* pager, uint32_t root_page_num, const void* key, uint32_t key_size, TextCursor* cursor);
+
+// 定位到最小的 key
+void text_tree_start(Pager* pager, uint32_t root_page_num, TextCursor* cursor);
+
+void text_cursor_advance(TextCursor* cursor);
+
+// 还原完整 key (前缀 + 后缀) 到 key (至少 TEXT_KEY_MAX_SIZE 字节), 返回长度
+uint32_t text_cursor_key(TextCursor* cursor, void* key);
+
+// 返回 value 在页内的地址
+void* text_cursor_value(TextCursor* cursor, uint32_t* value_size);
+
+// 内部节点第 child_num 个孩子 (child_num == cell 个数时为 right child)
+uint32_t text_node_child(void* node, uint32_t child_num);
+
+// 可视化
+void print_text_tree(Pager* pager, uint32_t page_num, uint32_t indentation_level);
+#endif
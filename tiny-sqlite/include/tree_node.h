@@ -8,11 +8,15 @@
 typedef enum {
     NODE_INTERNAL,
     NODE_LEAF,
+    NODE_TEXT_INTERNAL, // 文本 key 节点, 见 text_tree.h
+    NODE_TEXT_LEAF,
 } NodeType;
 
 
 NodeType get_node_type(void* node);
 
+void set_node_type(void* node, NodeType type);
+
 // 判断节点是否是根节点
 bool is_node_root(void* node);
 
@@ -32,21 +36,33 @@ uint32_t* leaf_node_num_cells(void* node);
 void* leaf_node_cell(void* node, uint32_t cell_num);    
 
 // 根据 cell_num 计算对应起始地址就是 cell 开始的key地址
-uint32_t* leaf_node_key(void* node, uint32_t cell_num); 
+uint64_t* leaf_node_key(void* node, uint32_t cell_num); 
 
 uint32_t* leaf_node_next_leaf(void* node);
 
-// 对应 cell 起始地址 + key偏移 = Row 起始地址
+// 对应 cell 起始地址 + 偏移 = 内联 payload 起始地址
 void* leaf_node_value(void* node, uint32_t cell_num);   
 
+// payload (序列化后的 Row) 总长度
+uint32_t* leaf_node_payload_size(void* node, uint32_t cell_num);
+
+// 首个溢出页页号, 0 表示 payload 全部内联
+uint32_t* leaf_node_overflow(void* node, uint32_t cell_num);
+
+// 写入 key 与序列化后的 Row, 超出内联部分的写入溢出页
+void leaf_node_write_cell(Pager* pager, void* node, uint32_t cell_num, uint64_t key, Row* value);
+
+// 读取 payload 前 size 字节, 不超过内联长度时不访问溢出页; 返回实际读取的长度
+uint32_t leaf_node_read_payload(Pager* pager, void* node, uint32_t cell_num, void* buffer, uint32_t size);
+
 void initial_leaf_node(void* node);
 
 void initial_internal_node(void* node);
 
-Cursor* leaf_node_find(Table* table, uint32_t page_num, uint32_t key); // 二分法搜索插入位置
+Cursor* leaf_node_find(Table* table, uint32_t page_num, uint64_t key); // 二分法搜索插入位置
 
 // 叶子节点插入
-void leaf_node_insert(Cursor* cursor, uint32_t key, Row* value);
+void leaf_node_insert(Cursor* cursor, uint64_t key, Row* value);
 
 /*
   分裂已满的目标叶子节点，并插入记录
@@ -54,7 +70,10 @@ void leaf_node_insert(Cursor* cursor, uint32_t key, Row* value);
   key：新插入的cell 的 key；
   value：新插入的 Row；
 */
-void leaf_node_split_and_insert(Cursor* cursor, uint32_t key, Row* value);
+void leaf_node_split_and_insert(Cursor* cursor, uint64_t key, Row* value);
+
+// 删除游标所指 cell, 叶子被删空时回收该页
+void leaf_node_delete(Cursor* cursor);
 
 
 uint32_t* internal_node_num_keys(void* node);
@@ -65,19 +84,29 @@ uint32_t* internal_node_cell(void* node, uint32_t cell_num);
 
 uint32_t* internal_node_child(void* node, uint32_t child_num);
 
-uint32_t* internal_node_key(void* node, uint32_t key_num);
+uint64_t* internal_node_key(void* node, uint32_t key_num);
 
-uint32_t internal_node_find_child(void* node, uint32_t key);
+uint32_t internal_node_find_child(void* node, uint64_t key);
 
-Cursor* internal_node_find(Table* table, uint32_t page_num, uint32_t key);
+Cursor* internal_node_find(Table* table, uint32_t page_num, uint64_t key);
 
 void internal_node_insert(Table* table, uint32_t parent_page_num, uint32_t child_page_num);
 
+// 分裂已满的内部节点，并插入新的孩子
+void internal_node_split_and_insert(Table* table, uint32_t page_num, uint32_t child_page_num);
+
+// 孩子页号在内部节点中的下标 (right child 为 num_keys)
+uint32_t internal_node_child_index(void* node, uint32_t child_page_num);
+
+// 从内部节点中移除孩子, 节点被删空时继续向上移除
+void internal_node_remove_child(Table* table, uint32_t page_num, uint32_t child_page_num);
+
 // 将 old_key -> new_key
-void update_internal_node_key(void* node, uint32_t old_key, uint32_t new_key);
+void update_internal_node_key(void* node, uint64_t old_key, uint64_t new_key);
 
 
-uint32_t get_node_max_key(void* node);
+// 子树中最大的 key (内部节点沿 right child 向下)
+uint64_t get_node_max_key(Pager* pager, void* node);
 
 // 可视化
 void print_tree(Pager* pager, uint32_t page_num, uint32_t indentation_level);
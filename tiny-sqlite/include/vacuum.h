@@ -0,0 +1,14 @@
+#ifndef _VACUUM_H_
+#define _VACUUM_H_
+
+#include "config.h"
+#include "table.h"
+
+/*
+  压缩数据库文件 (.vacuum):
+  按 key 顺序把所有行重写到临时文件, 叶子页写满且连续存放, 其上逐层构建内部节点,
+  空闲页全部丢弃; 完成后 rename 原子替换原文件, 并重新打开 pager。
+  失败时原文件保持不变, 返回 false
+*/
+bool db_vacuum(Table* table);
+#endif
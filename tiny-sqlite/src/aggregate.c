@@ -0,0 +1,500 @@
+#include "../include/aggregate.h"
+
+typedef struct
+{
+  bool present;
+  uint64_t number;
+  char *text; // 文本列的 min / max, 首次更新时按列宽分配
+} AggregateValue;
+
+typedef struct
+{
+  uint64_t hash;
+  uint64_t count;
+  uint32_t key_size;
+  AggregateValue values[AGGREGATE_MAX_FUNCTIONS];
+  char key[]; // 整数列为 8 字节, 文本列不含 '\0'
+} Group;
+
+typedef struct
+{
+  Group **slots; // NULL 为空槽
+  uint32_t capacity;
+  uint32_t count;
+  Group *last; // 最近命中的分组
+} GroupTable;
+
+bool aggregate_parse(const char *sql, AggregateQuery *query, Filter *filter)
+{
+  query->num_functions = 0;
+  query->group_kind = GROUP_NONE;
+  query->group_column = NULL;
+
+  const char *rest = sql;
+  char name[4];
+  char column[32];
+  int consumed;
+  while (true)
+  {
+    if (query->num_functions == AGGREGATE_MAX_FUNCTIONS)
+    {
+      return false;
+    }
+    AggregateSpec *spec = &query->functions[query->num_functions];
+    consumed = 0;
+    sscanf(rest, " count(*)%n", &consumed);
+    if (consumed > 0)
+    {
+      spec->function = AGGREGATE_COUNT;
+      spec->column = NULL;
+    }
+    else if (sscanf(rest, " %3[a-z](%31[a-z_])%n", name, column, &consumed) == 2 && consumed > 0)
+    {
+      if (strcmp(name, "min") == 0)
+      {
+        spec->function = AGGREGATE_MIN;
+      }
+      else if (strcmp(name, "max") == 0)
+      {
+        spec->function = AGGREGATE_MAX;
+      }
+      else
+      {
+        return false;
+      }
+      spec->column = find_column(row_columns, row_num_columns, column);
+      if (spec->column == NULL)
+      {
+        return false;
+      }
+    }
+    else
+    {
+      return false;
+    }
+    query->num_functions += 1;
+    rest += consumed;
+
+    consumed = 0;
+    sscanf(rest, " ,%n", &consumed);
+    if (consumed == 0)
+    {
+      break;
+    }
+    rest += consumed;
+  }
+
+  consumed = filter_parse(rest, filter);
+  if (consumed < 0)
+  {
+    return false;
+  }
+  rest += consumed;
+  if (*rest == '\0')
+  {
+    return true;
+  }
+  consumed = 0;
+  if (sscanf(rest, " group by domain(%31[a-z_])%n", column, &consumed) == 1 && consumed > 0)
+  {
+    query->group_kind = GROUP_DOMAIN;
+  }
+  else if (sscanf(rest, " group by %31[a-z_]%n", column, &consumed) == 1)
+  {
+    query->group_kind = GROUP_COLUMN;
+  }
+  else
+  {
+    return false;
+  }
+  query->group_column = find_column(row_columns, row_num_columns, column);
+  if (query->group_column == NULL ||
+      (query->group_kind == GROUP_DOMAIN && query->group_column->kind != COLUMN_KIND_TEXT))
+  {
+    return false;
+  }
+  return rest[consumed] == '\0';
+}
+
+// 8 字节一组的乘法-移位混合
+static uint64_t hash_bytes(const void *data, uint32_t size)
+{
+  const uint8_t *bytes = data;
+  uint64_t hash = 0x9E3779B97F4A7C15ULL ^ size;
+  while (size > 0)
+  {
+    uint64_t word = 0;
+    uint32_t chunk = size < sizeof(word) ? size : sizeof(word);
+    memcpy(&word, bytes, chunk);
+    hash = (hash ^ word) * 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 32;
+    bytes += chunk;
+    size -= chunk;
+  }
+  hash *= 0xC4CEB9FE1A85EC53ULL;
+  return hash ^ (hash >> 29);
+}
+
+static Group *group_new(const char *key, uint32_t key_size, uint64_t hash)
+{
+  Group *group = calloc(1, sizeof(Group) + key_size);
+  group->hash = hash;
+  group->key_size = key_size;
+  memcpy(group->key, key, key_size);
+  return group;
+}
+
+static void group_table_grow(GroupTable *groups)
+{
+  uint32_t capacity = groups->capacity * 2;
+  Group **slots = calloc(capacity, sizeof(Group *));
+  for (uint32_t i = 0; i < groups->capacity; i++)
+  {
+    Group *group = groups->slots[i];
+    if (group == NULL)
+    {
+      continue;
+    }
+    uint32_t slot = group->hash & (capacity - 1);
+    while (slots[slot] != NULL)
+    {
+      slot = (slot + 1) & (capacity - 1);
+    }
+    slots[slot] = group;
+  }
+  free(groups->slots);
+  groups->slots = slots;
+  groups->capacity = capacity;
+}
+
+static Group *group_find(GroupTable *groups, const char *key, uint32_t key_size)
+{
+  Group *last = groups->last;
+  if (last != NULL && last->key_size == key_size && memcmp(last->key, key, key_size) == 0)
+  {
+    return last;
+  }
+
+  uint64_t hash = hash_bytes(key, key_size);
+  uint32_t mask = groups->capacity - 1;
+  uint32_t slot = hash & mask;
+  for (Group *group; (group = groups->slots[slot]) != NULL; slot = (slot + 1) & mask)
+  {
+    if (group->hash == hash && group->key_size == key_size && memcmp(group->key, key, key_size) == 0)
+    {
+      groups->last = group;
+      return group;
+    }
+  }
+
+  // 新分组, 装载因子保持在 1/2 以下
+  Group *group = group_new(key, key_size, hash);
+  if ((groups->count + 1) * 2 > groups->capacity)
+  {
+    group_table_grow(groups);
+    mask = groups->capacity - 1;
+    slot = hash & mask;
+    while (groups->slots[slot] != NULL)
+    {
+      slot = (slot + 1) & mask;
+    }
+  }
+  groups->slots[slot] = group;
+  groups->count += 1;
+  groups->last = group;
+  return group;
+}
+
+// 分组 key 在列向量中的位置和长度
+static uint32_t group_key(AggregateQuery *query, Batch *batch, uint32_t row, const char **key)
+{
+  if (query->group_kind == GROUP_NONE)
+  {
+    *key = "";
+    return 0;
+  }
+  const ColumnInfo *column = query->group_column;
+  const char *field = batch_column(batch, column, row);
+  *key = field;
+  if (column->kind == COLUMN_KIND_U64)
+  {
+    return sizeof(uint64_t);
+  }
+  uint32_t size = strnlen(field, column->size);
+  if (query->group_kind == GROUP_DOMAIN)
+  {
+    const char *at = memchr(field, '@', size);
+    *key = at ? at + 1 : field + size;
+    return field + size - *key;
+  }
+  return size;
+}
+
+static void value_update_number(AggregateFunction function, AggregateValue *value, uint64_t number)
+{
+  if (!value->present || (function == AGGREGATE_MIN ? number < value->number : number > value->number))
+  {
+    value->present = true;
+    value->number = number;
+  }
+}
+
+static void value_update_text(AggregateFunction function, AggregateValue *value, const char *text, uint32_t size)
+{
+  if (value->present)
+  {
+    int result = strncmp(text, value->text, size);
+    if (function == AGGREGATE_MIN ? result >= 0 : result <= 0)
+    {
+      return;
+    }
+  }
+  else
+  {
+    value->text = malloc(size);
+    value->present = true;
+  }
+  strncpy(value->text, text, size);
+}
+
+// 分组聚合: 逐行定位分组
+static void group_update(AggregateQuery *query, Group *group, Batch *batch, uint32_t row)
+{
+  group->count += 1;
+  for (uint32_t i = 0; i < query->num_functions; i++)
+  {
+    AggregateSpec *spec = &query->functions[i];
+    if (spec->function == AGGREGATE_COUNT)
+    {
+      continue;
+    }
+    const char *field = batch_column(batch, spec->column, row);
+    if (spec->column->kind == COLUMN_KIND_U64)
+    {
+      uint64_t number;
+      memcpy(&number, field, sizeof(number));
+      value_update_number(spec->function, &group->values[i], number);
+    }
+    else
+    {
+      value_update_text(spec->function, &group->values[i], field, spec->column->size);
+    }
+  }
+}
+
+// 不分组时整批一次聚合: 每个函数在选择向量上跑一遍紧凑循环, 最后只更新一次结果
+static void group_update_batch(AggregateQuery *query, Group *group, Batch *batch)
+{
+  uint32_t count = batch->num_selected;
+  const uint16_t *selection = batch->selection;
+  group->count += count;
+  if (count == 0)
+  {
+    return;
+  }
+  for (uint32_t i = 0; i < query->num_functions; i++)
+  {
+    AggregateSpec *spec = &query->functions[i];
+    if (spec->function == AGGREGATE_COUNT)
+    {
+      continue;
+    }
+    if (spec->column->kind == COLUMN_KIND_U64)
+    {
+      const uint64_t *values = batch_column(batch, spec->column, 0);
+      uint64_t best = values[selection[0]];
+      if (spec->function == AGGREGATE_MIN)
+      {
+        for (uint32_t j = 1; j < count; j++)
+        {
+          uint64_t value = values[selection[j]];
+          best = value < best ? value : best;
+        }
+      }
+      else
+      {
+        for (uint32_t j = 1; j < count; j++)
+        {
+          uint64_t value = values[selection[j]];
+          best = value > best ? value : best;
+        }
+      }
+      value_update_number(spec->function, &group->values[i], best);
+      continue;
+    }
+    uint32_t size = spec->column->size;
+    const char *values = batch_column(batch, spec->column, 0);
+    const char *best = values + (size_t)selection[0] * size;
+    int sign = spec->function == AGGREGATE_MIN ? 1 : -1;
+    for (uint32_t j = 1; j < count; j++)
+    {
+      const char *value = values + (size_t)selection[j] * size;
+      if (sign * strncmp(value, best, size) < 0)
+      {
+        best = value;
+      }
+    }
+    value_update_text(spec->function, &group->values[i], best, size);
+  }
+}
+
+static void aggregate_batch(AggregateQuery *query, GroupTable *groups, Batch *batch)
+{
+  if (query->group_kind == GROUP_NONE)
+  {
+    group_update_batch(query, groups->last, batch);
+    return;
+  }
+  for (uint32_t i = 0; i < batch->num_selected; i++)
+  {
+    uint32_t row = batch->selection[i];
+    const char *key;
+    uint32_t key_size = group_key(query, batch, row, &key);
+    group_update(query, group_find(groups, key, key_size), batch, row);
+  }
+}
+
+// 扫描时每行需要读取的记录前缀长度; id 由扫描直接提供, 不计入
+static uint32_t aggregate_read_size(AggregateQuery *query, Filter *filter)
+{
+  uint32_t size = 0;
+  for (uint32_t i = 0; i <= query->num_functions; i++)
+  {
+    const ColumnInfo *column = i < query->num_functions ? query->functions[i].column : query->group_column;
+    if (column && column->offset != offsetof(Row, id) && column->record_end > size)
+    {
+      size = column->record_end;
+    }
+  }
+  return filter_read_size(filter, size);
+}
+
+// qsort 的上下文只能放在静态变量里
+static const ColumnInfo *sort_column;
+
+static int group_compare(const void *a, const void *b)
+{
+  const Group *x = *(Group *const *)a;
+  const Group *y = *(Group *const *)b;
+  if (sort_column && sort_column->kind == COLUMN_KIND_U64)
+  {
+    uint64_t left, right;
+    memcpy(&left, x->key, sizeof(left));
+    memcpy(&right, y->key, sizeof(right));
+    return (left > right) - (left < right);
+  }
+  uint32_t size = x->key_size < y->key_size ? x->key_size : y->key_size;
+  int result = memcmp(x->key, y->key, size);
+  return result ? result : (x->key_size > y->key_size) - (x->key_size < y->key_size);
+}
+
+static void group_print(AggregateQuery *query, Group *group)
+{
+  const ColumnInfo *column = query->group_column;
+  if (query->group_kind != GROUP_NONE)
+  {
+    printf(query->group_kind == GROUP_DOMAIN ? "domain(%s): " : "%s: ", column->name);
+    if (column->kind == COLUMN_KIND_U64)
+    {
+      uint64_t number;
+      memcpy(&number, group->key, sizeof(number));
+      printf("%lu\t ", number);
+    }
+    else
+    {
+      printf("%.*s\t ", group->key_size, group->key);
+    }
+  }
+  for (uint32_t i = 0; i < query->num_functions; i++)
+  {
+    AggregateSpec *spec = &query->functions[i];
+    AggregateValue *value = &group->values[i];
+    const char *separator = i + 1 < query->num_functions ? "\t " : "\n";
+    if (spec->function == AGGREGATE_COUNT)
+    {
+      printf("count(*): %lu%s", group->count, separator);
+      continue;
+    }
+    printf("%s(%s): ", spec->function == AGGREGATE_MIN ? "min" : "max", spec->column->name);
+    if (!value->present)
+    {
+      printf("NULL%s", separator);
+    }
+    else if (spec->column->kind == COLUMN_KIND_U64)
+    {
+      printf("%lu%s", value->number, separator);
+    }
+    else
+    {
+      printf("%.*s%s", spec->column->size, value->text, separator);
+    }
+  }
+}
+
+// 不分组且只有 count(*)
+static bool aggregate_count_only(AggregateQuery *query)
+{
+  if (query->group_kind != GROUP_NONE)
+  {
+    return false;
+  }
+  for (uint32_t i = 0; i < query->num_functions; i++)
+  {
+    if (query->functions[i].function != AGGREGATE_COUNT)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+void aggregate_execute(AggregateQuery *query, Filter *filter, Table *table)
+{
+  GroupTable groups = {NULL, AGGREGATE_MIN_SLOTS, 0, NULL};
+  groups.slots = calloc(groups.capacity, sizeof(Group *));
+  if (query->group_kind == GROUP_NONE)
+  {
+    // 不分组时空表也输出一行
+    group_find(&groups, "", 0);
+  }
+
+  if (aggregate_count_only(query) && filter->num_predicates == 0)
+  {
+    // 全表 count(*): 直接取文件头中维护的行数, 不扫描
+    groups.last->count = pager_header(table->pager)->row_count;
+  }
+  else
+  {
+    Batch *batch = malloc(sizeof(Batch));
+    BatchScan scan;
+    batch_scan_init(&scan, table, aggregate_read_size(query, filter));
+    while (batch_scan_next(&scan, batch))
+    {
+      batch_filter(batch, filter);
+      aggregate_batch(query, &groups, batch);
+    }
+    free(batch);
+  }
+  Group **sorted = malloc(sizeof(Group *) * (groups.count ? groups.count : 1));
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < groups.capacity; i++)
+  {
+    if (groups.slots[i] != NULL)
+    {
+      sorted[count++] = groups.slots[i];
+    }
+  }
+  sort_column = query->group_kind == GROUP_COLUMN ? query->group_column : NULL;
+  qsort(sorted, count, sizeof(Group *), group_compare);
+  for (uint32_t i = 0; i < count; i++)
+  {
+    group_print(query, sorted[i]);
+    for (uint32_t j = 0; j < query->num_functions; j++)
+    {
+      free(sorted[i]->values[j].text);
+    }
+    free(sorted[i]);
+  }
+  free(sorted);
+  free(groups.slots);
+}
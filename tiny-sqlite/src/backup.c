@@ -0,0 +1,280 @@
+#define _GNU_SOURCE // copy_file_range
+#include <errno.h>
+#include <libgen.h>
+
+#include "../include/backup.h"
+#include "../include/page_cache.h"
+#include "../include/shadow.h"
+
+static bool backup_is_touched(Backup *backup, uint32_t page_num)
+{
+  return backup->touched[page_num / 8] & (1u << (page_num % 8));
+}
+
+static void backup_clear_touched(Backup *backup, uint32_t page_num)
+{
+  if (backup_is_touched(backup, page_num))
+  {
+    backup->touched[page_num / 8] &= ~(1u << (page_num % 8));
+    backup->num_touched -= 1;
+  }
+}
+
+// 位图至少覆盖 num_pages 页
+static void backup_grow_touched(Backup *backup, uint32_t num_pages)
+{
+  if (num_pages <= backup->touched_size)
+  {
+    return;
+  }
+  uint32_t size = backup->touched_size ? backup->touched_size : 1024;
+  while (size < num_pages)
+  {
+    size *= 2;
+  }
+  backup->touched = realloc(backup->touched, size / 8);
+  memset(backup->touched + backup->touched_size / 8, 0, (size - backup->touched_size) / 8);
+  backup->touched_size = size;
+}
+
+void backup_page_touched(Backup *backup, uint32_t page_num)
+{
+  // 尚未复制的页之后会按顺序复制, 无需登记
+  if (page_num < backup->next_page && !backup_is_touched(backup, page_num))
+  {
+    backup->touched[page_num / 8] |= 1u << (page_num % 8);
+    backup->num_touched += 1;
+  }
+}
+
+// 内核中拷贝文件区间, 不支持时 (如跨文件系统) 退回 pread / pwrite
+static bool backup_copy_file(int source_fd, int destination_fd, off_t offset, size_t size)
+{
+  off_t source_offset = offset;
+  off_t destination_offset = offset;
+  while (size > 0)
+  {
+    ssize_t copied = copy_file_range(source_fd, &source_offset, destination_fd, &destination_offset, size, 0);
+    if (copied > 0)
+    {
+      size -= copied;
+      continue;
+    }
+    if (copied == -1 && errno == EINTR)
+    {
+      continue;
+    }
+    if (copied == 0 || !(errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP))
+    {
+      return false;
+    }
+    break;
+  }
+
+  uint8_t page[PAGE_SIZE_MAX];
+  while (size > 0)
+  {
+    if (pread(source_fd, page, PAGE_SIZE, source_offset) != PAGE_SIZE ||
+        pwrite(destination_fd, page, PAGE_SIZE, destination_offset) != PAGE_SIZE)
+    {
+      return false;
+    }
+    source_offset += PAGE_SIZE;
+    destination_offset += PAGE_SIZE;
+    size -= PAGE_SIZE;
+  }
+  return true;
+}
+
+/*
+  复制 [start, end) 页: 缓存中的页可能比文件新, 直接写出;
+  不在缓存中的连续页在文件中一定是最新的, 整段交给 copy_file_range
+*/
+static bool backup_copy_range(Backup *backup, uint32_t start, uint32_t end)
+{
+  Pager *pager = backup->pager;
+  uint32_t file_pages = pager->file_len / PAGE_SIZE;
+  uint32_t page_num = start;
+  while (page_num < end)
+  {
+    void *cached = page_cache_peek(pager, page_num);
+    if (cached != NULL || page_num >= file_pages || pager->shadow)
+    {
+      // 影子分页模式下逻辑页不在文件的对应位置, 逐页经映射表读出
+      uint8_t buffer[PAGE_SIZE_MAX];
+      if (cached == NULL && !(pager->shadow && shadow_read_page(pager->shadow, page_num, buffer)))
+      {
+        memset(buffer, 0, PAGE_SIZE);
+      }
+      if (pwrite(backup->fd, cached ? cached : buffer, PAGE_SIZE, (off_t)page_num * PAGE_SIZE) != PAGE_SIZE)
+      {
+        return false;
+      }
+      page_num += 1;
+      continue;
+    }
+
+    uint32_t run_end = page_num + 1;
+    while (run_end < end && run_end < file_pages && page_cache_peek(pager, run_end) == NULL)
+    {
+      run_end += 1;
+    }
+    if (!backup_copy_file(pager->file_descirptor, backup->fd, (off_t)page_num * PAGE_SIZE,
+                          (size_t)(run_end - page_num) * PAGE_SIZE))
+    {
+      return false;
+    }
+    page_num = run_end;
+  }
+  backup->pages_copied += end - start;
+  return true;
+}
+
+// 补拷最多 max_pages 个登记过的页 (连续的合并复制), 返回补拷的页数
+static int64_t backup_recopy(Backup *backup, uint32_t max_pages)
+{
+  uint32_t copied = 0;
+  uint32_t scanned = 0;
+  while (backup->num_touched > 0 && copied < max_pages && scanned < backup->next_page)
+  {
+    if (backup->scan_page >= backup->next_page)
+    {
+      backup->scan_page = 0;
+    }
+    uint32_t start = backup->scan_page;
+    if (!backup_is_touched(backup, start))
+    {
+      backup->scan_page += 1;
+      scanned += 1;
+      continue;
+    }
+    uint32_t end = start;
+    while (end < backup->next_page && backup_is_touched(backup, end) && copied < max_pages)
+    {
+      backup_clear_touched(backup, end);
+      end += 1;
+      copied += 1;
+    }
+    if (!backup_copy_range(backup, start, end))
+    {
+      return -1;
+    }
+    backup->scan_page = end;
+    scanned += end - start;
+  }
+  return copied;
+}
+
+Backup *backup_start(Table *table, const char *path)
+{
+  Pager *pager = table->pager;
+  if (pager->backup != NULL)
+  {
+    ERROR("backup: another backup is in progress!");
+    return NULL;
+  }
+  size_t path_len = strlen(path);
+  char *tmp_path = malloc(path_len + sizeof("-backup"));
+  memcpy(tmp_path, path, path_len);
+  memcpy(tmp_path + path_len, "-backup", sizeof("-backup"));
+  int fd = open(tmp_path, O_RDWR | O_CREAT | O_TRUNC, S_IWUSR | S_IRUSR);
+  if (fd == -1)
+  {
+    ERROR("backup: unable to create temp file!");
+    free(tmp_path);
+    return NULL;
+  }
+
+  Backup *backup = calloc(1, sizeof(Backup));
+  backup->pager = pager;
+  backup->fd = fd;
+  backup->path = strdup(path);
+  backup->tmp_path = tmp_path;
+  backup->recopy_budget = pager->num_pages;
+  pager->backup = backup;
+  return backup;
+}
+
+// 最后一步: 补拷全部剩余页, 截断到当前页数后落盘并替换目标文件
+static bool backup_complete(Backup *backup)
+{
+  Pager *pager = backup->pager;
+  if (backup_recopy(backup, UINT32_MAX) < 0 ||
+      ftruncate(backup->fd, (off_t)pager->num_pages * PAGE_SIZE) == -1 ||
+      fsync(backup->fd) == -1 ||
+      rename(backup->tmp_path, backup->path) == -1)
+  {
+    return false;
+  }
+  close(backup->fd);
+  backup->fd = -1;
+
+  // rename 之后同步目录项, 保证替换本身落盘
+  char *path = strdup(backup->path);
+  int dir_fd = open(dirname(path), O_RDONLY);
+  if (dir_fd != -1)
+  {
+    fsync(dir_fd);
+    close(dir_fd);
+  }
+  free(path);
+  return true;
+}
+
+BackupResult backup_step(Backup *backup, uint32_t max_pages)
+{
+  Pager *pager = backup->pager;
+  if (backup->fd == -1)
+  {
+    return BACKUP_DONE;
+  }
+
+  if (backup->next_page < pager->num_pages)
+  {
+    uint32_t end = pager->num_pages - backup->next_page > max_pages ? backup->next_page + max_pages : pager->num_pages;
+    if (!backup_copy_range(backup, backup->next_page, end))
+    {
+      ERROR("backup: copy failed!");
+      return BACKUP_ERROR;
+    }
+    backup_grow_touched(backup, end);
+    backup->next_page = end;
+    return BACKUP_MORE;
+  }
+
+  if (backup->num_touched > max_pages && backup->recopy_budget >= max_pages)
+  {
+    int64_t copied = backup_recopy(backup, max_pages);
+    if (copied < 0)
+    {
+      ERROR("backup: copy failed!");
+      return BACKUP_ERROR;
+    }
+    backup->recopy_budget -= copied;
+    return BACKUP_MORE;
+  }
+
+  if (!backup_complete(backup))
+  {
+    ERROR("backup failed!");
+    return BACKUP_ERROR;
+  }
+  return BACKUP_DONE;
+}
+
+void backup_finish(Backup *backup)
+{
+  if (backup->pager->backup == backup)
+  {
+    backup->pager->backup = NULL;
+  }
+  if (backup->fd != -1)
+  {
+    close(backup->fd);
+    unlink(backup->tmp_path);
+  }
+  free(backup->touched);
+  free(backup->path);
+  free(backup->tmp_path);
+  free(backup);
+}
@@ -0,0 +1,398 @@
+#include <ctype.h>
+
+#include "../include/batch.h"
+#include "../include/cursor.h"
+#include "../include/tree_node.h"
+#include "../include/page_cache.h"
+
+// 各列在列向量结构体中的偏移, 与 row_columns 顺序相同
+#define COLUMN_U64(type, suffix, name)              offsetof(type##Vectors, name),
+#define COLUMN_TEXT(type, suffix, name, capacity)   offsetof(type##Vectors, name),
+#define COLUMN_TAIL_TEXT(type, suffix, name, capacity) offsetof(type##Vectors, name),
+static const uint32_t row_vector_offsets[] = {
+#include "../include/schema.def"
+};
+
+// 复制到定长槽位, 不足 capacity 时以 '\0' 结尾 (只补一个)
+static void copy_text(char *destination, const char *source, uint32_t size, uint32_t capacity)
+{
+  uint32_t length = strnlen(source, size < capacity ? size : capacity);
+  memcpy(destination, source, length);
+  if (length < capacity)
+  {
+    destination[length] = '\0';
+  }
+}
+
+// 解码记录前缀 [0, size) 中完整的列到第 row 行
+#define TABLE(type, suffix) \
+  static void decode_##suffix(const uint8_t *in, uint32_t size, type##Vectors *vectors, uint32_t row) \
+  {
+#define COLUMN_U64(type, suffix, name) \
+    if (RECORD_OFFSET(type, name) + sizeof(uint64_t) <= size) \
+    { \
+      memcpy(&vectors->name[row], in + RECORD_OFFSET(type, name), sizeof(uint64_t)); \
+    }
+#define COLUMN_TEXT(type, suffix, name, capacity) \
+    if (RECORD_OFFSET(type, name) + capacity <= size) \
+    { \
+      copy_text(vectors->name[row], (const char *)in + RECORD_OFFSET(type, name), capacity, capacity); \
+    }
+#define COLUMN_TAIL_TEXT(type, suffix, name, capacity) \
+    if (RECORD_OFFSET(type, name) <= size) \
+    { \
+      copy_text(vectors->name[row], (const char *)in + RECORD_OFFSET(type, name), size - RECORD_OFFSET(type, name), capacity); \
+    }
+#define TABLE_END(type, suffix) \
+  }
+#include "../include/schema.def"
+
+// 组装一整行
+#define TABLE(type, suffix) \
+  static void assemble_##suffix(type##Vectors *vectors, uint32_t row, type *destination) \
+  {
+#define COLUMN_U64(type, suffix, name) \
+    destination->name = vectors->name[row];
+#define COLUMN_TEXT(type, suffix, name, capacity) \
+    strncpy(destination->name, vectors->name[row], capacity);
+#define COLUMN_TAIL_TEXT(type, suffix, name, capacity) COLUMN_TEXT(type, suffix, name, capacity)
+#define TABLE_END(type, suffix) \
+  }
+#include "../include/schema.def"
+
+int filter_parse(const char *sql, Filter *filter)
+{
+  filter->num_predicates = 0;
+  int consumed = 0;
+  sscanf(sql, " where%n", &consumed);
+  if (consumed == 0 || !isspace((unsigned char)sql[consumed]))
+  {
+    return 0;
+  }
+
+  const char *rest = sql + consumed;
+  while (true)
+  {
+    if (filter->num_predicates == FILTER_MAX_PREDICATES)
+    {
+      return -1;
+    }
+    Predicate *predicate = &filter->predicates[filter->num_predicates];
+    char column[32];
+    char op[3];
+    consumed = 0;
+    if (sscanf(rest, " %31[a-z_] %2[=!<>] %255s%n", column, op, predicate->text, &consumed) < 3 || consumed == 0)
+    {
+      return -1;
+    }
+    predicate->column = find_column(row_columns, row_num_columns, column);
+    if (predicate->column == NULL)
+    {
+      return -1;
+    }
+    if (strcmp(op, "=") == 0)
+    {
+      predicate->op = PREDICATE_EQ;
+    }
+    else if (strcmp(op, "!=") == 0)
+    {
+      predicate->op = PREDICATE_NE;
+    }
+    else if (strcmp(op, "<") == 0)
+    {
+      predicate->op = PREDICATE_LT;
+    }
+    else if (strcmp(op, "<=") == 0)
+    {
+      predicate->op = PREDICATE_LE;
+    }
+    else if (strcmp(op, ">") == 0)
+    {
+      predicate->op = PREDICATE_GT;
+    }
+    else if (strcmp(op, ">=") == 0)
+    {
+      predicate->op = PREDICATE_GE;
+    }
+    else
+    {
+      return -1;
+    }
+    if (!predicate_set_value(predicate, predicate->text))
+    {
+      return -1;
+    }
+    filter->num_predicates += 1;
+    rest += consumed;
+
+    consumed = 0;
+    sscanf(rest, " and%n", &consumed);
+    if (consumed == 0 || !isspace((unsigned char)rest[consumed]))
+    {
+      break;
+    }
+    rest += consumed;
+  }
+  return rest - sql;
+}
+
+bool predicate_set_value(Predicate *predicate, const char *text)
+{
+  size_t length = strlen(text);
+  if (length >= sizeof(predicate->text))
+  {
+    return false;
+  }
+  if (text != predicate->text)
+  {
+    memcpy(predicate->text, text, length + 1);
+  }
+  if (predicate->column->kind == COLUMN_KIND_U64)
+  {
+    char *end;
+    predicate->number = strtoull(text, &end, 10);
+    return length > 0 && *end == '\0' && text[0] != '-';
+  }
+  return length <= predicate->column->size;
+}
+
+bool filter_match(const Filter *filter, Row *row)
+{
+  for (uint32_t i = 0; i < filter->num_predicates; i++)
+  {
+    const Predicate *predicate = &filter->predicates[i];
+    const ColumnInfo *column = predicate->column;
+    const void *value = (char *)row + column->offset;
+    int compare;
+    if (column->kind == COLUMN_KIND_U64)
+    {
+      uint64_t number = *(const uint64_t *)value;
+      compare = (number > predicate->number) - (number < predicate->number);
+    }
+    else
+    {
+      compare = strncmp(value, predicate->text, column->size);
+    }
+    bool matched = false;
+    switch (predicate->op)
+    {
+    case PREDICATE_EQ:
+      matched = compare == 0;
+      break;
+    case PREDICATE_NE:
+      matched = compare != 0;
+      break;
+    case PREDICATE_LT:
+      matched = compare < 0;
+      break;
+    case PREDICATE_LE:
+      matched = compare <= 0;
+      break;
+    case PREDICATE_GT:
+      matched = compare > 0;
+      break;
+    case PREDICATE_GE:
+      matched = compare >= 0;
+      break;
+    }
+    if (!matched)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+uint32_t filter_read_size(const Filter *filter, uint32_t read_size)
+{
+  for (uint32_t i = 0; i < filter->num_predicates; i++)
+  {
+    const ColumnInfo *column = filter->predicates[i].column;
+    if (column->offset != offsetof(Row, id) && column->record_end > read_size)
+    {
+      read_size = column->record_end;
+    }
+  }
+  return read_size;
+}
+
+void batch_scan_init(BatchScan *scan, Table *table, uint32_t read_size)
+{
+  scan->table = table;
+  scan->read_size = read_size;
+  if (table->key_type == KEY_TYPE_TEXT)
+  {
+    // 文本主键表的 id 在记录中
+    if (scan->read_size < ID_OFFSET + sizeof(uint64_t))
+    {
+      scan->read_size = ID_OFFSET + sizeof(uint64_t);
+    }
+    text_tree_start(table->pager, table->root_page_num, &scan->text_cursor);
+    scan->done = scan->text_cursor.end_of_tree;
+    return;
+  }
+  Cursor *cursor = table_start(table);
+  scan->page_num = cursor->page_num;
+  scan->cell_num = 0;
+  scan->done = false;
+  free(cursor);
+}
+
+static void batch_scan_text(BatchScan *scan, Batch *batch)
+{
+  TextCursor *cursor = &scan->text_cursor;
+  while (batch->count < BATCH_SIZE && !cursor->end_of_tree)
+  {
+    uint32_t value_size;
+    void *value = text_cursor_value(cursor, &value_size);
+    decode_row(value, value_size < scan->read_size ? value_size : scan->read_size, &batch->columns, batch->count);
+    batch->count += 1;
+    uint32_t page_num = cursor->page_num;
+    text_cursor_advance(cursor);
+    if (cursor->page_num != page_num)
+    {
+      page_cache_unpin_all(); // 整片叶子已读完
+    }
+  }
+  scan->done = cursor->end_of_tree;
+}
+
+static void batch_scan_leaves(BatchScan *scan, Batch *batch)
+{
+  Pager *pager = scan->table->pager;
+  uint8_t payload[ROW_SIZE];
+  while (batch->count < BATCH_SIZE && !scan->done)
+  {
+    void *node = get_page(pager, scan->page_num);
+    uint32_t num_cells = *leaf_node_num_cells(node);
+    uint32_t end = num_cells;
+    if (end - scan->cell_num > BATCH_SIZE - batch->count)
+    {
+      end = scan->cell_num + BATCH_SIZE - batch->count;
+    }
+    uint64_t *ids = batch->columns.id + batch->count;
+    for (uint32_t i = scan->cell_num; i < end; i++)
+    {
+      *ids++ = *leaf_node_key(node, i);
+    }
+    if (scan->read_size > 0)
+    {
+      for (uint32_t i = scan->cell_num; i < end; i++)
+      {
+        uint32_t size = leaf_node_read_payload(pager, node, i, payload, scan->read_size);
+        decode_row(payload, size, &batch->columns, batch->count + i - scan->cell_num);
+      }
+    }
+    batch->count += end - scan->cell_num;
+    scan->cell_num = end;
+
+    if (end == num_cells)
+    {
+      uint32_t next_page_num = *leaf_node_next_leaf(node);
+      page_cache_unpin_all(); // 整片叶子已读完, 列值都已复制出来
+      scan->page_num = next_page_num;
+      scan->cell_num = 0;
+      scan->done = (next_page_num == 0);
+    }
+  }
+}
+
+bool batch_scan_next(BatchScan *scan, Batch *batch)
+{
+  batch->count = 0;
+  if (scan->table->key_type == KEY_TYPE_TEXT)
+  {
+    batch_scan_text(scan, batch);
+  }
+  else
+  {
+    batch_scan_leaves(scan, batch);
+  }
+  for (uint32_t i = 0; i < batch->count; i++)
+  {
+    batch->selection[i] = i;
+  }
+  batch->num_selected = batch->count;
+  return batch->count > 0;
+}
+
+// 选择向量的紧凑循环: 每行都写回, 满足条件时才前进, 循环体内没有分支
+#define FILTER_LOOP(condition) \
+  for (uint32_t i = 0; i < count; i++) \
+  { \
+    uint16_t row = selection[i]; \
+    selection[selected] = row; \
+    selected += (condition); \
+  } \
+  break;
+
+static uint32_t filter_u64(const uint64_t *values, PredicateOp op, uint64_t value, uint16_t *selection, uint32_t count)
+{
+  uint32_t selected = 0;
+  switch (op)
+  {
+  case PREDICATE_EQ:
+    FILTER_LOOP(values[row] == value)
+  case PREDICATE_NE:
+    FILTER_LOOP(values[row] != value)
+  case PREDICATE_LT:
+    FILTER_LOOP(values[row] < value)
+  case PREDICATE_LE:
+    FILTER_LOOP(values[row] <= value)
+  case PREDICATE_GT:
+    FILTER_LOOP(values[row] > value)
+  case PREDICATE_GE:
+    FILTER_LOOP(values[row] >= value)
+  }
+  return selected;
+}
+
+static uint32_t filter_text(const char *values, uint32_t width, PredicateOp op, const char *value,
+                            uint16_t *selection, uint32_t count)
+{
+  uint32_t selected = 0;
+  switch (op)
+  {
+  case PREDICATE_EQ:
+    FILTER_LOOP(strncmp(values + row * width, value, width) == 0)
+  case PREDICATE_NE:
+    FILTER_LOOP(strncmp(values + row * width, value, width) != 0)
+  case PREDICATE_LT:
+    FILTER_LOOP(strncmp(values + row * width, value, width) < 0)
+  case PREDICATE_LE:
+    FILTER_LOOP(strncmp(values + row * width, value, width) <= 0)
+  case PREDICATE_GT:
+    FILTER_LOOP(strncmp(values + row * width, value, width) > 0)
+  case PREDICATE_GE:
+    FILTER_LOOP(strncmp(values + row * width, value, width) >= 0)
+  }
+  return selected;
+}
+
+void batch_filter(Batch *batch, const Filter *filter)
+{
+  for (uint32_t i = 0; i < filter->num_predicates && batch->num_selected > 0; i++)
+  {
+    const Predicate *predicate = &filter->predicates[i];
+    const ColumnInfo *column = predicate->column;
+    void *values = batch_column(batch, column, 0);
+    if (column->kind == COLUMN_KIND_U64)
+    {
+      batch->num_selected = filter_u64(values, predicate->op, predicate->number, batch->selection, batch->num_selected);
+    }
+    else
+    {
+      batch->num_selected = filter_text(values, column->size, predicate->op, predicate->text, batch->selection, batch->num_selected);
+    }
+  }
+}
+
+void *batch_column(Batch *batch, const ColumnInfo *column, uint32_t row)
+{
+  return (char *)&batch->columns + row_vector_offsets[column - row_columns] + (size_t)row * column->size;
+}
+
+void batch_row(Batch *batch, uint32_t row, Row *destination)
+{
+  assemble_row(&batch->columns, row, destination);
+}
@@ -0,0 +1,70 @@
+#include "../include/bloom.h"
+
+// 块内每个字使用的奇数乘子, 取乘积高 5 位作为位下标
+static const uint32_t bloom_salts[BLOOM_BLOCK_WORDS] = {
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+    0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U,
+};
+
+static uint64_t bloom_hash(uint64_t key)
+{
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdULL;
+  key ^= key >> 33;
+  key *= 0xc4ceb9fe1a85ec53ULL;
+  key ^= key >> 33;
+  return key;
+}
+
+BloomFilter *bloom_new(uint32_t capacity)
+{
+  uint64_t bits = (uint64_t)capacity * BLOOM_BITS_PER_KEY;
+  uint32_t num_blocks = 1;
+  while ((uint64_t)num_blocks * BLOOM_BLOCK_WORDS * 32 < bits)
+  {
+    num_blocks *= 2;
+  }
+
+  BloomFilter *filter = malloc(sizeof(BloomFilter));
+  filter->blocks = calloc(num_blocks, sizeof(*filter->blocks));
+  filter->num_blocks = num_blocks;
+  filter->capacity = (uint64_t)num_blocks * BLOOM_BLOCK_WORDS * 32 / BLOOM_BITS_PER_KEY;
+  filter->num_keys = 0;
+  filter->num_removed = 0;
+  return filter;
+}
+
+void bloom_free(BloomFilter *filter)
+{
+  if (filter)
+  {
+    free(filter->blocks);
+    free(filter);
+  }
+}
+
+// 高 32 位选块, 低 32 位在块内选位
+void bloom_add(BloomFilter *filter, uint64_t key)
+{
+  uint64_t hash = bloom_hash(key);
+  uint32_t *block = filter->blocks[(hash >> 32) & (filter->num_blocks - 1)];
+  for (uint32_t i = 0; i < BLOOM_BLOCK_WORDS; i++)
+  {
+    block[i] |= 1U << (((uint32_t)hash * bloom_salts[i]) >> 27);
+  }
+  filter->num_keys += 1;
+}
+
+bool bloom_may_contain(BloomFilter *filter, uint64_t key)
+{
+  uint64_t hash = bloom_hash(key);
+  uint32_t *block = filter->blocks[(hash >> 32) & (filter->num_blocks - 1)];
+  for (uint32_t i = 0; i < BLOOM_BLOCK_WORDS; i++)
+  {
+    if (!(block[i] & (1U << (((uint32_t)hash * bloom_salts[i]) >> 27))))
+    {
+      return false;
+    }
+  }
+  return true;
+}
@@ -1,5 +1,6 @@
 #include "../include/cursor.h"
 #include "../include/tree_node.h"
+#include "../include/hash_index.h"
 
 Cursor *table_start(Table *table)
 {
@@ -23,7 +24,7 @@ Cursor *table_end(Table *table)
   return cursor;
 }
 
-Cursor *table_find(Table *table, uint32_t key_to_insert)
+Cursor *table_find(Table *table, uint64_t key_to_insert)
 {
   uint32_t root_page_num = table->root_page_num;
   void *root_node = get_page(table->pager, root_page_num);
@@ -37,6 +38,63 @@ Cursor *table_find(Table *table, uint32_t key_to_insert)
   }
 }
 
+Cursor *table_append_cursor(Table *table, uint64_t key)
+{
+  // 优先使用缓存的最右叶子, 未知时沿最右路径下降一次并记录
+  uint32_t page_num = table->pager->rightmost_leaf;
+  void *node;
+  if (page_num == 0)
+  {
+    page_num = table->root_page_num;
+    node = get_page(table->pager, page_num);
+    while (get_node_type(node) == NODE_INTERNAL)
+    {
+      page_num = *internal_node_right_child(node);
+      node = get_page(table->pager, page_num);
+    }
+    table->pager->rightmost_leaf = page_num;
+  }
+  node = get_page(table->pager, page_num);
+
+  uint32_t num_cells = *leaf_node_num_cells(node);
+  if (num_cells > 0 && key <= *leaf_node_key(node, num_cells - 1))
+  {
+    return NULL;
+  }
+  Cursor *cursor = (Cursor *)malloc(sizeof(Cursor));
+  cursor->table = table;
+  cursor->page_num = page_num;
+  cursor->cell_num = num_cells;
+  cursor->end_of_table = true;
+  return cursor;
+}
+
+Cursor *table_lookup(Table *table, uint64_t key)
+{
+  Cursor *cursor;
+  if (hash_index_enabled(table->pager))
+  {
+    uint32_t page_num = hash_index_get(table->pager, key);
+    if (page_num == 0)
+    {
+      return NULL;
+    }
+    cursor = leaf_node_find(table, page_num, key);
+  }
+  else
+  {
+    cursor = table_find(table, key);
+  }
+
+  void *node = get_page(table->pager, cursor->page_num);
+  if (cursor->cell_num >= *leaf_node_num_cells(node) || *leaf_node_key(node, cursor->cell_num) != key)
+  {
+    free(cursor);
+    return NULL;
+  }
+  return cursor;
+}
+
 void cursor_advance(Cursor *cursor)
 {
   uint32_t page_num = cursor->page_num;
@@ -59,4 +117,12 @@ void *cursor_value(Cursor *cursor)
 {
   void *page = get_page(cursor->table->pager, cursor->page_num);
   return leaf_node_value(page, cursor->cell_num);
+}
+
+void cursor_row(Cursor *cursor, Row *row, uint32_t size)
+{
+  uint8_t payload[ROW_SIZE];
+  void *page = get_page(cursor->table->pager, cursor->page_num);
+  size = leaf_node_read_payload(cursor->table->pager, page, cursor->cell_num, payload, size);
+  deserialize_row(payload, size, row);
 }
\ No newline at end of file
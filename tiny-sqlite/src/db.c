@@ -9,6 +9,20 @@
 #include "../include/config.h"
 #include "../include/cursor.h"
 #include "../include/tree_node.h"
+#include "../include/stats.h"
+#include "../include/vacuum.h"
+#include "../include/text_tree.h"
+#include "../include/page_cache.h"
+#include "../include/hash_index.h"
+#include "../include/statement.h"
+#include "../include/server.h"
+#include "../include/backup.h"
+#include "../include/sorter.h"
+#include "../include/result_cache.h"
+#include "../include/secondary_index.h"
+
+// .begin 之后不再逐条提交, 直到 .commit (影子分页模式, 见 shadow.h)
+static bool explicit_transaction = false;
 
 typedef struct
 {
@@ -23,34 +37,6 @@ typedef enum
   META_COMMAND_UNRECOGNIZED,
 } MetaCommandResult;
 
-typedef enum
-{
-  PREPARE_SUCCESS,
-  PREPARE_SYNTAX_ERROR,
-  PREPARE_STRING_TOO_LONG,
-  PREPARE_NEGATIVE_ID,
-  PREPARE_UNRECOGNIZED_STATEMENT,
-} PrepareResult;
-
-typedef enum
-{
-  STATEMENT_INSERT,
-  STATEMENT_SELECT,
-} StatementType;
-
-typedef struct
-{
-  StatementType type;
-  Row row_to_insert;
-} Statement;
-
-typedef enum
-{
-  EXECUTE_DUPLICATE_KEY,
-  EXECUTE_TABLE_FULL,
-  EXECUTE_SUCCESS,
-} ExecuteResult;
-
 // 创建缓冲区
 InputBuffer *new_input_buffer();
 
@@ -60,18 +46,6 @@ void read_input(InputBuffer *input_buffer);
 // 解析以 '.' 开始的元命令
 MetaCommandResult do_meta_command(InputBuffer *input_buffer, Table *table);
 
-// 解析insert、select 等命令
-PrepareResult prepare_statement(InputBuffer *input_buffer, Statement *statement);
-
-// 根据 statement-> type 执行相应的sql语句
-ExecuteResult execute_statement(Statement *statement, Table *table);
-
-// 执行插入语句
-ExecuteResult execute_insert(Statement *statement, Table *table);
-
-// 执行查询语句
-ExecuteResult execute_select(Statement *statement, Table *table);
-
 // 释放输入缓冲区
 void close_input_buffer(InputBuffer *input_buffer);
 
@@ -95,85 +69,173 @@ MetaCommandResult do_meta_command(InputBuffer *input_buffer, Table *table)
   else if (strcmp(input_buffer->buffer, ".btree") == 0)
   {
     printf("tree:\n");
-    print_tree(table->pager, 0, 0);
+    if (table->key_type == KEY_TYPE_TEXT)
+    {
+      print_text_tree(table->pager, table->root_page_num, 0);
+    }
+    else
+    {
+      print_tree(table->pager, table->root_page_num, 0);
+    }
     return META_COMMAND_SUCCESS;
   }
-  else
+  else if (strcmp(input_buffer->buffer, ".vacuum") == 0)
   {
-    return META_COMMAND_UNRECOGNIZED;
+    if (db_vacuum(table))
+    {
+      printf("vacuumed!\n");
+    }
+    return META_COMMAND_SUCCESS;
   }
-}
-
-PrepareResult prepare_statement(InputBuffer *input_buffer, Statement *statement)
-{
-  if (strncmp(input_buffer->buffer, "insert", 6) == 0)
+  else if (strncmp(input_buffer->buffer, ".backup ", 8) == 0)
   {
-    statement->type = STATEMENT_INSERT;
-    int args_assinged = sscanf(input_buffer->buffer, "insert %d %s %s",
-                               &statement->row_to_insert.id,
-                               statement->row_to_insert.username,
-                               statement->row_to_insert.email);
-    if (args_assinged < 3)
+    Backup *backup = backup_start(table, input_buffer->buffer + 8);
+    if (backup)
     {
-      return PREPARE_SYNTAX_ERROR; // 语法错误
+      BackupResult result;
+      while ((result = backup_step(backup, BACKUP_STEP_PAGES)) == BACKUP_MORE)
+      {
+      }
+      if (result == BACKUP_DONE)
+      {
+        printf("backup done: %lu pages copied\n", backup->pages_copied);
+      }
+      backup_finish(backup);
     }
-    return PREPARE_SUCCESS;
+    return META_COMMAND_SUCCESS;
   }
-  if (strcmp(input_buffer->buffer, "select") == 0)
+  else if (strcmp(input_buffer->buffer, ".begin") == 0)
   {
-    statement->type = STATEMENT_SELECT;
-    return PREPARE_SUCCESS;
+    explicit_transaction = true;
+    return META_COMMAND_SUCCESS;
   }
-  return PREPARE_UNRECOGNIZED_STATEMENT;
-}
-
-ExecuteResult execute_statement(Statement *statement, Table *table)
-{
-  switch (statement->type)
+  else if (strcmp(input_buffer->buffer, ".commit") == 0)
   {
-  case STATEMENT_INSERT:
-    return execute_insert(statement, table);
-  case STATEMENT_SELECT:
-    return execute_select(statement, table);
+    explicit_transaction = false;
+    pager_commit(table->pager);
+    return META_COMMAND_SUCCESS;
   }
-}
-
-ExecuteResult execute_insert(Statement *statement, Table *table)
-{
-  Row *row_to_insert = &(statement->row_to_insert);
-  uint32_t key_to_insert = row_to_insert->id;
-  Cursor *cursor = table_find(table, key_to_insert); // 这里的cursor可能指向首个大于 key_to_insert 的 cell
-
-  void* node = get_page(table->pager, cursor->page_num);
-  uint32_t num_cells = *leaf_node_num_cells(node);
-
-  if (cursor->cell_num < num_cells)
+  else if (strcmp(input_buffer->buffer, ".stats") == 0)
+  {
+    print_stats(table);
+    return META_COMMAND_SUCCESS;
+  }
+  else if (strcmp(input_buffer->buffer, ".stats reset") == 0)
+  {
+    stats_reset();
+    return META_COMMAND_SUCCESS;
+  }
+  else if (strcmp(input_buffer->buffer, ".index hash") == 0)
   {
-    // 插入的 key 在已有 cell 内部，查看是否与已有的key重复
-    uint32_t target_key = *leaf_node_key(node, cursor->cell_num);
-    if (target_key == key_to_insert)
+    if (table->key_type == KEY_TYPE_TEXT)
     {
-      return EXECUTE_DUPLICATE_KEY;
+      ERROR("hash index requires an integer primary key!");
     }
+    else if (!hash_index_enabled(table->pager))
+    {
+      hash_index_create(table);
+    }
+    return META_COMMAND_SUCCESS;
   }
-
-  leaf_node_insert(cursor, row_to_insert->id, row_to_insert);
-  free(cursor); // 释放游标
-  return EXECUTE_SUCCESS;
-}
-
-ExecuteResult execute_select(Statement *statement, Table *table)
-{
-  Cursor *cursor = table_start(table);
-  Row row;
-  while (!(cursor->end_of_table))
+  else if (strcmp(input_buffer->buffer, ".index none") == 0)
+  {
+    if (hash_index_enabled(table->pager))
+    {
+      hash_index_drop(table->pager);
+    }
+    return META_COMMAND_SUCCESS;
+  }
+  else if (strncmp(input_buffer->buffer, ".index ", 7) == 0)
+  {
+    // .index <列> [include <列>]: 二级索引; .index <列> none: 删除
+    char name[32], option[8], include_name[32];
+    int fields = sscanf(input_buffer->buffer + 7, "%31s %7s %31s", name, option, include_name);
+    const ColumnInfo *column = find_column(row_columns, row_num_columns, name);
+    if (column == NULL || (fields == 2 && strcmp(option, "none") != 0) ||
+        (fields == 3 && strcmp(option, "include") != 0))
+    {
+      return META_COMMAND_UNRECOGNIZED;
+    }
+    if (fields == 2)
+    {
+      if (secondary_index_column(table->pager) == column)
+      {
+        secondary_index_drop(table->pager);
+      }
+      return META_COMMAND_SUCCESS;
+    }
+    uint32_t include = 0;
+    if (fields == 3)
+    {
+      const ColumnInfo *include_column = find_column(row_columns, row_num_columns, include_name);
+      if (include_column == NULL)
+      {
+        return META_COMMAND_UNRECOGNIZED;
+      }
+      include = 1u << (include_column - row_columns);
+    }
+    secondary_index_create(table, column, include);
+    return META_COMMAND_SUCCESS;
+  }
+  else if (strncmp(input_buffer->buffer, ".cache ", 7) == 0)
   {
-    deserialize_row(cursor_value(cursor), &row);
-    print_row(&row);
-    cursor_advance(cursor);
+    // 全局页缓存预算, 单位 KB
+    size_t budget_kb = strtoull(input_buffer->buffer + 7, NULL, 10);
+    if (budget_kb == 0)
+    {
+      return META_COMMAND_UNRECOGNIZED;
+    }
+    page_cache_set_budget(budget_kb * 1024);
+    return META_COMMAND_SUCCESS;
+  }
+  else if (strncmp(input_buffer->buffer, ".sortmem ", 9) == 0)
+  {
+    // order by 排序内存预算, 单位 KB
+    size_t budget_kb = strtoull(input_buffer->buffer + 9, NULL, 10);
+    if (budget_kb == 0)
+    {
+      return META_COMMAND_UNRECOGNIZED;
+    }
+    sorter_set_budget(budget_kb * 1024);
+    return META_COMMAND_SUCCESS;
+  }
+  else if (strncmp(input_buffer->buffer, ".resultcache ", 13) == 0)
+  {
+    // 查询结果缓存预算, 单位 KB, 0 表示关闭
+    char *end;
+    size_t budget_kb = strtoull(input_buffer->buffer + 13, &end, 10);
+    if (end == input_buffer->buffer + 13 || *end != '\0')
+    {
+      return META_COMMAND_UNRECOGNIZED;
+    }
+    result_cache_set_budget(budget_kb * 1024);
+    return META_COMMAND_SUCCESS;
+  }
+  else if (strncmp(input_buffer->buffer, ".log ", 5) == 0)
+  {
+    const char *level = input_buffer->buffer + 5;
+    if (strcmp(level, "error") == 0)
+    {
+      db_log_level = LOG_LEVEL_ERROR;
+    }
+    else if (strcmp(level, "info") == 0)
+    {
+      db_log_level = LOG_LEVEL_INFO;
+    }
+    else if (strcmp(level, "debug") == 0)
+    {
+      db_log_level = LOG_LEVEL_DEBUG;
+    }
+    else
+    {
+      return META_COMMAND_UNRECOGNIZED;
+    }
+    return META_COMMAND_SUCCESS;
+  }
+  else
+  {
+    return META_COMMAND_UNRECOGNIZED;
   }
-  free(cursor);
-  return EXECUTE_SUCCESS;
 }
 
 void print_prompt() { printf("db > "); }
@@ -209,13 +271,70 @@ int main(int argc, char *argv[])
     exit(EXIT_FAILURE);
   }
   char *file_name = argv[1];
-  Table *table = db_open(file_name);
+
+  // --key=username: 新建数据库时以 username 为主键
+  // --serve=<socket>: 以服务端模式运行, 见 server.h
+  // --commit=shadow: 新建数据库使用影子分页提交, 见 shadow.h
+  // --page-size=<字节>: 新建数据库的页大小, 已有数据库以文件头为准
+  // --huge-pages: 页缓存 arena 使用大页 (MAP_HUGETLB, 不可用时退回透明大页)
+  // --result-cache=<KB>: 查询结果缓存预算, 见 result_cache.h
+  KeyType key_type = KEY_TYPE_INTEGER;
+  const char *socket_path = NULL;
+  for (int i = 2; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--key=username") == 0)
+    {
+      key_type = KEY_TYPE_TEXT;
+    }
+    else if (strncmp(argv[i], "--serve=", 8) == 0)
+    {
+      socket_path = argv[i] + 8;
+    }
+    else if (strcmp(argv[i], "--commit=shadow") == 0)
+    {
+      pager_set_commit_mode(COMMIT_SHADOW);
+    }
+    else if (strncmp(argv[i], "--page-size=", 12) == 0)
+    {
+      if (!pager_set_page_size(atoi(argv[i] + 12)))
+      {
+        printf("error: page size must be a power of two between %d and %d!\n", PAGE_SIZE_MIN, PAGE_SIZE_MAX);
+        exit(EXIT_FAILURE);
+      }
+    }
+    else if (strcmp(argv[i], "--huge-pages") == 0)
+    {
+      page_cache_set_huge_pages(true);
+    }
+    else if (strncmp(argv[i], "--result-cache=", 15) == 0)
+    {
+      result_cache_set_budget(strtoull(argv[i] + 15, NULL, 10) * 1024);
+    }
+  }
+  Table *table = db_open_keyed(file_name, key_type);
+  if (table == NULL)
+  {
+    exit(EXIT_FAILURE);
+  }
+
+  if (socket_path != NULL)
+  {
+    int status = server_run(table, socket_path) ? EXIT_SUCCESS : EXIT_FAILURE;
+    db_close(table);
+    return status;
+  }
 
   InputBuffer *input_buffer = new_input_buffer();
   while (true)
   {
+    // 自动提交: 上一条命令的修改在显示提示符之前落盘
+    if (!explicit_transaction)
+    {
+      pager_commit(table->pager);
+    }
     print_prompt();
     read_input(input_buffer);
+    page_cache_unpin_all();
 
     if (input_buffer->buffer[0] == '.')
     {
@@ -231,7 +350,7 @@ int main(int argc, char *argv[])
     }
 
     Statement statement;
-    switch (prepare_statement(input_buffer, &statement))
+    switch (prepare_statement(input_buffer->buffer, &statement))
     {
     case PREPARE_SUCCESS: // 结束 switch，继续 execute_statement
       break;
@@ -244,7 +363,11 @@ int main(int argc, char *argv[])
       continue;
     }
 
-    switch (execute_statement(&statement, table))
+    uint64_t start_us = stats_now_us();
+    ExecuteResult result = execute_statement(&statement, table);
+    stats_record_latency(statement_stats_type(statement.type), stats_now_us() - start_us);
+
+    switch (result)
     {
     case EXECUTE_SUCCESS:
       printf("executed!\n");
@@ -255,6 +378,9 @@ int main(int argc, char *argv[])
     case EXECUTE_DUPLICATE_KEY:
       printf("error: duplicate key!\n");
       break;
+    case EXECUTE_KEY_NOT_FOUND:
+      printf("error: key not found!\n");
+      break;
     }
   }
 }
\ No newline at end of file
@@ -0,0 +1,279 @@
+#include "../include/hash_index.h"
+#include "../include/tree_node.h"
+#include "../include/cursor.h"
+#include "../include/page_cache.h"
+
+static uint32_t *hash_dir_depth(void *dir)
+{
+  return dir;
+}
+
+static uint32_t *hash_dir_bucket(void *dir, uint32_t index)
+{
+  return dir + HASH_DIR_DEPTH_SIZE + index * HASH_DIR_ENTRY_SIZE;
+}
+
+static uint32_t *hash_bucket_depth(void *bucket)
+{
+  return bucket + HASH_BUCKET_DEPTH_OFFSET;
+}
+
+static uint32_t *hash_bucket_count(void *bucket)
+{
+  return bucket + HASH_BUCKET_COUNT_OFFSET;
+}
+
+static uint32_t *hash_bucket_next(void *bucket)
+{
+  return bucket + HASH_BUCKET_NEXT_OFFSET;
+}
+
+static uint64_t *hash_entry_key(void *bucket, uint32_t entry_num)
+{
+  return bucket + HASH_BUCKET_HEADER_SIZE + entry_num * HASH_ENTRY_SIZE;
+}
+
+static uint32_t *hash_entry_page(void *bucket, uint32_t entry_num)
+{
+  return (void *)hash_entry_key(bucket, entry_num) + HASH_ENTRY_KEY_SIZE;
+}
+
+// splitmix64 的混合函数, 连续 id 也能均匀分散到各个桶
+static uint64_t hash_key(uint64_t key)
+{
+  key ^= key >> 30;
+  key *= 0xbf58476d1ce4e5b9ULL;
+  key ^= key >> 27;
+  key *= 0x94d049bb133111ebULL;
+  key ^= key >> 31;
+  return key;
+}
+
+static void *hash_new_bucket(Pager *pager, uint32_t *page_num, uint32_t depth)
+{
+  *page_num = get_unused_page_num(pager);
+  void *bucket = get_page_for_write(pager, *page_num);
+  memset(bucket, 0, PAGE_SIZE);
+  *hash_bucket_depth(bucket) = depth;
+  return bucket;
+}
+
+static uint32_t hash_dir_index(void *dir, uint64_t key)
+{
+  return hash_key(key) & ((1u << *hash_dir_depth(dir)) - 1);
+}
+
+bool hash_index_enabled(Pager *pager)
+{
+  return pager_header(pager)->hash_index_page != 0;
+}
+
+uint32_t hash_index_get(Pager *pager, uint64_t key)
+{
+  void *dir = get_page(pager, pager_header(pager)->hash_index_page);
+  uint32_t bucket_page_num = *hash_dir_bucket(dir, hash_dir_index(dir, key));
+  while (bucket_page_num != 0)
+  {
+    void *bucket = get_page(pager, bucket_page_num);
+    for (uint32_t i = 0; i < *hash_bucket_count(bucket); i++)
+    {
+      if (*hash_entry_key(bucket, i) == key)
+      {
+        return *hash_entry_page(bucket, i);
+      }
+    }
+    bucket_page_num = *hash_bucket_next(bucket);
+  }
+  return 0;
+}
+
+/*
+  分裂桶: 局部深度加一, 按 hash 的第 (新局部深度 - 1) 位把项分到新旧两个桶,
+  局部深度等于全局深度时先将目录翻倍
+*/
+static void hash_bucket_split(Pager *pager, void *dir, uint32_t bucket_page_num)
+{
+  void *bucket = get_page_for_write(pager, bucket_page_num);
+  pager_mark_dirty(pager, pager_header(pager)->hash_index_page);
+  uint32_t depth = *hash_bucket_depth(bucket);
+  if (depth == *hash_dir_depth(dir))
+  {
+    uint32_t size = 1u << depth;
+    for (uint32_t i = 0; i < size; i++)
+    {
+      *hash_dir_bucket(dir, size + i) = *hash_dir_bucket(dir, i);
+    }
+    *hash_dir_depth(dir) += 1;
+  }
+
+  uint32_t new_page_num;
+  void *new_bucket = hash_new_bucket(pager, &new_page_num, depth + 1);
+  *hash_bucket_depth(bucket) = depth + 1;
+
+  uint64_t bit = 1ULL << depth;
+  uint32_t count = *hash_bucket_count(bucket);
+  uint32_t kept = 0;
+  for (uint32_t i = 0; i < count; i++)
+  {
+    uint64_t key = *hash_entry_key(bucket, i);
+    uint32_t page_num = *hash_entry_page(bucket, i);
+    void *destination = (hash_key(key) & bit) ? new_bucket : bucket;
+    uint32_t index = (destination == bucket) ? kept++ : (*hash_bucket_count(new_bucket))++;
+    *hash_entry_key(destination, index) = key;
+    *hash_entry_page(destination, index) = page_num;
+  }
+  *hash_bucket_count(bucket) = kept;
+
+  // 原先指向该桶、且对应位为 1 的目录项改为指向新桶
+  uint32_t dir_size = 1u << *hash_dir_depth(dir);
+  for (uint32_t i = 0; i < dir_size; i++)
+  {
+    if (*hash_dir_bucket(dir, i) == bucket_page_num && (i & bit))
+    {
+      *hash_dir_bucket(dir, i) = new_page_num;
+    }
+  }
+}
+
+void hash_index_put(Pager *pager, uint64_t key, uint32_t page_num)
+{
+  void *dir = get_page(pager, pager_header(pager)->hash_index_page);
+  while (true)
+  {
+    uint32_t bucket_page_num = *hash_dir_bucket(dir, hash_dir_index(dir, key));
+    void *bucket = get_page(pager, bucket_page_num);
+
+    // 已存在则更新, 顺便记下链表中首个有空位的桶
+    void *free_bucket = NULL;
+    uint32_t free_bucket_page_num = 0;
+    for (uint32_t cur_page_num = bucket_page_num; cur_page_num != 0;)
+    {
+      void *cur = get_page(pager, cur_page_num);
+      for (uint32_t i = 0; i < *hash_bucket_count(cur); i++)
+      {
+        if (*hash_entry_key(cur, i) == key)
+        {
+          pager_mark_dirty(pager, cur_page_num);
+          *hash_entry_page(cur, i) = page_num;
+          return;
+        }
+      }
+      if (free_bucket == NULL && *hash_bucket_count(cur) < HASH_BUCKET_MAX_ENTRIES)
+      {
+        free_bucket = cur;
+        free_bucket_page_num = cur_page_num;
+      }
+      cur_page_num = *hash_bucket_next(cur);
+    }
+
+    if (free_bucket == NULL)
+    {
+      if (*hash_bucket_depth(bucket) < HASH_DIR_MAX_DEPTH)
+      {
+        hash_bucket_split(pager, dir, bucket_page_num);
+        continue;
+      }
+      // 目录已达最大深度: 在首个桶之后挂一个溢出桶
+      free_bucket = hash_new_bucket(pager, &free_bucket_page_num, *hash_bucket_depth(bucket));
+      pager_mark_dirty(pager, bucket_page_num);
+      *hash_bucket_next(free_bucket) = *hash_bucket_next(bucket);
+      *hash_bucket_next(bucket) = free_bucket_page_num;
+    }
+
+    pager_mark_dirty(pager, free_bucket_page_num);
+    uint32_t index = (*hash_bucket_count(free_bucket))++;
+    *hash_entry_key(free_bucket, index) = key;
+    *hash_entry_page(free_bucket, index) = page_num;
+    return;
+  }
+}
+
+void hash_index_put_leaf(Pager *pager, uint32_t page_num)
+{
+  void *node = get_page(pager, page_num);
+  uint32_t num_cells = *leaf_node_num_cells(node);
+  for (uint32_t i = 0; i < num_cells; i++)
+  {
+    hash_index_put(pager, *leaf_node_key(node, i), page_num);
+  }
+}
+
+void hash_index_delete(Pager *pager, uint64_t key)
+{
+  void *dir = get_page(pager, pager_header(pager)->hash_index_page);
+  uint32_t bucket_page_num = *hash_dir_bucket(dir, hash_dir_index(dir, key));
+  while (bucket_page_num != 0)
+  {
+    void *bucket = get_page(pager, bucket_page_num);
+    uint32_t count = *hash_bucket_count(bucket);
+    for (uint32_t i = 0; i < count; i++)
+    {
+      if (*hash_entry_key(bucket, i) == key)
+      {
+        // 用最后一项填补空位
+        pager_mark_dirty(pager, bucket_page_num);
+        *hash_entry_key(bucket, i) = *hash_entry_key(bucket, count - 1);
+        *hash_entry_page(bucket, i) = *hash_entry_page(bucket, count - 1);
+        *hash_bucket_count(bucket) = count - 1;
+        return;
+      }
+    }
+    bucket_page_num = *hash_bucket_next(bucket);
+  }
+}
+
+void hash_index_create(Table *table)
+{
+  Pager *pager = table->pager;
+  uint32_t dir_page_num = get_unused_page_num(pager);
+  void *dir = get_page_for_write(pager, dir_page_num);
+  memset(dir, 0, PAGE_SIZE);
+  uint32_t bucket_page_num;
+  hash_new_bucket(pager, &bucket_page_num, 0);
+  *hash_dir_bucket(dir, 0) = bucket_page_num;
+  pager_header_for_write(pager)->hash_index_page = dir_page_num;
+
+  // 逐个叶子建立索引
+  Cursor *cursor = table_start(table);
+  while (!cursor->end_of_table)
+  {
+    hash_index_put_leaf(pager, cursor->page_num);
+    void *node = get_page(pager, cursor->page_num);
+    cursor->cell_num = *leaf_node_num_cells(node) - 1;
+    cursor_advance(cursor);
+    page_cache_unpin_all();
+  }
+  free(cursor);
+}
+
+void hash_index_drop(Pager *pager)
+{
+  DbHeader *header = pager_header_for_write(pager);
+  uint32_t dir_page_num = header->hash_index_page;
+  void *dir = get_page(pager, dir_page_num);
+  uint32_t dir_size = 1u << *hash_dir_depth(dir);
+
+  // 局部深度为 d 的桶在目录中出现于下标 i, i + 2^d, ..., 先按 i < 2^d 收集一次再统一回收
+  uint32_t buckets[1u << HASH_DIR_MAX_DEPTH];
+  uint32_t num_buckets = 0;
+  for (uint32_t i = 0; i < dir_size; i++)
+  {
+    uint32_t bucket_page_num = *hash_dir_bucket(dir, i);
+    if (i < (1u << *hash_bucket_depth(get_page(pager, bucket_page_num))))
+    {
+      buckets[num_buckets++] = bucket_page_num;
+    }
+  }
+  for (uint32_t i = 0; i < num_buckets; i++)
+  {
+    uint32_t bucket_page_num = buckets[i];
+    while (bucket_page_num != 0)
+    {
+      uint32_t next_page_num = *hash_bucket_next(get_page(pager, bucket_page_num));
+      pager_free_page(pager, bucket_page_num);
+      bucket_page_num = next_page_num;
+    }
+  }
+  pager_free_page(pager, dir_page_num);
+  header->hash_index_page = 0;
+}
@@ -0,0 +1,29 @@
+#include "../include/io.h"
+
+static const IoMethods system_methods = {pread, pwrite, fsync, fdatasync};
+static const IoMethods *methods = &system_methods;
+
+void io_set_methods(const IoMethods *replacement)
+{
+  methods = replacement ? replacement : &system_methods;
+}
+
+ssize_t io_pread(int fd, void *buffer, size_t size, off_t offset)
+{
+  return methods->pread(fd, buffer, size, offset);
+}
+
+ssize_t io_pwrite(int fd, const void *buffer, size_t size, off_t offset)
+{
+  return methods->pwrite(fd, buffer, size, offset);
+}
+
+int io_fsync(int fd)
+{
+  return methods->fsync(fd);
+}
+
+int io_fdatasync(int fd)
+{
+  return methods->fdatasync(fd);
+}
@@ -0,0 +1,46 @@
+#include "../include/overflow.h"
+
+uint32_t overflow_write(Pager *pager, void *data, uint32_t size)
+{
+  uint32_t first_page_num = 0;
+  uint32_t *prev_next = &first_page_num;
+  while (size > 0)
+  {
+    uint32_t chunk = size < OVERFLOW_PAGE_DATA_SIZE ? size : OVERFLOW_PAGE_DATA_SIZE;
+    uint32_t page_num = get_unused_page_num(pager);
+    void *page = get_page_for_write(pager, page_num);
+
+    *prev_next = page_num;
+    *(uint32_t *)page = 0;
+    memcpy(page + OVERFLOW_PAGE_NEXT_SIZE, data, chunk);
+
+    prev_next = (uint32_t *)page;
+    data += chunk;
+    size -= chunk;
+  }
+  return first_page_num;
+}
+
+void overflow_read(Pager *pager, uint32_t page_num, void *buffer, uint32_t size)
+{
+  while (size > 0 && page_num != 0)
+  {
+    void *page = get_page(pager, page_num);
+    uint32_t chunk = size < OVERFLOW_PAGE_DATA_SIZE ? size : OVERFLOW_PAGE_DATA_SIZE;
+    memcpy(buffer, page + OVERFLOW_PAGE_NEXT_SIZE, chunk);
+
+    page_num = *(uint32_t *)page;
+    buffer += chunk;
+    size -= chunk;
+  }
+}
+
+void overflow_free(Pager *pager, uint32_t page_num)
+{
+  while (page_num != 0)
+  {
+    uint32_t next_page_num = *(uint32_t *)get_page(pager, page_num);
+    pager_free_page(pager, page_num);
+    page_num = next_page_num;
+  }
+}
@@ -1,6 +1,86 @@
 #include "../include/page.h"
+#include "../include/stats.h"
+#include "../include/page_cache.h"
+#include "../include/backup.h"
+#include "../include/shadow.h"
+#include "../include/io.h"
+#include "../include/result_cache.h"
 
-Pager *pager_open(const char *file_name)
+uint32_t db_page_size = PAGE_SIZE_DEFAULT;
+
+static Pager *open_pagers = NULL;
+static CommitMode commit_mode = COMMIT_IN_PLACE;
+static uint32_t new_page_size = PAGE_SIZE_DEFAULT;
+
+void pager_set_commit_mode(CommitMode mode)
+{
+  commit_mode = mode;
+}
+
+bool pager_set_page_size(uint32_t page_size)
+{
+  if (page_size < PAGE_SIZE_MIN || page_size > PAGE_SIZE_MAX || (page_size & (page_size - 1)) != 0)
+  {
+    return false;
+  }
+  new_page_size = page_size;
+  return true;
+}
+
+// 从文件开头读出页大小 (文件头与影子分页的提交槽都在前 PAGE_SIZE_MIN 字节内), 空文件取新建时的设置
+// 文件格式错误或页大小不支持时返回 0
+static uint32_t pager_file_page_size(int fd)
+{
+  uint8_t first[PAGE_SIZE_MIN];
+  ssize_t bytes_read = io_pread(fd, first, sizeof(first), 0);
+  if (bytes_read == 0)
+  {
+    return new_page_size;
+  }
+  if (bytes_read != sizeof(first))
+  {
+    printf("error: db file format error!\n");
+    return 0;
+  }
+  DbHeader *header = (DbHeader *)first;
+  uint32_t page_size = PAGE_SIZE_DEFAULT; // 旧文件没有记录页大小
+  if (strncmp(header->magic, DB_HEADER_MAGIC, DB_HEADER_MAGIC_SIZE) == 0 && header->page_size != 0)
+  {
+    page_size = header->page_size;
+  }
+  else if (shadow_file_page_size(first) != 0)
+  {
+    page_size = shadow_file_page_size(first);
+  }
+  if (page_size < PAGE_SIZE_MIN || page_size > PAGE_SIZE_MAX || (page_size & (page_size - 1)) != 0)
+  {
+    printf("error: db page size %u is not supported!\n", page_size);
+    return 0;
+  }
+  return page_size;
+}
+
+static bool pager_stat(Pager *pager)
+{
+  struct stat st;
+  if (fstat(pager->file_descirptor, &st) == -1)
+  {
+    printf("error: unable to stat file!\n");
+    return false;
+  }
+  if ((st.st_size % PAGE_SIZE) != 0)
+  {
+    printf("error: db file format error!\n");
+    return false;
+  }
+  pager->dev = st.st_dev;
+  pager->ino = st.st_ino;
+  pager->file_len = st.st_size;
+  pager->num_pages = (st.st_size / PAGE_SIZE);
+  return true;
+}
+
+static int pager_open_file(const char *file_name)
 {
   int fd = open(file_name,
                 O_RDWR | O_CREAT, // 读写模式 + 没有则创建
@@ -9,92 +89,347 @@ Pager *pager_open(const char *file_name)
   if (fd == -1)
   {
     printf("error: unable to open file!\n");
-    exit(EXIT_FAILURE);
   }
-  off_t file_length = lseek(fd, 0, SEEK_END);
+  return fd;
+}
 
+static bool pager_check_header(Pager *pager, DbHeader *header)
+{
+  if (strncmp(header->magic, DB_HEADER_MAGIC, DB_HEADER_MAGIC_SIZE) != 0 || header->format_version > DB_FORMAT_VERSION)
+  {
+    printf("error: db file format error!\n");
+    return false;
+  }
+  if (header->format_version == 0)
+  {
+    return true; // 旧文件, 由 table 层升级
+  }
+  if (header->page_size != PAGE_SIZE)
+  {
+    printf("error: db page size %u does not match the file!\n", header->page_size);
+    return false;
+  }
+  if (pager->shadow == NULL && header->page_count > pager->num_pages)
+  {
+    printf("error: db file is truncated (%u of %u pages)!\n", pager->num_pages, header->page_count);
+    return false;
+  }
+  return true;
+}
+
+// 从已打开链表中移除并释放 Pager, 不写回缓存页
+static void pager_free(Pager *pager)
+{
+  Pager **link = &open_pagers;
+  while (*link != pager)
+  {
+    link = &(*link)->next;
+  }
+  *link = pager->next;
+  bloom_free(pager->key_filter);
+  free(pager->file_name);
+  free(pager);
+}
+
+Pager *pager_open(const char *file_name)
+{
+  int fd = pager_open_file(file_name);
+  if (fd == -1)
+  {
+    return NULL;
+  }
+
+  // 页缓存的帧大小固定, 进程内同时打开的数据库必须使用相同的页大小
+  uint32_t page_size = pager_file_page_size(fd);
+  if (page_size != 0 && open_pagers == NULL && page_cache_num_pages() == 0)
+  {
+    page_cache_set_page_size(page_size);
+  }
+  else if (page_size != 0 && page_size != PAGE_SIZE)
+  {
+    printf("error: db page size %u differs from opened databases (%u)!\n", page_size, PAGE_SIZE);
+    page_size = 0;
+  }
   Pager *pager = (Pager *)malloc(sizeof(Pager));
   pager->file_descirptor = fd;
-  pager->file_len = file_length;
-  pager->num_pages = (file_length / PAGE_SIZE);
+  if (page_size == 0 || !pager_stat(pager))
+  {
+    close(fd);
+    free(pager);
+    return NULL;
+  }
 
-  if ((file_length % PAGE_SIZE) != 0)
+  // 同一文件已被打开: 共享已有的 Pager
+  for (Pager *opened = open_pagers; opened; opened = opened->next)
   {
-    printf("error: db file format error!\n");
-    exit(EXIT_FAILURE);
+    if (opened->dev == pager->dev && opened->ino == pager->ino)
+    {
+      close(pager->file_descirptor);
+      free(pager);
+      opened->ref_count += 1;
+      return opened;
+    }
+  }
+
+  pager->file_name = strdup(file_name);
+  pager->ref_count = 1;
+  pager->version = 0;
+  pager->key_filter = NULL;
+  pager->rightmost_leaf = 0;
+  pager->backup = NULL;
+  pager->shadow = shadow_open(pager->file_descirptor, pager->file_len, commit_mode == COMMIT_SHADOW);
+  if (pager->shadow)
+  {
+    // 物理页与逻辑页不对应, 逻辑页数以最近一次完整的提交为准
+    pager->num_pages = shadow_num_pages(pager->shadow);
   }
+  pager->next = open_pagers;
+  open_pagers = pager;
 
-  for (uint32_t i = 0; i < TABLE_MAX_PAGES; ++i)
+  bool empty = (pager->num_pages == 0);
+  DbHeader *header = pager_header(pager);
+  if (empty)
   {
-    pager->pages[i] = NULL;
+    // 新文件: 初始化文件头
+    pager_mark_dirty(pager, 0);
+    memset(header, 0, PAGE_SIZE);
+    strncpy(header->magic, DB_HEADER_MAGIC, DB_HEADER_MAGIC_SIZE);
+    header->format_version = DB_FORMAT_VERSION;
+    header->page_size = PAGE_SIZE;
+  }
+  else if (!pager_check_header(pager, header))
+  {
+    page_cache_drop_pager(pager);
+    if (pager->shadow)
+    {
+      shadow_close(pager->shadow);
+    }
+    close(pager->file_descirptor);
+    pager_free(pager);
+    return NULL;
   }
   return pager;
 }
 
-void *get_page(Pager *pager, uint32_t page_num)
+void pager_close(Pager *pager)
 {
-  if (page_num >= TABLE_MAX_PAGES)
+  pager->ref_count -= 1;
+  if (pager->ref_count > 0)
+  {
+    return;
+  }
+
+  page_cache_flush_pager(pager);
+  page_cache_drop_pager(pager);
+  result_cache_drop_pager(pager);
+  if (pager->shadow)
+  {
+    shadow_commit(pager->shadow, pager->num_pages);
+    shadow_close(pager->shadow);
+  }
+  int result = close(pager->file_descirptor);
+  if (result == -1)
   {
-    printf("error: page_num = %d out of max_page_counts = %d\n", page_num, TABLE_MAX_PAGES);
+    ERROR("close file error!");
     exit(EXIT_FAILURE);
   }
-  if (pager->pages[page_num] == NULL)
+  pager_free(pager);
+}
+
+void pager_reload(Pager *pager)
+{
+  page_cache_drop_pager(pager);
+  close(pager->file_descirptor);
+  pager->file_descirptor = pager_open_file(pager->file_name);
+  if (pager->file_descirptor == -1 || !pager_stat(pager))
   {
-    void *page = malloc(PAGE_SIZE);
-    DEBUG("malloc a new page!");
+    exit(EXIT_FAILURE);
+  }
+  pager->rightmost_leaf = 0;
+  pager->version += 1;
+}
+
+void *get_page(Pager *pager, uint32_t page_num)
+{
+  if (pager->backup)
+  {
+    backup_page_touched(pager->backup, page_num);
+  }
+  void *page = page_cache_lookup(pager, page_num);
+  if (page != NULL)
+  {
+    STATS_INC(pager, page_hits);
+    return page;
+  }
 
-    uint32_t num_pages = pager->file_len / PAGE_SIZE;
-    if (pager->file_len % PAGE_SIZE)
+  STATS_INC(pager, page_misses);
+  page = page_cache_insert(pager, page_num);
+  DEBUGS("cache a new page: %d", page_num);
+
+  // 若该页 持久化 在磁盘上，则从磁盘读取
+  if (pager->shadow)
+  {
+    if (shadow_read_page(pager->shadow, page_num, page))
     {
-      num_pages += 1;
+      STATS_INC(pager, page_reads);
+      STATS_ADD(pager, bytes_read, PAGE_SIZE);
     }
-
-    // 若该页 持久化 在磁盘上，则从磁盘读取
-    if (page_num <= num_pages)
+    else
     {
-      lseek(pager->file_descirptor, page_num * PAGE_SIZE, SEEK_SET);
-      ssize_t bytes_read = read(pager->file_descirptor, page, PAGE_SIZE);
-      if (bytes_read == -1)
-      {
-        printf("error: read file failure!");
-        exit(EXIT_FAILURE);
-      }
+      memset(page, 0, PAGE_SIZE);
+      page_cache_mark_dirty(pager, page_num);
     }
-    pager->pages[page_num] = page;
-
-    if (page_num >= pager->num_pages)
+  }
+  else if (page_num < pager->file_len / PAGE_SIZE)
+  {
+    ssize_t bytes_read = io_pread(pager->file_descirptor, page, PAGE_SIZE, (off_t)page_num * PAGE_SIZE);
+    if (bytes_read == -1)
     {
-      pager->num_pages = page_num + 1;
+      printf("error: read file failure!");
+      exit(EXIT_FAILURE);
     }
+    STATS_INC(pager, page_reads);
+    STATS_ADD(pager, bytes_read, bytes_read);
+  }
+  else
+  {
+    // 文件之外的新页, 需写回以扩展文件
+    memset(page, 0, PAGE_SIZE);
+    page_cache_mark_dirty(pager, page_num);
+  }
+
+  if (page_num >= pager->num_pages)
+  {
+    pager->num_pages = page_num + 1;
+  }
+  return page;
+}
+
+void *get_page_for_write(Pager *pager, uint32_t page_num)
+{
+  void *page = get_page(pager, page_num);
+  page_cache_mark_dirty(pager, page_num);
+  return page;
+}
+
+void pager_mark_dirty(Pager *pager, uint32_t page_num)
+{
+  // 调用方在当前语句内取过的页被隐式 pin, 不会被淘汰, 标记总能命中;
+  // 尚未取过的页先读入缓存再标记, 之后的 get_page 得到的就是这一帧
+  if (!page_cache_mark_dirty(pager, page_num))
+  {
+    get_page_for_write(pager, page_num);
   }
-  return pager->pages[page_num];
 }
 
+DbHeader *pager_header(Pager *pager)
+{
+  return (DbHeader *)get_page(pager, 0);
+}
+
+DbHeader *pager_header_for_write(Pager *pager)
+{
+  return (DbHeader *)get_page_for_write(pager, 0);
+}
+
+/*
+  空闲链表由 trunk 页串联, 每个 trunk 页记录若干空闲的叶子页号：
+  header->freelist_trunk -> trunk{next, count, [p1, p2, ...]} -> trunk{...} -> 0
+  分配时先取当前 trunk 中的叶子页, 取空后再复用 trunk 页本身
+*/
 uint32_t get_unused_page_num(Pager *pager)
 {
-  return pager->num_pages;
+  DbHeader *header = pager_header(pager);
+  if (header->freelist_trunk == 0)
+  {
+    // 文件增长, 文件头写回时记录新的页数
+    pager_mark_dirty(pager, 0);
+    return pager->num_pages;
+  }
+
+  uint32_t trunk_page_num = header->freelist_trunk;
+  void *trunk = get_page_for_write(pager, trunk_page_num);
+  pager_mark_dirty(pager, 0);
+  uint32_t *count = trunk + FREELIST_TRUNK_COUNT_OFFSET;
+  uint32_t *leaves = trunk + FREELIST_TRUNK_HEADER_SIZE;
+
+  header->freelist_count -= 1;
+  if (*count > 0)
+  {
+    *count -= 1;
+    return leaves[*count];
+  }
+  header->freelist_trunk = *(uint32_t *)(trunk + FREELIST_TRUNK_NEXT_OFFSET);
+  return trunk_page_num;
 }
 
-void pager_flush(Pager *pager, uint32_t page_num)
+void pager_free_page(Pager *pager, uint32_t page_num)
 {
-  if (pager->pages[page_num] == NULL)
+  DbHeader *header = pager_header_for_write(pager);
+  void *page = get_page_for_write(pager, page_num);
+  memset(page, 0, PAGE_SIZE);
+  header->freelist_count += 1;
+  if (pager->rightmost_leaf == page_num)
   {
-    ERROR("flush null page!");
-    exit(EXIT_FAILURE);
+    pager->rightmost_leaf = 0;
   }
-  off_t offset = lseek(pager->file_descirptor,
-                       page_num * PAGE_SIZE, SEEK_CUR);
-  if (offset == -1)
+
+  if (header->freelist_trunk != 0)
   {
-    ERROR("seek error!");
-    exit(EXIT_FAILURE);
+    void *trunk = get_page(pager, header->freelist_trunk);
+    uint32_t *count = trunk + FREELIST_TRUNK_COUNT_OFFSET;
+    if (*count < FREELIST_TRUNK_MAX_LEAVES)
+    {
+      pager_mark_dirty(pager, header->freelist_trunk);
+      uint32_t *leaves = trunk + FREELIST_TRUNK_HEADER_SIZE;
+      leaves[*count] = page_num;
+      *count += 1;
+      return;
+    }
   }
-  ssize_t bytes_written = write(pager->file_descirptor,
-                                pager->pages[page_num],
-                                PAGE_SIZE);
+
+  // 当前 trunk 已满 (或没有 trunk): 被释放的页成为新的 trunk
+  *(uint32_t *)(page + FREELIST_TRUNK_NEXT_OFFSET) = header->freelist_trunk;
+  header->freelist_trunk = page_num;
+}
+
+void pager_flush(Pager *pager)
+{
+  page_cache_flush_pager(pager);
+}
+
+void pager_commit(Pager *pager)
+{
+  if (pager->shadow)
+  {
+    page_cache_flush_pager(pager);
+    shadow_commit(pager->shadow, pager->num_pages);
+  }
+}
+
+void pager_write_page(Pager *pager, uint32_t page_num, void *data)
+{
+  if (page_num == 0)
+  {
+    ((DbHeader *)data)->page_count = pager->num_pages;
+  }
+  if (pager->shadow)
+  {
+    shadow_write_page(pager->shadow, page_num, data);
+    return;
+  }
+  ssize_t bytes_written = io_pwrite(pager->file_descirptor, data, PAGE_SIZE, (off_t)page_num * PAGE_SIZE);
   if (bytes_written == -1)
   {
     ERROR("write error!");
     exit(EXIT_FAILURE);
   }
-}
\ No newline at end of file
+  STATS_INC(pager, page_writes);
+  STATS_ADD(pager, bytes_flushed, bytes_written);
+
+  // 淘汰写回可能越过文件末尾, 之后读取该页需从磁盘读
+  if ((off_t)(page_num + 1) * PAGE_SIZE > pager->file_len)
+  {
+    pager->file_len = (page_num + 1) * PAGE_SIZE;
+  }
+}
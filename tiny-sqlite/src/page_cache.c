@@ -0,0 +1,374 @@
+#include <sys/mman.h>
+
+#include "../include/page_cache.h"
+#include "../include/stats.h"
+
+#define PAGE_CACHE_MIN_BUCKETS 64
+#define HUGE_PAGE_SIZE         (2 << 20)
+
+typedef struct CachedPage {
+  Pager *pager;
+  uint32_t page_num;
+  bool dirty;                 // 上次写回之后被修改过 (调用方修改页内存前经 page_cache_mark_dirty 标记)
+  bool in_arena;              // 帧来自 arena; 否则是超出预算时单独分配的
+  uint64_t epoch;             // 最近一次访问所在的语句
+  struct CachedPage *hash_next; // 空闲帧链表也用这个指针
+  struct CachedPage *lru_prev; // 链表头为最近访问
+  struct CachedPage *lru_next;
+  void *data;
+} CachedPage;
+
+// 一段连续的页帧: 帧描述符数组 + mmap 得到的页内存
+typedef struct Arena {
+  struct Arena *next;
+  void *mapping;
+  size_t mapping_size;
+  CachedPage *frames;
+  uint32_t num_frames;
+} Arena;
+
+static struct {
+  CachedPage **buckets;
+  uint32_t num_buckets;
+  uint32_t num_pages;
+  size_t budget_bytes;
+  uint32_t budget_pages;
+  uint64_t epoch;
+  CachedPage lru; // 哨兵
+  Arena *arenas;
+  uint32_t arena_frames;   // 所有 arena 的帧数
+  CachedPage *free_frames;
+  bool huge_pages;
+  PageCacheArenaKind arena_kind;
+} cache = {
+    .budget_bytes = PAGE_CACHE_DEFAULT_SIZE,
+    .budget_pages = PAGE_CACHE_DEFAULT_SIZE / PAGE_SIZE_DEFAULT,
+    .epoch = 1,
+    .lru = {.lru_prev = &cache.lru, .lru_next = &cache.lru},
+};
+
+/*
+  新增一段至少 num_frames 帧的 arena:
+  启用大页时先尝试 MAP_HUGETLB (需要系统预留大页), 失败则用普通映射按 2MB 对齐并 madvise 透明大页
+*/
+static void page_cache_add_arena(uint32_t num_frames)
+{
+  size_t size = (size_t)num_frames * PAGE_SIZE;
+  void *mapping = MAP_FAILED;
+  void *memory = NULL;
+  size_t mapping_size = size;
+  if (cache.huge_pages)
+  {
+    mapping_size = (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    mapping = mmap(NULL, mapping_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (mapping != MAP_FAILED)
+    {
+      memory = mapping;
+      size = mapping_size; // 大页的零头也用作帧
+      cache.arena_kind = PAGE_CACHE_ARENA_HUGETLB;
+    }
+  }
+  if (mapping == MAP_FAILED)
+  {
+    mapping_size = cache.huge_pages ? size + HUGE_PAGE_SIZE : size;
+    mapping = mmap(NULL, mapping_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED)
+    {
+      ERROR("page cache: unable to map arena!");
+      exit(EXIT_FAILURE);
+    }
+    memory = mapping;
+    if (cache.huge_pages)
+    {
+      memory = (void *)(((uintptr_t)mapping + HUGE_PAGE_SIZE - 1) & ~((uintptr_t)HUGE_PAGE_SIZE - 1));
+      madvise(memory, size, MADV_HUGEPAGE);
+      if (cache.arena_kind != PAGE_CACHE_ARENA_HUGETLB)
+      {
+        cache.arena_kind = PAGE_CACHE_ARENA_THP;
+      }
+    }
+  }
+
+  Arena *arena = malloc(sizeof(Arena));
+  arena->mapping = mapping;
+  arena->mapping_size = mapping_size;
+  arena->num_frames = size / PAGE_SIZE;
+  arena->frames = calloc(arena->num_frames, sizeof(CachedPage));
+  for (uint32_t i = 0; i < arena->num_frames; i++)
+  {
+    CachedPage *frame = &arena->frames[i];
+    frame->in_arena = true;
+    frame->data = (uint8_t *)memory + (size_t)i * PAGE_SIZE;
+    frame->hash_next = cache.free_frames;
+    cache.free_frames = frame;
+  }
+  arena->next = cache.arenas;
+  cache.arenas = arena;
+  cache.arena_frames += arena->num_frames;
+}
+
+static void page_cache_free_arenas()
+{
+  while (cache.arenas)
+  {
+    Arena *arena = cache.arenas;
+    cache.arenas = arena->next;
+    munmap(arena->mapping, arena->mapping_size);
+    free(arena->frames);
+    free(arena);
+  }
+  cache.arena_frames = 0;
+  cache.free_frames = NULL;
+  cache.arena_kind = PAGE_CACHE_ARENA_NORMAL;
+}
+
+// 预算内的帧从 arena 取, 全部被 pin 住而超出预算时单独分配
+static CachedPage *page_cache_alloc_frame()
+{
+  if (cache.free_frames == NULL && cache.arena_frames < cache.budget_pages)
+  {
+    page_cache_add_arena(cache.budget_pages - cache.arena_frames);
+  }
+  CachedPage *frame = cache.free_frames;
+  if (frame != NULL)
+  {
+    cache.free_frames = frame->hash_next;
+    return frame;
+  }
+  frame = malloc(sizeof(CachedPage));
+  frame->in_arena = false;
+  frame->data = malloc(PAGE_SIZE);
+  return frame;
+}
+
+static void page_cache_free_frame(CachedPage *frame)
+{
+  if (frame->in_arena)
+  {
+    frame->hash_next = cache.free_frames;
+    cache.free_frames = frame;
+    return;
+  }
+  free(frame->data);
+  free(frame);
+}
+
+static uint32_t page_cache_hash(Pager *pager, uint32_t page_num)
+{
+  uint64_t h = ((uintptr_t)pager >> 4) * 0x9E3779B97F4A7C15ULL ^ (uint64_t)page_num * 0xC2B2AE3D27D4EB4FULL;
+  return (uint32_t)(h >> 32) & (cache.num_buckets - 1);
+}
+
+static void lru_unlink(CachedPage *entry)
+{
+  entry->lru_prev->lru_next = entry->lru_next;
+  entry->lru_next->lru_prev = entry->lru_prev;
+}
+
+static void lru_push_front(CachedPage *entry)
+{
+  entry->lru_prev = &cache.lru;
+  entry->lru_next = cache.lru.lru_next;
+  cache.lru.lru_next->lru_prev = entry;
+  cache.lru.lru_next = entry;
+}
+
+static CachedPage **page_cache_slot(Pager *pager, uint32_t page_num)
+{
+  CachedPage **slot = &cache.buckets[page_cache_hash(pager, page_num)];
+  while (*slot && ((*slot)->pager != pager || (*slot)->page_num != page_num))
+  {
+    slot = &(*slot)->hash_next;
+  }
+  return slot;
+}
+
+// 装载因子超过 1 时桶数翻倍
+static void page_cache_grow()
+{
+  uint32_t old_num_buckets = cache.num_buckets;
+  CachedPage **old_buckets = cache.buckets;
+  cache.num_buckets = old_num_buckets ? old_num_buckets * 2 : PAGE_CACHE_MIN_BUCKETS;
+  cache.buckets = calloc(cache.num_buckets, sizeof(CachedPage *));
+
+  for (uint32_t i = 0; i < old_num_buckets; i++)
+  {
+    CachedPage *entry = old_buckets[i];
+    while (entry)
+    {
+      CachedPage *next = entry->hash_next;
+      uint32_t bucket = page_cache_hash(entry->pager, entry->page_num);
+      entry->hash_next = cache.buckets[bucket];
+      cache.buckets[bucket] = entry;
+      entry = next;
+    }
+  }
+  free(old_buckets);
+}
+
+static void page_cache_write_back(CachedPage *entry)
+{
+  if (entry->dirty)
+  {
+    pager_write_page(entry->pager, entry->page_num, entry->data);
+    entry->dirty = false;
+  }
+}
+
+static void page_cache_remove(CachedPage *entry)
+{
+  CachedPage **slot = page_cache_slot(entry->pager, entry->page_num);
+  *slot = entry->hash_next;
+  lru_unlink(entry);
+  cache.num_pages -= 1;
+  page_cache_free_frame(entry);
+}
+
+// 从 LRU 尾部淘汰未被当前语句 pin 住的页, 直到不超过 target 页
+static void page_cache_evict(uint32_t target)
+{
+  CachedPage *entry = cache.lru.lru_prev;
+  while (cache.num_pages > target && entry != &cache.lru)
+  {
+    CachedPage *prev = entry->lru_prev;
+    if (entry->epoch < cache.epoch)
+    {
+      page_cache_write_back(entry);
+      page_cache_remove(entry);
+      STATS_INC(pager, page_evictions);
+    }
+    entry = prev;
+  }
+}
+
+void page_cache_set_budget(size_t bytes)
+{
+  cache.budget_bytes = bytes;
+  cache.budget_pages = bytes / PAGE_SIZE ? bytes / PAGE_SIZE : 1;
+  page_cache_evict(cache.budget_pages);
+}
+
+size_t page_cache_budget()
+{
+  return (size_t)cache.budget_pages * PAGE_SIZE;
+}
+
+void page_cache_set_page_size(uint32_t page_size)
+{
+  if (page_size == PAGE_SIZE)
+  {
+    return;
+  }
+  // 只在缓存为空时调用, 旧 arena 的帧大小不再适用
+  page_cache_free_arenas();
+  db_page_size = page_size;
+  page_cache_set_budget(cache.budget_bytes);
+}
+
+void page_cache_set_huge_pages(bool enabled)
+{
+  cache.huge_pages = enabled;
+}
+
+PageCacheArenaKind page_cache_arena_kind()
+{
+  return cache.arena_kind;
+}
+
+uint32_t page_cache_num_pages()
+{
+  return cache.num_pages;
+}
+
+void page_cache_unpin_all()
+{
+  cache.epoch += 1;
+}
+
+void *page_cache_lookup(Pager *pager, uint32_t page_num)
+{
+  if (cache.num_buckets == 0)
+  {
+    return NULL;
+  }
+  CachedPage *entry = *page_cache_slot(pager, page_num);
+  if (entry == NULL)
+  {
+    return NULL;
+  }
+  entry->epoch = cache.epoch;
+  lru_unlink(entry);
+  lru_push_front(entry);
+  return entry->data;
+}
+
+void *page_cache_peek(Pager *pager, uint32_t page_num)
+{
+  if (cache.num_buckets == 0)
+  {
+    return NULL;
+  }
+  CachedPage *entry = *page_cache_slot(pager, page_num);
+  return entry ? entry->data : NULL;
+}
+
+bool page_cache_mark_dirty(Pager *pager, uint32_t page_num)
+{
+  CachedPage *entry = cache.num_buckets ? *page_cache_slot(pager, page_num) : NULL;
+  if (entry == NULL)
+  {
+    return false;
+  }
+  entry->dirty = true;
+  return true;
+}
+
+void *page_cache_insert(Pager *pager, uint32_t page_num)
+{
+  if (cache.num_pages >= cache.budget_pages)
+  {
+    page_cache_evict(cache.budget_pages - 1);
+  }
+  if (cache.num_pages >= cache.num_buckets)
+  {
+    page_cache_grow();
+  }
+
+  CachedPage *entry = page_cache_alloc_frame();
+  entry->pager = pager;
+  entry->page_num = page_num;
+  entry->dirty = false;
+  entry->epoch = cache.epoch;
+
+  uint32_t bucket = page_cache_hash(pager, page_num);
+  entry->hash_next = cache.buckets[bucket];
+  cache.buckets[bucket] = entry;
+  lru_push_front(entry);
+  cache.num_pages += 1;
+  return entry->data;
+}
+
+void page_cache_flush_pager(Pager *pager)
+{
+  for (CachedPage *entry = cache.lru.lru_next; entry != &cache.lru; entry = entry->lru_next)
+  {
+    if (entry->pager == pager)
+    {
+      page_cache_write_back(entry);
+    }
+  }
+}
+
+void page_cache_drop_pager(Pager *pager)
+{
+  CachedPage *entry = cache.lru.lru_next;
+  while (entry != &cache.lru)
+  {
+    CachedPage *next = entry->lru_next;
+    if (entry->pager == pager)
+    {
+      page_cache_remove(entry);
+    }
+    entry = next;
+  }
+}
@@ -0,0 +1,156 @@
+#include "../include/protocol.h"
+
+void buffer_reserve(ByteBuffer *buffer, size_t extra)
+{
+  if (buffer->length + extra <= buffer->capacity)
+  {
+    return;
+  }
+  size_t capacity = buffer->capacity ? buffer->capacity : 256;
+  while (capacity < buffer->length + extra)
+  {
+    capacity *= 2;
+  }
+  buffer->data = realloc(buffer->data, capacity);
+  buffer->capacity = capacity;
+}
+
+void buffer_put(ByteBuffer *buffer, const void *source, size_t size)
+{
+  buffer_reserve(buffer, size);
+  memcpy(buffer->data + buffer->length, source, size);
+  buffer->length += size;
+}
+
+void buffer_put_u8(ByteBuffer *buffer, uint8_t value)
+{
+  buffer_put(buffer, &value, sizeof(value));
+}
+
+void buffer_put_u16(ByteBuffer *buffer, uint16_t value)
+{
+  buffer_put(buffer, &value, sizeof(value));
+}
+
+void buffer_put_u32(ByteBuffer *buffer, uint32_t value)
+{
+  buffer_put(buffer, &value, sizeof(value));
+}
+
+void buffer_put_u64(ByteBuffer *buffer, uint64_t value)
+{
+  buffer_put(buffer, &value, sizeof(value));
+}
+
+void buffer_put_text(ByteBuffer *buffer, const char *text, uint16_t size)
+{
+  buffer_put_u16(buffer, size);
+  buffer_put(buffer, text, size);
+}
+
+void buffer_consume(ByteBuffer *buffer, size_t size)
+{
+  memmove(buffer->data, buffer->data + size, buffer->length - size);
+  buffer->length -= size;
+}
+
+void buffer_free(ByteBuffer *buffer)
+{
+  free(buffer->data);
+  buffer->data = NULL;
+  buffer->length = 0;
+  buffer->capacity = 0;
+}
+
+size_t frame_begin(ByteBuffer *buffer, FrameType type)
+{
+  size_t frame_start = buffer->length;
+  buffer_put_u32(buffer, 0);
+  buffer_put_u8(buffer, type);
+  return frame_start;
+}
+
+void frame_end(ByteBuffer *buffer, size_t frame_start)
+{
+  uint32_t length = buffer->length - frame_start - PROTOCOL_LENGTH_SIZE;
+  memcpy(buffer->data + frame_start, &length, sizeof(length));
+}
+
+size_t frame_complete(const void *data, size_t size)
+{
+  if (size < PROTOCOL_LENGTH_SIZE)
+  {
+    return 0;
+  }
+  uint32_t length;
+  memcpy(&length, data, sizeof(length));
+  if (size - PROTOCOL_LENGTH_SIZE < length)
+  {
+    return 0;
+  }
+  return PROTOCOL_LENGTH_SIZE + length;
+}
+
+void reader_init(FrameReader *reader, const void *payload, size_t size)
+{
+  reader->position = payload;
+  reader->remaining = size;
+  reader->overrun = false;
+}
+
+static bool reader_take(FrameReader *reader, void *destination, size_t size)
+{
+  if (reader->overrun || reader->remaining < size)
+  {
+    reader->overrun = true;
+    memset(destination, 0, size);
+    return false;
+  }
+  memcpy(destination, reader->position, size);
+  reader->position += size;
+  reader->remaining -= size;
+  return true;
+}
+
+uint8_t reader_u8(FrameReader *reader)
+{
+  uint8_t value;
+  reader_take(reader, &value, sizeof(value));
+  return value;
+}
+
+uint16_t reader_u16(FrameReader *reader)
+{
+  uint16_t value;
+  reader_take(reader, &value, sizeof(value));
+  return value;
+}
+
+uint32_t reader_u32(FrameReader *reader)
+{
+  uint32_t value;
+  reader_take(reader, &value, sizeof(value));
+  return value;
+}
+
+uint64_t reader_u64(FrameReader *reader)
+{
+  uint64_t value;
+  reader_take(reader, &value, sizeof(value));
+  return value;
+}
+
+const char *reader_text(FrameReader *reader, uint16_t *size)
+{
+  *size = reader_u16(reader);
+  if (reader->overrun || reader->remaining < *size)
+  {
+    reader->overrun = true;
+    *size = 0;
+    return NULL;
+  }
+  const char *text = (const char *)reader->position;
+  reader->position += *size;
+  reader->remaining -= *size;
+  return text;
+}
@@ -1,17 +1,84 @@
 #include "../include/record.h"
 
-void serialize_row(Row* source, void* destination) {
-  memcpy(destination + ID_OFFSET, &(source->id), ID_SIZE);
-  strncpy(destination + USERNAME_OFFSET, (source->username), USERNAME_SIZE);
-  strncpy(destination + EMAIL_OFFSET, (source->email), EMAIL_SIZE);
-}
+// 以下函数由 schema.def 展开: 每列一段直线代码, 偏移均为编译期常量, 运行时不遍历列信息
+
+// 序列化
+#define TABLE(type, suffix) \
+  uint32_t serialize_##suffix(type *source, void *destination) \
+  { \
+    uint8_t *out = destination;
+#define COLUMN_U64(type, suffix, name) \
+    memcpy(out + RECORD_OFFSET(type, name), &source->name, sizeof(uint64_t));
+#define COLUMN_TEXT(type, suffix, name, capacity) \
+    strncpy((char *)out + RECORD_OFFSET(type, name), source->name, capacity);
+#define COLUMN_TAIL_TEXT(type, suffix, name, capacity) \
+    uint32_t name##_len = strnlen(source->name, capacity); \
+    memcpy(out + RECORD_OFFSET(type, name), source->name, name##_len); \
+    return RECORD_OFFSET(type, name) + name##_len;
+#define TABLE_END(type, suffix) \
+  }
+#include "../include/schema.def"
+
+// 反序列化
+#define TABLE(type, suffix) \
+  void deserialize_##suffix(void *source, uint32_t size, type *destination) \
+  { \
+    uint8_t *in = source;
+#define COLUMN_U64(type, suffix, name) \
+    memcpy(&destination->name, in + RECORD_OFFSET(type, name), sizeof(uint64_t));
+#define COLUMN_TEXT(type, suffix, name, capacity) \
+    strncpy(destination->name, (char *)in + RECORD_OFFSET(type, name), capacity);
+#define COLUMN_TAIL_TEXT(type, suffix, name, capacity) \
+    uint32_t name##_len = size > RECORD_OFFSET(type, name) ? size - RECORD_OFFSET(type, name) : 0; \
+    memcpy(destination->name, in + RECORD_OFFSET(type, name), name##_len); \
+    memset(destination->name + name##_len, 0, capacity - name##_len);
+#define TABLE_END(type, suffix) \
+  }
+#include "../include/schema.def"
 
-void deserialize_row(void* source, Row* destination) {
-  memcpy(&(destination->id), source + ID_OFFSET, ID_SIZE);
-  strncpy((destination->username), source + USERNAME_OFFSET, USERNAME_SIZE);
-  strncpy((destination->email), source + EMAIL_OFFSET, EMAIL_SIZE);
+// 按列比较
+#define COLUMN_U64(type, suffix, name) \
+  int compare_##suffix##_##name(const void *a, const void *b) \
+  { \
+    uint64_t x = ((const type *)a)->name; \
+    uint64_t y = ((const type *)b)->name; \
+    return (x > y) - (x < y); \
+  }
+#define COLUMN_TEXT(type, suffix, name, capacity) \
+  int compare_##suffix##_##name(const void *a, const void *b) \
+  { \
+    return strncmp(((const type *)a)->name, ((const type *)b)->name, capacity); \
+  }
+#define COLUMN_TAIL_TEXT(type, suffix, name, capacity) COLUMN_TEXT(type, suffix, name, capacity)
+#include "../include/schema.def"
+
+// 列信息表
+#define TABLE(type, suffix) \
+  const ColumnInfo suffix##_columns[] = {
+#define COLUMN_U64(type, suffix, name) \
+    {#name, COLUMN_KIND_U64, sizeof(uint64_t), offsetof(type, name), \
+     RECORD_OFFSET(type, name) + sizeof(uint64_t), compare_##suffix##_##name},
+#define COLUMN_TEXT(type, suffix, name, capacity) \
+    {#name, COLUMN_KIND_TEXT, capacity, offsetof(type, name), \
+     RECORD_OFFSET(type, name) + capacity, compare_##suffix##_##name},
+#define COLUMN_TAIL_TEXT(type, suffix, name, capacity) COLUMN_TEXT(type, suffix, name, capacity)
+#define TABLE_END(type, suffix) \
+  }; \
+  const uint32_t suffix##_num_columns = sizeof(suffix##_columns) / sizeof(ColumnInfo);
+#include "../include/schema.def"
+
+const ColumnInfo *find_column(const ColumnInfo *columns, uint32_t num_columns, const char *name)
+{
+  for (uint32_t i = 0; i < num_columns; i++)
+  {
+    if (strcmp(columns[i].name, name) == 0)
+    {
+      return &columns[i];
+    }
+  }
+  return NULL;
 }
 
 void print_row(Row* row) {
-  printf("id: %d\t usrname: %s\t email: %s\n", row->id, row->username, row->email);
-}
\ No newline at end of file
+  printf("id: %lu\t usrname: %s\t email: %s\n", row->id, row->username, row->email);
+}
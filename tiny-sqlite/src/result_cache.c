@@ -0,0 +1,262 @@
+#include "../include/result_cache.h"
+#include "../include/stats.h"
+
+#define RESULT_ROW_LENGTH_SIZE sizeof(uint32_t)
+
+typedef struct CachedResult {
+  Pager *pager;
+  uint64_t version; // 生成时的 pager->version
+  uint64_t hash;
+  char *key;
+  uint8_t *data;    // [长度 : 序列化的行] ...
+  size_t size;
+  size_t charge;    // 计入预算的字节数
+  uint32_t status;
+  struct CachedResult *hash_next;
+  struct CachedResult *lru_prev; // 链表头为最近使用
+  struct CachedResult *lru_next;
+} CachedResult;
+
+struct ResultBuilder {
+  uint8_t *data;
+  size_t size;
+  size_t capacity;
+  bool too_large;
+};
+
+static struct {
+  CachedResult **buckets;
+  uint32_t num_buckets;
+  uint32_t num_entries;
+  size_t budget_bytes;
+  size_t used_bytes;
+  CachedResult lru; // 哨兵
+} cache = {
+    .budget_bytes = RESULT_CACHE_DEFAULT_SIZE,
+    .lru = {.lru_prev = &cache.lru, .lru_next = &cache.lru},
+};
+
+// FNV-1a, 再混入 pager 地址
+static uint64_t result_cache_hash(Pager *pager, const char *key)
+{
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (const char *p = key; *p; p++)
+  {
+    h = (h ^ (uint8_t)*p) * 0x100000001b3ULL;
+  }
+  return h ^ ((uintptr_t)pager >> 4) * 0x9E3779B97F4A7C15ULL;
+}
+
+static CachedResult **result_cache_slot(Pager *pager, const char *key, uint64_t hash)
+{
+  CachedResult **slot = &cache.buckets[hash & (cache.num_buckets - 1)];
+  while (*slot && ((*slot)->hash != hash || (*slot)->pager != pager || strcmp((*slot)->key, key) != 0))
+  {
+    slot = &(*slot)->hash_next;
+  }
+  return slot;
+}
+
+// 装载因子超过 1 时桶数翻倍
+static void result_cache_grow()
+{
+  uint32_t old_num_buckets = cache.num_buckets;
+  CachedResult **old_buckets = cache.buckets;
+  cache.num_buckets = old_num_buckets ? old_num_buckets * 2 : RESULT_CACHE_MIN_BUCKETS;
+  cache.buckets = calloc(cache.num_buckets, sizeof(CachedResult *));
+
+  for (uint32_t i = 0; i < old_num_buckets; i++)
+  {
+    CachedResult *entry = old_buckets[i];
+    while (entry)
+    {
+      CachedResult *next = entry->hash_next;
+      uint32_t bucket = entry->hash & (cache.num_buckets - 1);
+      entry->hash_next = cache.buckets[bucket];
+      cache.buckets[bucket] = entry;
+      entry = next;
+    }
+  }
+  free(old_buckets);
+}
+
+static void lru_unlink(CachedResult *entry)
+{
+  entry->lru_prev->lru_next = entry->lru_next;
+  entry->lru_next->lru_prev = entry->lru_prev;
+}
+
+static void lru_push_front(CachedResult *entry)
+{
+  entry->lru_prev = &cache.lru;
+  entry->lru_next = cache.lru.lru_next;
+  cache.lru.lru_next->lru_prev = entry;
+  cache.lru.lru_next = entry;
+}
+
+static void result_cache_remove(CachedResult *entry)
+{
+  CachedResult **slot = result_cache_slot(entry->pager, entry->key, entry->hash);
+  *slot = entry->hash_next;
+  lru_unlink(entry);
+  cache.num_entries -= 1;
+  cache.used_bytes -= entry->charge;
+  free(entry->key);
+  free(entry->data);
+  free(entry);
+}
+
+// 从 LRU 尾部淘汰, 直到不超过 target 字节
+static void result_cache_evict(size_t target)
+{
+  while (cache.used_bytes > target && cache.lru.lru_prev != &cache.lru)
+  {
+    result_cache_remove(cache.lru.lru_prev);
+    STATS_INC(query, result_evictions);
+  }
+}
+
+void result_cache_set_budget(size_t bytes)
+{
+  cache.budget_bytes = bytes;
+  result_cache_evict(bytes);
+}
+
+size_t result_cache_budget()
+{
+  return cache.budget_bytes;
+}
+
+size_t result_cache_used()
+{
+  return cache.used_bytes;
+}
+
+bool result_cache_enabled()
+{
+  return cache.budget_bytes > 0;
+}
+
+bool result_cache_replay(Pager *pager, const char *key, CachedRowSink sink, void *arg, uint32_t *status)
+{
+  if (cache.num_entries == 0)
+  {
+    STATS_INC(query, result_misses);
+    return false;
+  }
+  uint64_t hash = result_cache_hash(pager, key);
+  CachedResult *entry = *result_cache_slot(pager, key, hash);
+  if (entry != NULL && entry->version != pager->version)
+  {
+    // 表在结果生成之后被修改过
+    result_cache_remove(entry);
+    entry = NULL;
+  }
+  if (entry == NULL)
+  {
+    STATS_INC(query, result_misses);
+    return false;
+  }
+
+  STATS_INC(query, result_hits);
+  lru_unlink(entry);
+  lru_push_front(entry);
+  Row row;
+  size_t offset = 0;
+  while (offset < entry->size)
+  {
+    uint32_t length = *(uint32_t *)(entry->data + offset);
+    deserialize_row(entry->data + offset + RESULT_ROW_LENGTH_SIZE, length, &row);
+    offset += RESULT_ROW_LENGTH_SIZE + length;
+    sink(&row, arg);
+  }
+  *status = entry->status;
+  return true;
+}
+
+ResultBuilder *result_builder_new()
+{
+  return calloc(1, sizeof(ResultBuilder));
+}
+
+void result_builder_add(ResultBuilder *builder, Row *row)
+{
+  if (builder->too_large)
+  {
+    return;
+  }
+  size_t needed = builder->size + RESULT_ROW_LENGTH_SIZE + ROW_SIZE;
+  if (needed > cache.budget_bytes / 4)
+  {
+    builder->too_large = true;
+    free(builder->data);
+    builder->data = NULL;
+    return;
+  }
+  if (needed > builder->capacity)
+  {
+    builder->capacity = builder->capacity ? builder->capacity * 2 : 4096;
+    while (builder->capacity < needed)
+    {
+      builder->capacity *= 2;
+    }
+    builder->data = realloc(builder->data, builder->capacity);
+  }
+  uint32_t length = serialize_row(row, builder->data + builder->size + RESULT_ROW_LENGTH_SIZE);
+  *(uint32_t *)(builder->data + builder->size) = length;
+  builder->size += RESULT_ROW_LENGTH_SIZE + length;
+}
+
+void result_cache_store(Pager *pager, const char *key, ResultBuilder *builder, uint32_t status)
+{
+  size_t charge = sizeof(CachedResult) + strlen(key) + 1 + builder->capacity;
+  if (builder->too_large || charge > cache.budget_bytes)
+  {
+    free(builder->data);
+    free(builder);
+    return;
+  }
+
+  uint64_t hash = result_cache_hash(pager, key);
+  CachedResult *existing = cache.num_buckets ? *result_cache_slot(pager, key, hash) : NULL;
+  if (existing != NULL)
+  {
+    result_cache_remove(existing);
+  }
+  CachedResult *entry = malloc(sizeof(CachedResult));
+  entry->pager = pager;
+  entry->version = pager->version;
+  entry->hash = hash;
+  entry->key = strdup(key);
+  entry->data = builder->data;
+  entry->size = builder->size;
+  entry->charge = charge;
+  entry->status = status;
+  free(builder);
+
+  result_cache_evict(cache.budget_bytes - entry->charge);
+  if (cache.num_entries >= cache.num_buckets)
+  {
+    result_cache_grow();
+  }
+  CachedResult **slot = &cache.buckets[hash & (cache.num_buckets - 1)];
+  entry->hash_next = *slot;
+  *slot = entry;
+  lru_push_front(entry);
+  cache.num_entries += 1;
+  cache.used_bytes += entry->charge;
+}
+
+void result_cache_drop_pager(Pager *pager)
+{
+  CachedResult *entry = cache.lru.lru_next;
+  while (entry != &cache.lru)
+  {
+    CachedResult *next = entry->lru_next;
+    if (entry->pager == pager)
+    {
+      result_cache_remove(entry);
+    }
+    entry = next;
+  }
+}
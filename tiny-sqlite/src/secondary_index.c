@@ -0,0 +1,232 @@
+#include "../include/secondary_index.h"
+#include "../include/text_tree.h"
+#include "../include/cursor.h"
+#include "../include/page_cache.h"
+
+#define INDEX_ID_SIZE   sizeof(uint64_t)
+#define INDEX_TEXT_SIZE sizeof(uint16_t)
+
+// 整行的列位图
+#define INDEX_ALL_COLUMNS ((1u << row_num_columns) - 1)
+
+// 主键 id 在 row_columns 中的下标
+#define INDEX_ID_COLUMN 0
+
+// 每个可被索引的文本列取最大长度时, key (列值 + '\0' + id) 都要放得进 TEXT_KEY_MAX_SIZE
+#define COLUMN_TEXT(type, suffix, name, size) \
+  _Static_assert((size) + 1 + INDEX_ID_SIZE <= TEXT_KEY_MAX_SIZE, "TEXT_KEY_MAX_SIZE too small for " #type "." #name);
+#define COLUMN_TAIL_TEXT(type, suffix, name, size) \
+  _Static_assert((size) + 1 + INDEX_ID_SIZE <= TEXT_KEY_MAX_SIZE, "TEXT_KEY_MAX_SIZE too small for " #type "." #name);
+#include "../include/schema.def"
+
+static const ColumnInfo *index_column(DbHeader *header)
+{
+  return &row_columns[header->index_column];
+}
+
+// key = 列值 + '\0' + 大端 id; prefix_only 时只编码 列值 + '\0' (查找的前缀)
+static uint32_t index_encode_key(const ColumnInfo *column, const char *value, uint64_t id, bool prefix_only, uint8_t *key)
+{
+  uint32_t size = strnlen(value, column->size);
+  memcpy(key, value, size);
+  key[size++] = '\0';
+  if (prefix_only)
+  {
+    return size;
+  }
+  for (int32_t shift = 56; shift >= 0; shift -= 8)
+  {
+    key[size++] = id >> shift;
+  }
+  return size;
+}
+
+static uint32_t index_encode_value(uint32_t include, Row *row, uint8_t *value)
+{
+  uint32_t size = 0;
+  for (uint32_t i = 0; i < row_num_columns; i++)
+  {
+    if (!(include & (1u << i)))
+    {
+      continue;
+    }
+    const ColumnInfo *column = &row_columns[i];
+    const char *field = (const char *)row + column->offset;
+    if (column->kind == COLUMN_KIND_U64)
+    {
+      memcpy(value + size, field, sizeof(uint64_t));
+      size += sizeof(uint64_t);
+      continue;
+    }
+    uint16_t length = strnlen(field, column->size);
+    memcpy(value + size, &length, INDEX_TEXT_SIZE);
+    memcpy(value + size + INDEX_TEXT_SIZE, field, length);
+    size += INDEX_TEXT_SIZE + length;
+  }
+  return size;
+}
+
+static void index_decode_value(uint32_t include, const uint8_t *value, Row *row)
+{
+  for (uint32_t i = 0; i < row_num_columns; i++)
+  {
+    if (!(include & (1u << i)))
+    {
+      continue;
+    }
+    const ColumnInfo *column = &row_columns[i];
+    char *field = (char *)row + column->offset;
+    if (column->kind == COLUMN_KIND_U64)
+    {
+      memcpy(field, value, sizeof(uint64_t));
+      value += sizeof(uint64_t);
+      continue;
+    }
+    uint16_t length;
+    memcpy(&length, value, INDEX_TEXT_SIZE);
+    memcpy(field, value + INDEX_TEXT_SIZE, length);
+    if (length < column->size)
+    {
+      field[length] = '\0'; // 取最大长度的列没有结尾 '\0'
+    }
+    value += INDEX_TEXT_SIZE + length;
+  }
+}
+
+bool secondary_index_enabled(Pager *pager)
+{
+  return pager_header(pager)->index_root_page != 0;
+}
+
+const ColumnInfo *secondary_index_column(Pager *pager)
+{
+  DbHeader *header = pager_header(pager);
+  return header->index_root_page ? index_column(header) : NULL;
+}
+
+bool secondary_index_covering(Pager *pager)
+{
+  DbHeader *header = pager_header(pager);
+  uint32_t columns = header->index_include | (1u << header->index_column) | (1u << INDEX_ID_COLUMN);
+  return columns == INDEX_ALL_COLUMNS;
+}
+
+bool secondary_index_create(Table *table, const ColumnInfo *column, uint32_t include)
+{
+  Pager *pager = table->pager;
+  if (table->key_type != KEY_TYPE_INTEGER || column->kind != COLUMN_KIND_TEXT)
+  {
+    ERROR("secondary index requires an integer primary key and a text column!");
+    return false;
+  }
+  if (secondary_index_enabled(pager))
+  {
+    secondary_index_drop(pager);
+  }
+
+  uint32_t root_page_num = get_unused_page_num(pager);
+  text_tree_init(pager, root_page_num);
+  DbHeader *header = pager_header_for_write(pager);
+  header->index_root_page = root_page_num;
+  header->index_column = column - row_columns;
+  header->index_include = include & ~(1u << header->index_column) & ~(1u << INDEX_ID_COLUMN);
+
+  // 逐行加入索引
+  Cursor *cursor = table_start(table);
+  Row row;
+  while (!cursor->end_of_table)
+  {
+    cursor_row(cursor, &row, ROW_SIZE);
+    secondary_index_insert(table, &row);
+    cursor_advance(cursor);
+    page_cache_unpin_all();
+  }
+  free(cursor);
+  return true;
+}
+
+void secondary_index_drop(Pager *pager)
+{
+  DbHeader *header = pager_header(pager);
+  text_tree_free(pager, header->index_root_page);
+  header = pager_header_for_write(pager);
+  header->index_root_page = 0;
+  header->index_column = 0;
+  header->index_include = 0;
+}
+
+void secondary_index_insert(Table *table, Row *row)
+{
+  DbHeader *header = pager_header(table->pager);
+  uint8_t key[TEXT_KEY_MAX_SIZE];
+  uint8_t value[TEXT_VALUE_MAX_SIZE];
+  const ColumnInfo *column = index_column(header);
+  uint32_t key_size = index_encode_key(column, (char *)row + column->offset, row->id, false, key);
+  uint32_t value_size = index_encode_value(header->index_include, row, value);
+  text_tree_insert(table->pager, header->index_root_page, key, key_size, value, value_size);
+}
+
+void secondary_index_delete(Table *table, Row *row)
+{
+  DbHeader *header = pager_header(table->pager);
+  uint8_t key[TEXT_KEY_MAX_SIZE];
+  const ColumnInfo *column = index_column(header);
+  uint32_t key_size = index_encode_key(column, (char *)row + column->offset, row->id, false, key);
+  text_tree_delete(table->pager, header->index_root_page, key, key_size);
+}
+
+uint32_t secondary_index_lookup(Table *table, const char *value, IndexRowSink sink, void *arg)
+{
+  Pager *pager = table->pager;
+  DbHeader *header = pager_header(pager);
+  const ColumnInfo *column = index_column(header);
+  bool covering = secondary_index_covering(pager);
+  uint32_t include = header->index_include;
+
+  uint8_t prefix[TEXT_KEY_MAX_SIZE];
+  uint32_t prefix_size = index_encode_key(column, value, 0, true, prefix);
+  TextCursor cursor;
+  text_tree_seek(pager, header->index_root_page, prefix, prefix_size, &cursor);
+
+  uint32_t num_rows = 0;
+  uint8_t key[TEXT_KEY_MAX_SIZE];
+  Row row;
+  while (!cursor.end_of_tree)
+  {
+    uint32_t key_size = text_cursor_key(&cursor, key);
+    if (key_size != prefix_size + INDEX_ID_SIZE || memcmp(key, prefix, prefix_size) != 0)
+    {
+      break;
+    }
+    uint64_t id = 0;
+    for (uint32_t i = 0; i < INDEX_ID_SIZE; i++)
+    {
+      id = (id << 8) | key[prefix_size + i];
+    }
+
+    if (covering)
+    {
+      // 整行都在索引中: 不访问主键树
+      uint32_t value_size;
+      memset(&row, 0, sizeof(Row));
+      row.id = id;
+      memcpy((char *)&row + column->offset, key, prefix_size - 1); // 不含 '\0', 列取最大长度时正好写满
+      index_decode_value(include, text_cursor_value(&cursor, &value_size), &row);
+    }
+    else
+    {
+      Cursor *row_cursor = table_lookup(table, id);
+      if (row_cursor == NULL)
+      {
+        ERROR("secondary index refers to a missing row!");
+        exit(EXIT_FAILURE);
+      }
+      cursor_row(row_cursor, &row, ROW_SIZE);
+      free(row_cursor);
+    }
+    sink(&row, arg);
+    num_rows += 1;
+    text_cursor_advance(&cursor);
+  }
+  return num_rows;
+}
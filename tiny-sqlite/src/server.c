@@ -0,0 +1,674 @@
+#define _GNU_SOURCE // accept4
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "../include/server.h"
+#include "../include/protocol.h"
+#include "../include/statement.h"
+#include "../include/page_cache.h"
+#include "../include/backup.h"
+
+// ? 对应的列, 主键 (delete / select where) 与 username 一样以文本存放
+typedef enum
+{
+  PARAM_FIELD_ID,
+  PARAM_FIELD_USERNAME,
+  PARAM_FIELD_EMAIL,
+} ParamField;
+
+typedef struct
+{
+  bool in_use;
+  Statement statement;
+  uint16_t num_params;
+  uint8_t param_fields[SERVER_MAX_PARAMS];
+} PreparedStatement;
+
+typedef struct Connection
+{
+  int fd;
+  uint32_t events; // 当前注册的 epoll 事件
+  ByteBuffer input;
+  ByteBuffer output;
+  size_t output_sent;
+  uint32_t rows; // 当前请求已返回的行数
+  PreparedStatement statements[SERVER_MAX_STATEMENTS];
+  struct Connection *prev;
+  struct Connection *next;
+} Connection;
+
+static volatile sig_atomic_t server_stopping = 0;
+
+// 进行中的在线备份: 事件循环每轮复制一步, 完成后回复发起的连接
+static Backup *server_backup = NULL;
+static Connection *backup_owner = NULL;
+
+static void server_on_signal(int signal_number)
+{
+  server_stopping = 1;
+}
+
+static int server_listen(const char *socket_path)
+{
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (strlen(socket_path) >= sizeof(address.sun_path))
+  {
+    ERROR("socket path too long!");
+    return -1;
+  }
+  strcpy(address.sun_path, socket_path);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd == -1)
+  {
+    ERROR("create socket failed!");
+    return -1;
+  }
+  unlink(socket_path);
+  if (bind(fd, (struct sockaddr *)&address, sizeof(address)) == -1 || listen(fd, SERVER_LISTEN_BACKLOG) == -1)
+  {
+    printf("error: listen on %s failed: %s\n", socket_path, strerror(errno));
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static void connection_close(int epoll_fd, Connection **connections, Connection *connection)
+{
+  epoll_ctl(epoll_fd, EPOLL_CTL_DEL, connection->fd, NULL);
+  close(connection->fd);
+  if (backup_owner == connection)
+  {
+    backup_owner = NULL; // 备份照常完成, 不再回复
+  }
+  if (connection->prev)
+  {
+    connection->prev->next = connection->next;
+  }
+  else
+  {
+    *connections = connection->next;
+  }
+  if (connection->next)
+  {
+    connection->next->prev = connection->prev;
+  }
+  buffer_free(&connection->input);
+  buffer_free(&connection->output);
+  free(connection);
+}
+
+static void server_accept(int epoll_fd, int listen_fd, Connection **connections)
+{
+  while (true)
+  {
+    int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd == -1)
+    {
+      return; // EAGAIN: 本轮没有更多连接
+    }
+    Connection *connection = calloc(1, sizeof(Connection));
+    connection->fd = fd;
+    connection->events = EPOLLIN;
+    connection->next = *connections;
+    if (*connections)
+    {
+      (*connections)->prev = connection;
+    }
+    *connections = connection;
+
+    struct epoll_event event = {.events = connection->events, .data.ptr = connection};
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+    DEBUGS("client connected, fd %d", fd);
+  }
+}
+
+static void send_error(Connection *connection, ProtocolError code, const char *message)
+{
+  size_t frame = frame_begin(&connection->output, FRAME_ERROR);
+  buffer_put_u8(&connection->output, code);
+  buffer_put(&connection->output, message, strlen(message));
+  frame_end(&connection->output, frame);
+}
+
+static void send_ok(Connection *connection)
+{
+  frame_end(&connection->output, frame_begin(&connection->output, FRAME_OK));
+}
+
+static void send_row(Row *row, void *arg)
+{
+  Connection *connection = arg;
+  size_t frame = frame_begin(&connection->output, FRAME_ROW);
+  buffer_put_u64(&connection->output, row->id);
+  buffer_put_text(&connection->output, row->username, strnlen(row->username, COLUMN_USERNAME_SIZE));
+  buffer_put_text(&connection->output, row->email, strnlen(row->email, COLUMN_EMAIL_SIZE));
+  frame_end(&connection->output, frame);
+  connection->rows += 1;
+}
+
+static void send_done(Connection *connection, ExecuteResult result, uint32_t succeeded)
+{
+  size_t frame = frame_begin(&connection->output, FRAME_DONE);
+  buffer_put_u8(&connection->output, result);
+  buffer_put_u32(&connection->output, succeeded);
+  buffer_put_u32(&connection->output, connection->rows);
+  frame_end(&connection->output, frame);
+}
+
+static bool is_blank(char c)
+{
+  return c == ' ' || c == '\t';
+}
+
+/*
+  解析一次模板: ? 必须单独成词, 先替换为 0 交给 prepare_statement 校验语法,
+  再按 ? 所在的词确定它对应的列
+*/
+static bool prepare_template(PreparedStatement *prepared, const char *sql, uint16_t size)
+{
+  if (size >= SERVER_MAX_SQL)
+  {
+    return false;
+  }
+  char text[SERVER_MAX_SQL];
+  uint32_t param_words[SERVER_MAX_PARAMS];
+  uint32_t words = 0;
+  prepared->num_params = 0;
+  for (uint16_t i = 0; i < size; i++)
+  {
+    char c = sql[i];
+    bool word_start = !is_blank(c) && (i == 0 || is_blank(sql[i - 1]));
+    if (word_start)
+    {
+      words += 1;
+    }
+    if (c == '?')
+    {
+      bool alone = word_start && (i + 1 == size || is_blank(sql[i + 1]));
+      if (!alone || prepared->num_params == SERVER_MAX_PARAMS)
+      {
+        return false;
+      }
+      param_words[prepared->num_params++] = words - 1;
+      c = '0';
+    }
+    text[i] = c;
+  }
+  text[size] = '\0';
+
+  Statement *statement = &prepared->statement;
+  // 聚合结果不是行, 协议中没有对应的帧, 暂不支持
+  if (prepare_statement(text, statement) != PREPARE_SUCCESS || statement->type == STATEMENT_AGGREGATE)
+  {
+    return false;
+  }
+  for (uint16_t i = 0; i < prepared->num_params; i++)
+  {
+    uint32_t word = param_words[i];
+    switch (statement->type)
+    {
+    case STATEMENT_INSERT: // insert id username email
+      if (word < 1 || word > 3)
+      {
+        return false;
+      }
+      prepared->param_fields[i] = PARAM_FIELD_ID + word - 1;
+      break;
+    case STATEMENT_DELETE: // delete key
+      if (word != 1)
+      {
+        return false;
+      }
+      prepared->param_fields[i] = PARAM_FIELD_USERNAME;
+      break;
+    case STATEMENT_SELECT_KEY: // select where column = key
+      if (word != 4)
+      {
+        return false;
+      }
+      prepared->param_fields[i] = PARAM_FIELD_USERNAME;
+      break;
+    case STATEMENT_SELECT:
+    case STATEMENT_AGGREGATE:
+      return false;
+    }
+  }
+  return true;
+}
+
+// 将一个参数直接写入语句中的行, 整数与文本按列类型互相转换
+static bool bind_param(PreparedStatement *prepared, uint16_t index, FrameReader *reader)
+{
+  Row *row = &prepared->statement.row_to_insert;
+  ParamField field = prepared->param_fields[index];
+  char number[24];
+  const char *text;
+  uint16_t size;
+
+  uint8_t kind = reader_u8(reader);
+  if (kind == PARAM_INT)
+  {
+    uint64_t value = reader_u64(reader);
+    if (field == PARAM_FIELD_ID)
+    {
+      row->id = value;
+      return !reader->overrun;
+    }
+    size = snprintf(number, sizeof(number), "%lu", value);
+    text = number;
+  }
+  else if (kind == PARAM_TEXT)
+  {
+    text = reader_text(reader, &size);
+  }
+  else
+  {
+    return false;
+  }
+  if (reader->overrun || memchr(text, '\0', size) != NULL)
+  {
+    return false;
+  }
+
+  if (field == PARAM_FIELD_ID)
+  {
+    if (size == 0 || size >= sizeof(number))
+    {
+      return false;
+    }
+    memcpy(number, text, size);
+    number[size] = '\0';
+    char *end;
+    row->id = strtoull(number, &end, 10);
+    return *end == '\0';
+  }
+  char *destination = (field == PARAM_FIELD_EMAIL) ? row->email : row->username;
+  size_t capacity = (field == PARAM_FIELD_EMAIL) ? COLUMN_EMAIL_SIZE : COLUMN_USERNAME_SIZE;
+  if (size >= capacity)
+  {
+    return false;
+  }
+  memcpy(destination, text, size);
+  destination[size] = '\0';
+  return true;
+}
+
+static bool bind_params(PreparedStatement *prepared, FrameReader *reader)
+{
+  for (uint16_t i = 0; i < prepared->num_params; i++)
+  {
+    if (!bind_param(prepared, i, reader))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void execute_prepared(Connection *connection, Table *table, PreparedStatement *prepared,
+                             uint32_t *succeeded, ExecuteResult *result)
+{
+  Statement *statement = &prepared->statement;
+  statement->row_sink = send_row;
+  statement->sink_arg = connection;
+
+  page_cache_unpin_all();
+  uint64_t start_us = stats_now_us();
+  ExecuteResult execute_result = execute_statement(statement, table);
+  stats_record_latency(statement_stats_type(statement->type), stats_now_us() - start_us);
+
+  if (execute_result == EXECUTE_SUCCESS)
+  {
+    *succeeded += 1;
+  }
+  else
+  {
+    *result = execute_result;
+  }
+}
+
+static PreparedStatement *find_statement(Connection *connection, uint32_t stmt_id)
+{
+  if (stmt_id == 0 || stmt_id > SERVER_MAX_STATEMENTS || !connection->statements[stmt_id - 1].in_use)
+  {
+    return NULL;
+  }
+  return &connection->statements[stmt_id - 1];
+}
+
+static void handle_frame(Connection *connection, Table *table, FrameReader *reader)
+{
+  uint8_t type = reader_u8(reader);
+  if (type == FRAME_PREPARE)
+  {
+    uint32_t stmt_id = 0;
+    for (uint32_t i = 0; i < SERVER_MAX_STATEMENTS && stmt_id == 0; i++)
+    {
+      if (!connection->statements[i].in_use)
+      {
+        stmt_id = i + 1;
+      }
+    }
+    if (stmt_id == 0)
+    {
+      send_error(connection, PROTOCOL_ERROR_TOO_MANY_STMTS, "too many prepared statements");
+      return;
+    }
+    PreparedStatement *prepared = &connection->statements[stmt_id - 1];
+    if (!prepare_template(prepared, (const char *)reader->position, reader->remaining))
+    {
+      send_error(connection, PROTOCOL_ERROR_SYNTAX, "syntax error");
+      return;
+    }
+    prepared->in_use = true;
+    size_t frame = frame_begin(&connection->output, FRAME_PREPARED);
+    buffer_put_u32(&connection->output, stmt_id);
+    buffer_put_u16(&connection->output, prepared->num_params);
+    frame_end(&connection->output, frame);
+    return;
+  }
+
+  if (type == FRAME_BACKUP)
+  {
+    char path[PATH_MAX];
+    if (server_backup != NULL || reader->remaining == 0 || reader->remaining >= sizeof(path))
+    {
+      send_error(connection, PROTOCOL_ERROR_BACKUP, "backup in progress or bad path");
+      return;
+    }
+    memcpy(path, reader->position, reader->remaining);
+    path[reader->remaining] = '\0';
+    server_backup = backup_start(table, path);
+    if (server_backup == NULL)
+    {
+      send_error(connection, PROTOCOL_ERROR_BACKUP, "backup failed");
+      return;
+    }
+    backup_owner = connection;
+    return;
+  }
+
+  if (type < FRAME_BIND || type > FRAME_FINALIZE)
+  {
+    send_error(connection, PROTOCOL_ERROR_MALFORMED, "unknown message type");
+    return;
+  }
+  PreparedStatement *prepared = find_statement(connection, reader_u32(reader));
+  if (prepared == NULL)
+  {
+    send_error(connection, PROTOCOL_ERROR_UNKNOWN_STMT, "unknown statement");
+    return;
+  }
+
+  uint32_t succeeded = 0;
+  ExecuteResult result = EXECUTE_SUCCESS;
+  connection->rows = 0;
+  switch (type)
+  {
+  case FRAME_BIND:
+  {
+    uint16_t index = reader_u16(reader);
+    if (index >= prepared->num_params || !bind_param(prepared, index, reader))
+    {
+      send_error(connection, PROTOCOL_ERROR_BAD_PARAM, "bad parameter");
+      return;
+    }
+    send_ok(connection);
+    return;
+  }
+  case FRAME_STEP:
+    execute_prepared(connection, table, prepared, &succeeded, &result);
+    send_done(connection, result, succeeded);
+    return;
+  case FRAME_BATCH:
+  {
+    // 逐组绑定并执行, 格式错误的组及其后的组不执行
+    uint32_t count = reader_u32(reader);
+    for (uint32_t i = 0; i < count; i++)
+    {
+      if (!bind_params(prepared, reader))
+      {
+        send_error(connection, PROTOCOL_ERROR_BAD_PARAM, "bad parameter");
+        return;
+      }
+      execute_prepared(connection, table, prepared, &succeeded, &result);
+    }
+    if (reader->overrun)
+    {
+      send_error(connection, PROTOCOL_ERROR_MALFORMED, "truncated batch");
+      return;
+    }
+    send_done(connection, result, succeeded);
+    return;
+  }
+  case FRAME_FINALIZE:
+    prepared->in_use = false;
+    send_ok(connection);
+    return;
+  }
+}
+
+static size_t connection_pending(Connection *connection)
+{
+  return connection->output.length - connection->output_sent;
+}
+
+// 处理缓冲区中所有完整的帧; 帧长度超过上限时返回 false, 断开连接
+static bool connection_process(Connection *connection, Table *table)
+{
+  size_t offset = 0;
+  while (connection_pending(connection) < SERVER_OUTPUT_HIGH_WATER)
+  {
+    uint8_t *data = connection->input.data + offset;
+    size_t size = connection->input.length - offset;
+    if (size >= PROTOCOL_LENGTH_SIZE)
+    {
+      uint32_t length;
+      memcpy(&length, data, sizeof(length));
+      if (length > PROTOCOL_MAX_FRAME_SIZE)
+      {
+        return false;
+      }
+    }
+    size_t frame_size = frame_complete(data, size);
+    if (frame_size == 0)
+    {
+      break;
+    }
+    FrameReader reader;
+    reader_init(&reader, data + PROTOCOL_LENGTH_SIZE, frame_size - PROTOCOL_LENGTH_SIZE);
+    handle_frame(connection, table, &reader);
+    offset += frame_size;
+  }
+  if (offset > 0)
+  {
+    buffer_consume(&connection->input, offset);
+  }
+  return true;
+}
+
+// 读取一次; 对端关闭或出错时返回 false
+static bool connection_read(Connection *connection)
+{
+  buffer_reserve(&connection->input, SERVER_READ_SIZE);
+  while (true)
+  {
+    ssize_t bytes_read = read(connection->fd, connection->input.data + connection->input.length, SERVER_READ_SIZE);
+    if (bytes_read > 0)
+    {
+      connection->input.length += bytes_read;
+      return true;
+    }
+    if (bytes_read == -1 && errno == EINTR)
+    {
+      continue;
+    }
+    return bytes_read == -1 && errno == EAGAIN;
+  }
+}
+
+static bool connection_flush(Connection *connection)
+{
+  while (connection_pending(connection) > 0)
+  {
+    ssize_t bytes_written = send(connection->fd, connection->output.data + connection->output_sent,
+                                 connection_pending(connection), MSG_NOSIGNAL);
+    if (bytes_written == -1)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      if (errno == EAGAIN)
+      {
+        break;
+      }
+      return false;
+    }
+    connection->output_sent += bytes_written;
+  }
+  if (connection->output_sent == connection->output.length || connection->output_sent >= SERVER_OUTPUT_HIGH_WATER)
+  {
+    buffer_consume(&connection->output, connection->output_sent);
+    connection->output_sent = 0;
+  }
+  return true;
+}
+
+// 发送积压时只等待可写, 不再读取新请求
+static void connection_update_events(int epoll_fd, Connection *connection)
+{
+  uint32_t events = 0;
+  if (connection_pending(connection) < SERVER_OUTPUT_HIGH_WATER)
+  {
+    events |= EPOLLIN;
+  }
+  if (connection_pending(connection) > 0)
+  {
+    events |= EPOLLOUT;
+  }
+  if (events != connection->events)
+  {
+    struct epoll_event event = {.events = events, .data.ptr = connection};
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, connection->fd, &event);
+    connection->events = events;
+  }
+}
+
+static void server_step_backup(int epoll_fd)
+{
+  BackupResult result = backup_step(server_backup, BACKUP_STEP_PAGES);
+  if (result == BACKUP_MORE)
+  {
+    return;
+  }
+  backup_finish(server_backup);
+  server_backup = NULL;
+  if (backup_owner != NULL)
+  {
+    if (result == BACKUP_DONE)
+    {
+      send_ok(backup_owner);
+    }
+    else
+    {
+      send_error(backup_owner, PROTOCOL_ERROR_BACKUP, "backup failed");
+    }
+    connection_flush(backup_owner);
+    connection_update_events(epoll_fd, backup_owner);
+    backup_owner = NULL;
+  }
+}
+
+bool server_run(Table *table, const char *socket_path)
+{
+  int listen_fd = server_listen(socket_path);
+  if (listen_fd == -1)
+  {
+    return false;
+  }
+  int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  struct epoll_event listen_event = {.events = EPOLLIN, .data.ptr = NULL};
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &listen_event);
+
+  // 不设置 SA_RESTART, 让 epoll_wait 被信号打断后检查退出标志
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = server_on_signal;
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+
+  printf("listening on %s\n", socket_path);
+  fflush(stdout);
+
+  Connection *connections = NULL;
+  struct epoll_event events[SERVER_MAX_EVENTS];
+  while (!server_stopping)
+  {
+    // 备份进行中时不阻塞等待, 两轮事件之间复制一步
+    int num_events = epoll_wait(epoll_fd, events, SERVER_MAX_EVENTS, server_backup ? 0 : -1);
+    for (int i = 0; i < num_events; i++)
+    {
+      Connection *connection = events[i].data.ptr;
+      if (connection == NULL)
+      {
+        server_accept(epoll_fd, listen_fd, &connections);
+        continue;
+      }
+
+      bool alive = !(events[i].events & EPOLLERR);
+      bool peer_closed = false;
+      if (alive && (events[i].events & (EPOLLIN | EPOLLHUP)))
+      {
+        peer_closed = !connection_read(connection);
+      }
+      // 积压在本轮发送完后继续处理已缓冲的请求, 否则客户端等待响应而不再发送时会停住
+      while (alive)
+      {
+        // 影子分页模式下响应在提交之后才发出, 客户端收到确认时修改已落盘
+        alive = connection_process(connection, table);
+        pager_commit(table->pager);
+        alive = alive && connection_flush(connection);
+        if (connection_pending(connection) >= SERVER_OUTPUT_HIGH_WATER ||
+            frame_complete(connection->input.data, connection->input.length) == 0)
+        {
+          break;
+        }
+      }
+      if (!alive || peer_closed)
+      {
+        DEBUGS("client disconnected, fd %d", connection->fd);
+        connection_close(epoll_fd, &connections, connection);
+        continue;
+      }
+      connection_update_events(epoll_fd, connection);
+    }
+
+    if (server_backup != NULL)
+    {
+      server_step_backup(epoll_fd);
+    }
+  }
+
+  if (server_backup != NULL)
+  {
+    backup_finish(server_backup);
+    server_backup = NULL;
+  }
+  while (connections)
+  {
+    connection_close(epoll_fd, &connections, connections);
+  }
+  close(epoll_fd);
+  close(listen_fd);
+  unlink(socket_path);
+  return true;
+}
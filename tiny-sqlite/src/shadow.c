@@ -0,0 +1,461 @@
+#include "../include/shadow.h"
+#include "../include/stats.h"
+#include "../include/io.h"
+
+typedef struct
+{
+  uint32_t physical;  // 本事务中的位置
+  uint32_t committed; // 已提交状态中的位置
+  uint32_t checksum;  // physical 处内容的校验和
+  uint64_t hash;      // physical 处内容的完整哈希, 读入或写出后有效, 用于跳过内容未变的页
+} ShadowPage;
+
+struct Shadow
+{
+  int fd;
+  ShadowHeader header; // 当前已提交状态
+  uint32_t slot;       // header 所在槽, 下次提交写另一个槽
+  ShadowPage *pages;
+  uint32_t capacity;
+  uint32_t *written; // 本事务中写到新位置的逻辑页
+  uint32_t num_written;
+  uint32_t written_capacity;
+  bool map_dirty[SHADOW_MAX_MAP_PAGES];
+  bool changed;
+  uint8_t *used; // 物理页位图: 被已提交状态或本事务引用
+  uint32_t used_capacity;
+  uint32_t num_physical;
+  uint32_t free_hint; // 此前的物理页都已被占用
+};
+
+static uint64_t shadow_hash(const void *data, uint32_t size)
+{
+  const uint8_t *bytes = data;
+  uint64_t hash = 0x9E3779B97F4A7C15ULL ^ size;
+  while (size > 0)
+  {
+    uint64_t word = 0;
+    uint32_t chunk = size < sizeof(word) ? size : sizeof(word);
+    memcpy(&word, bytes, chunk);
+    hash = (hash ^ word) * 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 32;
+    bytes += chunk;
+    size -= chunk;
+  }
+  hash *= 0xC4CEB9FE1A85EC53ULL;
+  return hash ^ (hash >> 29);
+}
+
+static uint32_t shadow_checksum(uint64_t hash)
+{
+  return (uint32_t)(hash ^ (hash >> 32));
+}
+
+static uint32_t header_checksum(const ShadowHeader *header)
+{
+  return shadow_checksum(shadow_hash(header, offsetof(ShadowHeader, checksum)));
+}
+
+static bool header_valid(const ShadowHeader *header)
+{
+  return strncmp(header->magic, SHADOW_MAGIC, sizeof(header->magic)) == 0 &&
+         header->num_map_pages <= SHADOW_MAX_MAP_PAGES &&
+         header->num_pages <= header->num_map_pages * SHADOW_MAP_ENTRIES &&
+         header->checksum == header_checksum(header);
+}
+
+static bool used_test(Shadow *shadow, uint32_t page)
+{
+  return page < shadow->used_capacity && (shadow->used[page / 8] & (1u << (page % 8)));
+}
+
+static void used_set(Shadow *shadow, uint32_t page)
+{
+  if (page >= shadow->used_capacity)
+  {
+    uint32_t capacity = shadow->used_capacity ? shadow->used_capacity : 1024;
+    while (capacity <= page)
+    {
+      capacity *= 2;
+    }
+    shadow->used = realloc(shadow->used, capacity / 8);
+    memset(shadow->used + shadow->used_capacity / 8, 0, (capacity - shadow->used_capacity) / 8);
+    shadow->used_capacity = capacity;
+  }
+  shadow->used[page / 8] |= 1u << (page % 8);
+  if (page >= shadow->num_physical)
+  {
+    shadow->num_physical = page + 1;
+  }
+}
+
+static void shadow_release(Shadow *shadow, uint32_t page)
+{
+  shadow->used[page / 8] &= ~(1u << (page % 8));
+  if (page < shadow->free_hint)
+  {
+    shadow->free_hint = page;
+  }
+}
+
+// 优先复用空闲的物理页, 没有则追加到文件末尾
+static uint32_t shadow_allocate(Shadow *shadow)
+{
+  uint32_t page = shadow->free_hint;
+  while (page < shadow->num_physical && used_test(shadow, page))
+  {
+    page += 1;
+  }
+  used_set(shadow, page);
+  shadow->free_hint = page + 1;
+  return page;
+}
+
+static void shadow_reserve(Shadow *shadow, uint32_t num_pages)
+{
+  if (num_pages <= shadow->capacity)
+  {
+    return;
+  }
+  uint32_t capacity = shadow->capacity ? shadow->capacity : 1024;
+  while (capacity < num_pages)
+  {
+    capacity *= 2;
+  }
+  shadow->pages = realloc(shadow->pages, sizeof(ShadowPage) * capacity);
+  memset(shadow->pages + shadow->capacity, 0, sizeof(ShadowPage) * (capacity - shadow->capacity));
+  shadow->capacity = capacity;
+}
+
+static bool read_physical(Shadow *shadow, uint32_t page, void *buffer)
+{
+  return io_pread(shadow->fd, buffer, PAGE_SIZE, (off_t)page * PAGE_SIZE) == PAGE_SIZE;
+}
+
+static void write_physical(Shadow *shadow, uint32_t page, const void *buffer)
+{
+  if (io_pwrite(shadow->fd, buffer, PAGE_SIZE, (off_t)page * PAGE_SIZE) != PAGE_SIZE)
+  {
+    ERROR("shadow: write error!");
+    exit(EXIT_FAILURE);
+  }
+}
+
+// 读出提交头引用的映射表, 映射表页校验失败时返回 NULL
+static ShadowMapEntry *shadow_load_map(Shadow *shadow, const ShadowHeader *header)
+{
+  ShadowMapEntry *entries = malloc(PAGE_SIZE * (header->num_map_pages ? header->num_map_pages : 1));
+  for (uint32_t i = 0; i < header->num_map_pages; i++)
+  {
+    void *page = (uint8_t *)entries + (size_t)i * PAGE_SIZE;
+    if (!read_physical(shadow, header->map_pages[i], page) ||
+        shadow_checksum(shadow_hash(page, PAGE_SIZE)) != header->map_checksums[i])
+    {
+      free(entries);
+      return NULL;
+    }
+  }
+  return entries;
+}
+
+// 校验该次提交写入的页: 与上一次提交 previous 位置不同的页
+static bool shadow_verify(Shadow *shadow, const ShadowHeader *header, ShadowMapEntry *entries,
+                          const ShadowHeader *previous, ShadowMapEntry *previous_entries)
+{
+  uint8_t page[PAGE_SIZE_MAX];
+  for (uint32_t i = 0; i < header->num_pages; i++)
+  {
+    ShadowMapEntry *entry = &entries[i];
+    if (entry->physical == 0 ||
+        (i < previous->num_pages && previous_entries[i].physical == entry->physical))
+    {
+      continue;
+    }
+    if (!read_physical(shadow, entry->physical, page) ||
+        shadow_checksum(shadow_hash(page, PAGE_SIZE)) != entry->checksum)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void shadow_use_header(Shadow *shadow, const ShadowHeader *header, ShadowMapEntry *entries, uint32_t slot)
+{
+  shadow->header = *header;
+  shadow->slot = slot;
+  shadow_reserve(shadow, header->num_pages);
+  for (uint32_t i = 0; i < header->num_map_pages; i++)
+  {
+    used_set(shadow, header->map_pages[i]);
+  }
+  for (uint32_t i = 0; i < header->num_pages; i++)
+  {
+    ShadowPage *page = &shadow->pages[i];
+    page->physical = page->committed = entries[i].physical;
+    page->checksum = entries[i].checksum;
+    if (page->physical != 0)
+    {
+      used_set(shadow, page->physical);
+    }
+  }
+}
+
+uint32_t shadow_file_page_size(const void *first)
+{
+  ShadowHeader slots[2];
+  memcpy(&slots[0], first, sizeof(ShadowHeader));
+  memcpy(&slots[1], (const uint8_t *)first + SHADOW_SLOT_SIZE, sizeof(ShadowHeader));
+  for (uint32_t slot = 0; slot < 2; slot++)
+  {
+    if (header_valid(&slots[slot]))
+    {
+      return slots[slot].page_size;
+    }
+  }
+  return 0;
+}
+
+/*
+  新文件: 先写入空库的提交 (计数 0) 并落盘, 之后写入的页总有一个有效的提交头可以退回,
+  打开时也能据此识别影子分页格式 (否则在首次提交前崩溃会留下无法识别的文件)
+*/
+static void shadow_create(Shadow *shadow)
+{
+  memset(&shadow->header, 0, sizeof(ShadowHeader));
+  strncpy(shadow->header.magic, SHADOW_MAGIC, sizeof(shadow->header.magic));
+  shadow->header.page_size = PAGE_SIZE;
+  shadow->header.checksum = header_checksum(&shadow->header);
+  shadow->slot = 0;
+
+  uint8_t page[PAGE_SIZE_MAX];
+  memset(page, 0, PAGE_SIZE);
+  memcpy(page, &shadow->header, sizeof(ShadowHeader));
+  if (io_pwrite(shadow->fd, page, PAGE_SIZE, 0) != PAGE_SIZE || io_fdatasync(shadow->fd) == -1)
+  {
+    ERROR("shadow: unable to initialize db file!");
+    exit(EXIT_FAILURE);
+  }
+}
+
+Shadow *shadow_open(int fd, off_t file_len, bool create)
+{
+  uint8_t first[2 * SHADOW_SLOT_SIZE];
+  ShadowHeader slots[2];
+  memset(slots, 0, sizeof(slots));
+  if (file_len == 0)
+  {
+    if (!create)
+    {
+      return NULL;
+    }
+  }
+  else
+  {
+    if (io_pread(fd, first, sizeof(first), 0) != sizeof(first))
+    {
+      return NULL;
+    }
+    memcpy(&slots[0], first, sizeof(ShadowHeader));
+    memcpy(&slots[1], first + SHADOW_SLOT_SIZE, sizeof(ShadowHeader));
+    if (strncmp(slots[0].magic, SHADOW_MAGIC, sizeof(slots[0].magic)) != 0 &&
+        strncmp(slots[1].magic, SHADOW_MAGIC, sizeof(slots[1].magic)) != 0)
+    {
+      return NULL;
+    }
+  }
+
+  Shadow *shadow = calloc(1, sizeof(Shadow));
+  shadow->fd = fd;
+  used_set(shadow, 0);
+  shadow->num_physical = file_len / PAGE_SIZE > 1 ? file_len / PAGE_SIZE : 1;
+
+  // 从计数较大的有效槽开始尝试
+  bool valid[2] = {header_valid(&slots[0]), header_valid(&slots[1])};
+  uint32_t newest = (valid[1] && (!valid[0] || slots[1].commit > slots[0].commit)) ? 1 : 0;
+  for (uint32_t attempt = 0; attempt < 2; attempt++)
+  {
+    uint32_t slot = attempt == 0 ? newest : 1 - newest;
+    if (!valid[slot])
+    {
+      continue;
+    }
+    ShadowMapEntry *entries = shadow_load_map(shadow, &slots[slot]);
+    if (entries == NULL)
+    {
+      continue;
+    }
+    // 另一槽无效或其映射表已被复用时, 说明之后的提交已经开始, 本槽的提交早已落盘
+    ShadowMapEntry *previous_entries = valid[1 - slot] ? shadow_load_map(shadow, &slots[1 - slot]) : NULL;
+    bool ok = true;
+    if (previous_entries != NULL)
+    {
+      ok = shadow_verify(shadow, &slots[slot], entries, &slots[1 - slot], previous_entries);
+    }
+    free(previous_entries);
+    if (ok)
+    {
+      shadow_use_header(shadow, &slots[slot], entries, slot);
+      free(entries);
+      DEBUGS("shadow: opened commit %lu from slot %u", slots[slot].commit, slot);
+      return shadow;
+    }
+    free(entries);
+    DEBUGS("shadow: commit %lu in slot %u is incomplete", slots[slot].commit, slot);
+  }
+
+  // 其他页都在初始提交头落盘之后才写入: 超过一页却没有可用的提交说明文件已损坏
+  if (file_len > PAGE_SIZE)
+  {
+    printf("error: shadow: no intact commit found, db file corrupted!\n");
+    exit(EXIT_FAILURE);
+  }
+  shadow_create(shadow);
+  return shadow;
+}
+
+void shadow_close(Shadow *shadow)
+{
+  free(shadow->pages);
+  free(shadow->written);
+  free(shadow->used);
+  free(shadow);
+}
+
+uint32_t shadow_num_pages(Shadow *shadow)
+{
+  return shadow->header.num_pages;
+}
+
+bool shadow_read_page(Shadow *shadow, uint32_t page_num, void *page)
+{
+  if (page_num >= shadow->capacity || shadow->pages[page_num].physical == 0)
+  {
+    return false;
+  }
+  ShadowPage *entry = &shadow->pages[page_num];
+  if (!read_physical(shadow, entry->physical, page))
+  {
+    ERROR("shadow: read error!");
+    exit(EXIT_FAILURE);
+  }
+  uint64_t hash = shadow_hash(page, PAGE_SIZE);
+  if (shadow_checksum(hash) != entry->checksum)
+  {
+    printf("error: shadow: checksum mismatch on page %u!\n", page_num);
+    exit(EXIT_FAILURE);
+  }
+  entry->hash = hash;
+  return true;
+}
+
+void shadow_write_page(Shadow *shadow, uint32_t page_num, void *page)
+{
+  if (page_num / SHADOW_MAP_ENTRIES >= SHADOW_MAX_MAP_PAGES)
+  {
+    ERROR("shadow: database too large for shadow commit mode!");
+    exit(EXIT_FAILURE);
+  }
+  shadow_reserve(shadow, page_num + 1);
+  ShadowPage *entry = &shadow->pages[page_num];
+  uint64_t hash = shadow_hash(page, PAGE_SIZE);
+  if (entry->physical != 0 && entry->hash == hash)
+  {
+    return; // 访问过但内容未变
+  }
+  if (entry->physical == entry->committed)
+  {
+    // 已提交的版本不能覆盖
+    entry->physical = shadow_allocate(shadow);
+    if (shadow->num_written == shadow->written_capacity)
+    {
+      shadow->written_capacity = shadow->written_capacity ? shadow->written_capacity * 2 : 64;
+      shadow->written = realloc(shadow->written, sizeof(uint32_t) * shadow->written_capacity);
+    }
+    shadow->written[shadow->num_written++] = page_num;
+  }
+  write_physical(shadow, entry->physical, page);
+  entry->hash = hash;
+  entry->checksum = shadow_checksum(hash);
+  shadow->map_dirty[page_num / SHADOW_MAP_ENTRIES] = true;
+  shadow->changed = true;
+  STATS_INC(pager, page_writes);
+  STATS_ADD(pager, bytes_flushed, PAGE_SIZE);
+}
+
+void shadow_commit(Shadow *shadow, uint32_t num_pages)
+{
+  if (!shadow->changed && num_pages == shadow->header.num_pages)
+  {
+    return;
+  }
+  ShadowHeader header = shadow->header;
+  uint32_t num_map_pages = (num_pages + SHADOW_MAP_ENTRIES - 1) / SHADOW_MAP_ENTRIES;
+  if (num_map_pages > SHADOW_MAX_MAP_PAGES)
+  {
+    ERROR("shadow: database too large for shadow commit mode!");
+    exit(EXIT_FAILURE);
+  }
+  shadow_reserve(shadow, num_pages);
+
+  // 写出有变化的映射表页 (新增的页一定有变化)
+  uint8_t buffer[PAGE_SIZE_MAX];
+  for (uint32_t i = 0; i < num_map_pages; i++)
+  {
+    if (i < header.num_map_pages && !shadow->map_dirty[i])
+    {
+      continue;
+    }
+    memset(buffer, 0, PAGE_SIZE);
+    ShadowMapEntry *entries = (ShadowMapEntry *)buffer;
+    for (uint32_t j = 0; j < SHADOW_MAP_ENTRIES && i * SHADOW_MAP_ENTRIES + j < num_pages; j++)
+    {
+      ShadowPage *page = &shadow->pages[i * SHADOW_MAP_ENTRIES + j];
+      entries[j].physical = page->physical;
+      entries[j].checksum = page->checksum;
+    }
+    header.map_pages[i] = shadow_allocate(shadow);
+    header.map_checksums[i] = shadow_checksum(shadow_hash(buffer, PAGE_SIZE));
+    write_physical(shadow, header.map_pages[i], buffer);
+    STATS_INC(pager, page_writes);
+    STATS_ADD(pager, bytes_flushed, PAGE_SIZE);
+  }
+  header.num_map_pages = num_map_pages;
+  header.num_pages = num_pages;
+  header.commit += 1;
+  header.checksum = header_checksum(&header);
+
+  // 唯一的刷盘点: 提交头与本事务的页一起落盘, 打开时按校验和判断提交是否完整
+  uint32_t slot = 1 - shadow->slot;
+  if (io_pwrite(shadow->fd, &header, sizeof(header), (off_t)slot * SHADOW_SLOT_SIZE) != sizeof(header) ||
+      io_fdatasync(shadow->fd) == -1)
+  {
+    ERROR("shadow: commit failed!");
+    exit(EXIT_FAILURE);
+  }
+
+  // 新状态已落盘, 旧版本占用的物理页可以复用
+  for (uint32_t i = 0; i < shadow->num_written; i++)
+  {
+    ShadowPage *page = &shadow->pages[shadow->written[i]];
+    if (page->committed != 0)
+    {
+      shadow_release(shadow, page->committed);
+    }
+    page->committed = page->physical;
+  }
+  for (uint32_t i = 0; i < shadow->header.num_map_pages; i++)
+  {
+    if (header.map_pages[i] != shadow->header.map_pages[i])
+    {
+      shadow_release(shadow, shadow->header.map_pages[i]);
+    }
+  }
+  shadow->header = header;
+  shadow->slot = slot;
+  shadow->num_written = 0;
+  shadow->changed = false;
+  memset(shadow->map_dirty, 0, sizeof(shadow->map_dirty));
+  STATS_INC(pager, commits);
+  DEBUGS("shadow: commit %lu, %u pages", header.commit, num_pages);
+}
@@ -0,0 +1,358 @@
+#define _GNU_SOURCE // qsort_r
+#include "../include/sorter.h"
+
+static size_t sort_budget = SORT_DEFAULT_MEMORY;
+
+// 顺串文件的顺序读取器, 当前行参与归并
+typedef struct
+{
+  FILE *file;
+  off_t offset;
+  uint8_t *buffer;
+  uint32_t buffer_size;
+  uint32_t length;
+  uint32_t position;
+  Row row;
+} RunReader;
+
+struct Sorter
+{
+  RecordCompare compare;
+  uint32_t limit;
+  bool top_n;
+  Row *rows;
+  Row **order; // 指向 rows, 排序和建堆只移动指针
+  uint32_t capacity;
+  uint32_t count;
+  FILE **runs;
+  uint32_t num_runs;
+  uint32_t runs_capacity;
+};
+
+// 堆顶为 compare 最大的元素
+typedef int (*HeapCompare)(const void *a, const void *b, void *context);
+
+static void heap_sift_down(void **items, uint32_t count, uint32_t index, HeapCompare compare, void *context)
+{
+  while (true)
+  {
+    uint32_t top = index;
+    uint32_t left = 2 * index + 1;
+    uint32_t right = left + 1;
+    if (left < count && compare(items[left], items[top], context) > 0)
+    {
+      top = left;
+    }
+    if (right < count && compare(items[right], items[top], context) > 0)
+    {
+      top = right;
+    }
+    if (top == index)
+    {
+      return;
+    }
+    void *item = items[index];
+    items[index] = items[top];
+    items[top] = item;
+    index = top;
+  }
+}
+
+static void heap_sift_up(void **items, uint32_t index, HeapCompare compare, void *context)
+{
+  while (index > 0)
+  {
+    uint32_t parent = (index - 1) / 2;
+    if (compare(items[index], items[parent], context) <= 0)
+    {
+      return;
+    }
+    void *item = items[index];
+    items[index] = items[parent];
+    items[parent] = item;
+    index = parent;
+  }
+}
+
+void sorter_set_budget(size_t bytes)
+{
+  sort_budget = bytes < SORT_MIN_MEMORY ? SORT_MIN_MEMORY : bytes;
+}
+
+size_t sorter_budget()
+{
+  return sort_budget;
+}
+
+static int sorter_compare(Sorter *sorter, const Row *a, const Row *b)
+{
+  int result = sorter->compare(a, b);
+  if (result == 0)
+  {
+    result = compare_row_id(a, b);
+  }
+  if (result == 0)
+  {
+    result = compare_row_username(a, b);
+  }
+  return result;
+}
+
+// qsort_r: 元素为 Row*
+static int sorter_compare_order(const void *a, const void *b, void *sorter)
+{
+  return sorter_compare(sorter, *(Row *const *)a, *(Row *const *)b);
+}
+
+// top-N 大顶堆: 堆顶是当前保留的最大行
+static int sorter_compare_rows(const void *a, const void *b, void *sorter)
+{
+  return sorter_compare(sorter, a, b);
+}
+
+// 归并小顶堆: 堆顶是当前行最小的顺串
+static int sorter_compare_readers(const void *a, const void *b, void *sorter)
+{
+  return sorter_compare(sorter, &((const RunReader *)b)->row, &((const RunReader *)a)->row);
+}
+
+Sorter *sorter_new(RecordCompare compare, uint32_t limit)
+{
+  Sorter *sorter = calloc(1, sizeof(Sorter));
+  sorter->compare = compare;
+  sorter->limit = limit;
+  sorter->capacity = sort_budget / (sizeof(Row) + sizeof(Row *));
+  if (limit > 0 && limit <= sorter->capacity)
+  {
+    sorter->top_n = true;
+    sorter->capacity = limit;
+  }
+  sorter->rows = malloc(sizeof(Row) * sorter->capacity);
+  sorter->order = malloc(sizeof(Row *) * sorter->capacity);
+  return sorter;
+}
+
+static void sorter_write_row(FILE *file, Row *row)
+{
+  uint8_t payload[ROW_SIZE];
+  uint32_t size = serialize_row(row, payload);
+  if (fwrite(&size, sizeof(size), 1, file) != 1 || fwrite(payload, size, 1, file) != 1)
+  {
+    ERROR("sort: write temp file failed!");
+    exit(EXIT_FAILURE);
+  }
+}
+
+static FILE *sorter_new_run()
+{
+  FILE *file = tmpfile();
+  if (file == NULL)
+  {
+    ERROR("sort: unable to create temp file!");
+    exit(EXIT_FAILURE);
+  }
+  setvbuf(file, NULL, _IOFBF, SORT_RUN_BUFFER);
+  return file;
+}
+
+static void sorter_push_run(Sorter *sorter, FILE *file)
+{
+  if (fflush(file) != 0)
+  {
+    ERROR("sort: write temp file failed!");
+    exit(EXIT_FAILURE);
+  }
+  if (sorter->num_runs == sorter->runs_capacity)
+  {
+    sorter->runs_capacity = sorter->runs_capacity ? sorter->runs_capacity * 2 : 16;
+    sorter->runs = realloc(sorter->runs, sizeof(FILE *) * sorter->runs_capacity);
+  }
+  sorter->runs[sorter->num_runs++] = file;
+}
+
+// 行缓冲排序后写成一个顺串; 有 limit 时每个顺串只需保留前 limit 行
+static void sorter_spill(Sorter *sorter)
+{
+  qsort_r(sorter->order, sorter->count, sizeof(Row *), sorter_compare_order, sorter);
+  uint32_t count = (sorter->limit && sorter->limit < sorter->count) ? sorter->limit : sorter->count;
+  FILE *file = sorter_new_run();
+  for (uint32_t i = 0; i < count; i++)
+  {
+    sorter_write_row(file, sorter->order[i]);
+  }
+  sorter_push_run(sorter, file);
+  DEBUGS("sort: spilled run %u with %u rows", sorter->num_runs, count);
+  sorter->count = 0;
+}
+
+void sorter_add(Sorter *sorter, Row *row)
+{
+  if (sorter->top_n)
+  {
+    if (sorter->count < sorter->capacity)
+    {
+      sorter->rows[sorter->count] = *row;
+      sorter->order[sorter->count] = &sorter->rows[sorter->count];
+      heap_sift_up((void **)sorter->order, sorter->count, sorter_compare_rows, sorter);
+      sorter->count += 1;
+    }
+    else if (sorter_compare(sorter, row, sorter->order[0]) < 0)
+    {
+      *sorter->order[0] = *row;
+      heap_sift_down((void **)sorter->order, sorter->count, 0, sorter_compare_rows, sorter);
+    }
+    return;
+  }
+
+  if (sorter->count == sorter->capacity)
+  {
+    sorter_spill(sorter);
+  }
+  sorter->rows[sorter->count] = *row;
+  sorter->order[sorter->count] = &sorter->rows[sorter->count];
+  sorter->count += 1;
+}
+
+// 保证缓冲区中至少有 size 字节未读数据, 文件已读完时返回 false
+static bool run_fill(RunReader *reader, uint32_t size)
+{
+  if (reader->length - reader->position >= size)
+  {
+    return true;
+  }
+  memmove(reader->buffer, reader->buffer + reader->position, reader->length - reader->position);
+  reader->length -= reader->position;
+  reader->position = 0;
+  ssize_t bytes_read = pread(fileno(reader->file), reader->buffer + reader->length,
+                             reader->buffer_size - reader->length, reader->offset);
+  if (bytes_read < 0)
+  {
+    ERROR("sort: read temp file failed!");
+    exit(EXIT_FAILURE);
+  }
+  reader->offset += bytes_read;
+  reader->length += bytes_read;
+  return reader->length >= size;
+}
+
+static bool run_next(RunReader *reader)
+{
+  uint32_t size;
+  if (!run_fill(reader, sizeof(size)))
+  {
+    return false;
+  }
+  memcpy(&size, reader->buffer + reader->position, sizeof(size));
+  if (!run_fill(reader, sizeof(size) + size))
+  {
+    return false;
+  }
+  deserialize_row(reader->buffer + reader->position + sizeof(size), size, &reader->row);
+  reader->position += sizeof(size) + size;
+  return true;
+}
+
+/*
+  k 路归并 runs[0, count): 输出到 output 顺串, output 为 NULL 时交给 sink;
+  有 limit 时只输出前 limit 行。读缓冲平分内存预算
+*/
+static void sorter_merge(Sorter *sorter, FILE **runs, uint32_t count, FILE *output, SortedRowSink sink, void *arg)
+{
+  uint32_t buffer_size = sort_budget / (count + 1);
+  if (buffer_size < SORT_RUN_BUFFER)
+  {
+    buffer_size = SORT_RUN_BUFFER;
+  }
+  RunReader *readers = calloc(count, sizeof(RunReader));
+  RunReader **heap = malloc(sizeof(RunReader *) * count);
+  uint32_t heap_size = 0;
+  for (uint32_t i = 0; i < count; i++)
+  {
+    readers[i].file = runs[i];
+    readers[i].buffer_size = buffer_size;
+    readers[i].buffer = malloc(buffer_size);
+    if (run_next(&readers[i]))
+    {
+      heap[heap_size] = &readers[i];
+      heap_sift_up((void **)heap, heap_size, sorter_compare_readers, sorter);
+      heap_size += 1;
+    }
+  }
+
+  uint32_t emitted = 0;
+  while (heap_size > 0 && (sorter->limit == 0 || emitted < sorter->limit))
+  {
+    RunReader *reader = heap[0];
+    if (output)
+    {
+      sorter_write_row(output, &reader->row);
+    }
+    else
+    {
+      sink(&reader->row, arg);
+    }
+    emitted += 1;
+    if (!run_next(reader))
+    {
+      heap[0] = heap[--heap_size];
+    }
+    heap_sift_down((void **)heap, heap_size, 0, sorter_compare_readers, sorter);
+  }
+
+  for (uint32_t i = 0; i < count; i++)
+  {
+    free(readers[i].buffer);
+    fclose(runs[i]);
+  }
+  free(readers);
+  free(heap);
+}
+
+void sorter_finish(Sorter *sorter, SortedRowSink sink, void *arg)
+{
+  if (sorter->num_runs == 0)
+  {
+    // 全部在内存中 (含 top-N)
+    qsort_r(sorter->order, sorter->count, sizeof(Row *), sorter_compare_order, sorter);
+    uint32_t count = (sorter->limit && sorter->limit < sorter->count) ? sorter->limit : sorter->count;
+    for (uint32_t i = 0; i < count; i++)
+    {
+      sink(sorter->order[i], arg);
+    }
+  }
+  else
+  {
+    if (sorter->count > 0)
+    {
+      sorter_spill(sorter);
+    }
+    // 行缓冲不再需要, 内存留给归并的读缓冲
+    free(sorter->rows);
+    free(sorter->order);
+    sorter->rows = NULL;
+    sorter->order = NULL;
+
+    while (sorter->num_runs > SORT_MAX_FAN_IN)
+    {
+      FILE **runs = sorter->runs;
+      uint32_t num_runs = sorter->num_runs;
+      sorter->runs = NULL;
+      sorter->num_runs = 0;
+      sorter->runs_capacity = 0;
+      for (uint32_t i = 0; i < num_runs; i += SORT_MAX_FAN_IN)
+      {
+        uint32_t count = num_runs - i < SORT_MAX_FAN_IN ? num_runs - i : SORT_MAX_FAN_IN;
+        FILE *output = sorter_new_run();
+        sorter_merge(sorter, runs + i, count, output, NULL, NULL);
+        sorter_push_run(sorter, output);
+      }
+      free(runs);
+    }
+    sorter_merge(sorter, sorter->runs, sorter->num_runs, NULL, sink, arg);
+  }
+
+  free(sorter->rows);
+  free(sorter->order);
+  free(sorter->runs);
+  free(sorter);
+}
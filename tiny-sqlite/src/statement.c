@@ -0,0 +1,464 @@
+#include "../include/statement.h"
+#include "../include/cursor.h"
+#include "../include/tree_node.h"
+#include "../include/text_tree.h"
+#include "../include/page_cache.h"
+#include "../include/hash_index.h"
+#include "../include/sorter.h"
+#include "../include/result_cache.h"
+#include "../include/secondary_index.h"
+
+// 结果缓存 key 的最大长度: 类型、limit、排序列 + 每个条件的列名、运算符和值
+#define STATEMENT_CACHE_KEY_SIZE (64 + FILTER_MAX_PREDICATES * (COLUMN_EMAIL_SIZE + 48))
+
+// 执行插入语句
+static ExecuteResult execute_insert(Statement *statement, Table *table);
+
+// 执行查询语句
+static ExecuteResult execute_select(Statement *statement, Table *table);
+
+// 执行主键点查
+static ExecuteResult execute_select_key(Statement *statement, Table *table);
+
+// 查询 (select / 点查) 经过结果缓存
+static ExecuteResult execute_query(Statement *statement, Table *table);
+
+// 执行删除语句
+static ExecuteResult execute_delete(Statement *statement, Table *table);
+
+static void emit_row(Statement *statement, Row *row)
+{
+  if (statement->row_sink)
+  {
+    statement->row_sink(row, statement->sink_arg);
+  }
+  else
+  {
+    print_row(row);
+  }
+}
+
+PrepareResult prepare_statement(const char *sql, Statement *statement)
+{
+  statement->order_by = NULL;
+  statement->limit = 0;
+  statement->filter.num_predicates = 0;
+  statement->row_sink = NULL;
+  statement->sink_arg = NULL;
+  if (strncmp(sql, "insert", 6) == 0)
+  {
+    statement->type = STATEMENT_INSERT;
+    int args_assinged = sscanf(sql, "insert %lu %s %s",
+                               &statement->row_to_insert.id,
+                               statement->row_to_insert.username,
+                               statement->row_to_insert.email);
+    if (args_assinged < 3)
+    {
+      return PREPARE_SYNTAX_ERROR; // 语法错误
+    }
+    return PREPARE_SUCCESS;
+  }
+  if (strncmp(sql, "delete", 6) == 0)
+  {
+    // 主键可能是 id 或 username, 先按文本读入, 执行时再按表的主键类型解释
+    statement->type = STATEMENT_DELETE;
+    int args_assinged = sscanf(sql, "delete %31s", statement->row_to_insert.username);
+    if (args_assinged < 1)
+    {
+      return PREPARE_SYNTAX_ERROR;
+    }
+    return PREPARE_SUCCESS;
+  }
+  if (strncmp(sql, "select where ", 13) == 0)
+  {
+    // 单个等值条件先按点查准备, 主键先按文本读入, 执行时再按表的主键类型解释
+    int consumed = filter_parse(sql + 6, &statement->filter);
+    if (consumed <= 0 || sql[6 + consumed] != '\0')
+    {
+      return PREPARE_SYNTAX_ERROR;
+    }
+    Predicate *predicate = &statement->filter.predicates[0];
+    statement->type = STATEMENT_SELECT;
+    if (statement->filter.num_predicates == 1 && predicate->op == PREDICATE_EQ &&
+        strlen(predicate->text) < sizeof(statement->row_to_insert.username))
+    {
+      statement->type = STATEMENT_SELECT_KEY;
+      strcpy(statement->row_to_insert.username, predicate->text);
+    }
+    return PREPARE_SUCCESS;
+  }
+  if (strncmp(sql, "select order by ", 16) == 0)
+  {
+    // select order by <列> [limit N]
+    statement->type = STATEMENT_SELECT;
+    char column[32];
+    int consumed = 0;
+    if (sscanf(sql, "select order by %31s%n", column, &consumed) < 1)
+    {
+      return PREPARE_SYNTAX_ERROR;
+    }
+    statement->order_by = find_column(row_columns, row_num_columns, column);
+    if (statement->order_by == NULL)
+    {
+      return PREPARE_SYNTAX_ERROR;
+    }
+    const char *rest = sql + consumed;
+    if (*rest != '\0')
+    {
+      consumed = 0;
+      if (sscanf(rest, " limit %u%n", &statement->limit, &consumed) < 1 || rest[consumed] != '\0' || statement->limit == 0)
+      {
+        return PREPARE_SYNTAX_ERROR;
+      }
+    }
+    return PREPARE_SUCCESS;
+  }
+  if (strcmp(sql, "select") == 0)
+  {
+    statement->type = STATEMENT_SELECT;
+    return PREPARE_SUCCESS;
+  }
+  if (strncmp(sql, "select ", 7) == 0)
+  {
+    statement->type = STATEMENT_AGGREGATE;
+    if (!aggregate_parse(sql + 7, &statement->aggregate, &statement->filter))
+    {
+      return PREPARE_SYNTAX_ERROR;
+    }
+    return PREPARE_SUCCESS;
+  }
+  return PREPARE_UNRECOGNIZED_STATEMENT;
+}
+
+ExecuteResult execute_statement(Statement *statement, Table *table)
+{
+  switch (statement->type)
+  {
+  case STATEMENT_INSERT:
+    return execute_insert(statement, table);
+  case STATEMENT_SELECT:
+  case STATEMENT_SELECT_KEY:
+    return execute_query(statement, table);
+  case STATEMENT_DELETE:
+    return execute_delete(statement, table);
+  case STATEMENT_AGGREGATE:
+    aggregate_execute(&statement->aggregate, &statement->filter, table);
+    return EXECUTE_SUCCESS;
+  }
+  return EXECUTE_SUCCESS;
+}
+
+static ExecuteResult execute_insert(Statement *statement, Table *table)
+{
+  Row *row_to_insert = &(statement->row_to_insert);
+  if (table->key_type == KEY_TYPE_TEXT)
+  {
+    uint8_t value[ROW_SIZE];
+    uint32_t value_size = serialize_row(row_to_insert, value);
+    const char *key = row_to_insert->username;
+    if (!text_tree_insert(table->pager, table->root_page_num, key, strnlen(key, COLUMN_USERNAME_SIZE), value, value_size))
+    {
+      return EXECUTE_DUPLICATE_KEY;
+    }
+    pager_header_for_write(table->pager)->row_count += 1;
+    table->pager->version += 1;
+    return EXECUTE_SUCCESS;
+  }
+
+  uint64_t key_to_insert = row_to_insert->id;
+
+  // 追加快速路径: key 大于表中所有 key 时一定不重复, 直接写入最右叶子末尾
+  Cursor *cursor = table_append_cursor(table, key_to_insert);
+  if (cursor != NULL)
+  {
+    STATS_INC(tree, append_inserts);
+  }
+  else if (!table_key_may_exist(table, key_to_insert))
+  {
+    // Bloom filter 判定不存在, 只需定位插入位置
+    STATS_INC(tree, filter_skips);
+    cursor = table_find(table, key_to_insert);
+  }
+  else if (hash_index_enabled(table->pager) && hash_index_get(table->pager, key_to_insert) != 0)
+  {
+    // 启用哈希索引时, 重复检查只需读目录页和桶页
+    return EXECUTE_DUPLICATE_KEY;
+  }
+  else
+  {
+    cursor = table_find(table, key_to_insert); // 这里的cursor可能指向首个大于 key_to_insert 的 cell
+
+    void *node = get_page(table->pager, cursor->page_num);
+    if (cursor->cell_num < *leaf_node_num_cells(node) && *leaf_node_key(node, cursor->cell_num) == key_to_insert)
+    {
+      // 插入的 key 与已有的 key 重复
+      free(cursor);
+      return EXECUTE_DUPLICATE_KEY;
+    }
+  }
+
+  leaf_node_insert(cursor, row_to_insert->id, row_to_insert);
+  free(cursor); // 释放游标
+  if (secondary_index_enabled(table->pager))
+  {
+    secondary_index_insert(table, row_to_insert);
+  }
+  pager_header_for_write(table->pager)->row_count += 1;
+  table->pager->version += 1;
+  return EXECUTE_SUCCESS;
+}
+
+// 以回调形式输出到语句的 sink (排序器、结果缓存)
+static void emit_row_callback(Row *row, void *statement)
+{
+  emit_row(statement, row);
+}
+
+// 条件中有被索引列的等值条件时返回该条件, 查询只需查找二级索引
+static const Predicate *select_index_predicate(Statement *statement, Table *table)
+{
+  const ColumnInfo *column = secondary_index_column(table->pager);
+  for (uint32_t i = 0; column && i < statement->filter.num_predicates; i++)
+  {
+    Predicate *predicate = &statement->filter.predicates[i];
+    if (predicate->column == column && predicate->op == PREDICATE_EQ)
+    {
+      return predicate;
+    }
+  }
+  return NULL;
+}
+
+typedef struct {
+  Statement *statement;
+  Sorter *sorter;
+} IndexSelect;
+
+// 二级索引查找得到的行: 检查其余条件后与扫描得到的行一样输出
+static void select_index_row(Row *row, void *arg)
+{
+  IndexSelect *select = arg;
+  if (!filter_match(&select->statement->filter, row))
+  {
+    return;
+  }
+  if (select->sorter)
+  {
+    sorter_add(select->sorter, row);
+  }
+  else
+  {
+    emit_row(select->statement, row);
+  }
+}
+
+static ExecuteResult execute_select(Statement *statement, Table *table)
+{
+  // order by: 先把所有行交给排序器, 扫描结束后按顺序输出
+  Sorter *sorter = statement->order_by ? sorter_new(statement->order_by->compare, statement->limit) : NULL;
+  const Predicate *index_predicate = select_index_predicate(statement, table);
+  if (index_predicate)
+  {
+    IndexSelect select = {statement, sorter};
+    secondary_index_lookup(table, index_predicate->text, select_index_row, &select);
+    if (sorter)
+    {
+      sorter_finish(sorter, emit_row_callback, statement);
+    }
+    return EXECUTE_SUCCESS;
+  }
+
+  Batch *batch = malloc(sizeof(Batch));
+  BatchScan scan;
+  Row row;
+  batch_scan_init(&scan, table, ROW_SIZE);
+  while (batch_scan_next(&scan, batch))
+  {
+    batch_filter(batch, &statement->filter);
+    for (uint32_t i = 0; i < batch->num_selected; i++)
+    {
+      batch_row(batch, batch->selection[i], &row);
+      if (sorter)
+      {
+        sorter_add(sorter, &row);
+      }
+      else
+      {
+        emit_row(statement, &row);
+      }
+    }
+  }
+  free(batch);
+
+  if (sorter)
+  {
+    sorter_finish(sorter, emit_row_callback, statement);
+  }
+  return EXECUTE_SUCCESS;
+}
+
+static ExecuteResult execute_select_key(Statement *statement, Table *table)
+{
+  const char *key = statement->row_to_insert.username;
+  Predicate *predicate = &statement->filter.predicates[0];
+  size_t key_offset = (table->key_type == KEY_TYPE_TEXT) ? offsetof(Row, username) : offsetof(Row, id);
+  if (predicate->column->offset != key_offset)
+  {
+    // 条件列不是主键: 按 (可能已被绑定的) 值扫描
+    if (!predicate_set_value(predicate, key))
+    {
+      return EXECUTE_KEY_NOT_FOUND;
+    }
+    return execute_select(statement, table);
+  }
+
+  Row row;
+  if (table->key_type == KEY_TYPE_TEXT)
+  {
+    uint8_t value[TEXT_VALUE_MAX_SIZE];
+    int32_t value_size = text_tree_get(table->pager, table->root_page_num, key, strlen(key), value);
+    if (value_size < 0)
+    {
+      return EXECUTE_KEY_NOT_FOUND;
+    }
+    deserialize_row(value, value_size, &row);
+    emit_row(statement, &row);
+    return EXECUTE_SUCCESS;
+  }
+
+  char *end;
+  uint64_t id = strtoull(key, &end, 10);
+  Cursor *cursor = (*end == '\0') ? table_lookup(table, id) : NULL;
+  if (cursor == NULL)
+  {
+    return EXECUTE_KEY_NOT_FOUND;
+  }
+  cursor_row(cursor, &row, ROW_SIZE);
+  emit_row(statement, &row);
+  free(cursor);
+  return EXECUTE_SUCCESS;
+}
+
+/*
+  结果缓存的 key: 语句类型、limit、排序列和全部条件 (含绑定的参数), 与 SQL 的写法无关;
+  值前带长度, 不同的语句不会拼出相同的 key
+*/
+static void statement_cache_key(Statement *statement, char *key)
+{
+  int size = sprintf(key, "%d:%u:%s", statement->type, statement->limit,
+                     statement->order_by ? statement->order_by->name : "");
+  Filter *filter = &statement->filter;
+  if (statement->type == STATEMENT_SELECT_KEY)
+  {
+    // 点查的值在 row_to_insert.username 中 (服务端绑定参数时只写入这里)
+    const char *value = statement->row_to_insert.username;
+    sprintf(key + size, "|%s=%zu:%s", filter->predicates[0].column->name, strlen(value), value);
+    return;
+  }
+  for (uint32_t i = 0; i < filter->num_predicates; i++)
+  {
+    Predicate *predicate = &filter->predicates[i];
+    size += sprintf(key + size, "|%s%d%zu:%s", predicate->column->name, predicate->op,
+                    strlen(predicate->text), predicate->text);
+  }
+}
+
+// 结果输出到原来的 sink, 同时收集到 builder
+typedef struct {
+  RowSink sink;
+  void *sink_arg;
+  ResultBuilder *builder;
+} ResultCapture;
+
+static void capture_row(Row *row, void *arg)
+{
+  ResultCapture *capture = arg;
+  result_builder_add(capture->builder, row);
+  if (capture->sink)
+  {
+    capture->sink(row, capture->sink_arg);
+  }
+  else
+  {
+    print_row(row);
+  }
+}
+
+static ExecuteResult execute_query(Statement *statement, Table *table)
+{
+  ExecuteResult (*execute)(Statement *, Table *) =
+      (statement->type == STATEMENT_SELECT) ? execute_select : execute_select_key;
+  if (!result_cache_enabled())
+  {
+    return execute(statement, table);
+  }
+
+  char key[STATEMENT_CACHE_KEY_SIZE];
+  statement_cache_key(statement, key);
+  uint32_t status;
+  if (result_cache_replay(table->pager, key, emit_row_callback, statement, &status))
+  {
+    return status;
+  }
+
+  ResultCapture capture = {statement->row_sink, statement->sink_arg, result_builder_new()};
+  statement->row_sink = capture_row;
+  statement->sink_arg = &capture;
+  ExecuteResult result = execute(statement, table);
+  statement->row_sink = capture.sink;
+  statement->sink_arg = capture.sink_arg;
+  result_cache_store(table->pager, key, capture.builder, result);
+  return result;
+}
+
+static ExecuteResult execute_delete(Statement *statement, Table *table)
+{
+  const char *key = statement->row_to_insert.username;
+  if (table->key_type == KEY_TYPE_TEXT)
+  {
+    if (!text_tree_delete(table->pager, table->root_page_num, key, strlen(key)))
+    {
+      return EXECUTE_KEY_NOT_FOUND;
+    }
+    pager_header_for_write(table->pager)->row_count -= 1;
+    table->pager->version += 1;
+    return EXECUTE_SUCCESS;
+  }
+
+  char *end;
+  uint64_t key_to_delete = strtoull(key, &end, 10);
+  Cursor *cursor = (*end == '\0') ? table_lookup(table, key_to_delete) : NULL;
+  if (cursor == NULL)
+  {
+    return EXECUTE_KEY_NOT_FOUND;
+  }
+
+  if (secondary_index_enabled(table->pager))
+  {
+    // 删除前读出整行, 得到索引列的值
+    Row row;
+    cursor_row(cursor, &row, ROW_SIZE);
+    secondary_index_delete(table, &row);
+  }
+  leaf_node_delete(cursor);
+  free(cursor);
+  pager_header_for_write(table->pager)->row_count -= 1;
+  table->pager->version += 1;
+  return EXECUTE_SUCCESS;
+}
+
+StatsStatementType statement_stats_type(StatementType type)
+{
+  switch (type)
+  {
+  case STATEMENT_INSERT:
+    return STATS_STMT_INSERT;
+  case STATEMENT_SELECT:
+  case STATEMENT_SELECT_KEY:
+  case STATEMENT_AGGREGATE:
+    return STATS_STMT_SELECT;
+  case STATEMENT_DELETE:
+    return STATS_STMT_DELETE;
+  }
+  return STATS_STMT_SELECT;
+}
@@ -0,0 +1,118 @@
+#include <time.h>
+
+#include "../include/stats.h"
+#include "../include/page_cache.h"
+#include "../include/result_cache.h"
+
+LogLevel db_log_level = LOG_LEVEL_ERROR;
+
+#ifdef DB_STATS
+Stats db_stats;
+
+static const char *statement_names[STATS_STMT_TYPES] = {"insert", "select", "delete"};
+#endif
+
+uint64_t stats_now_us()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void stats_record_latency(StatsStatementType type, uint64_t elapsed_us)
+{
+#ifdef DB_STATS
+  LatencyHistogram *histogram = &db_stats.latency[type];
+
+  // 桶下标 = floor(log2(us))，0us 落入第一个桶
+  uint32_t bucket = 0;
+  if (elapsed_us > 0)
+  {
+    bucket = 63 - __builtin_clzll(elapsed_us);
+  }
+  if (bucket >= STATS_LATENCY_BUCKETS)
+  {
+    bucket = STATS_LATENCY_BUCKETS - 1;
+  }
+
+  histogram->count += 1;
+  histogram->total_us += elapsed_us;
+  histogram->buckets[bucket] += 1;
+  if (elapsed_us > histogram->max_us)
+  {
+    histogram->max_us = elapsed_us;
+  }
+#endif
+}
+
+void stats_snapshot(Table *table, StatsSnapshot *snapshot)
+{
+  memset(snapshot, 0, sizeof(StatsSnapshot));
+#ifdef DB_STATS
+  snapshot->counters = db_stats;
+#endif
+  DbHeader *header = pager_header(table->pager);
+  snapshot->tree_height = header->tree_height;
+  snapshot->num_rows = header->row_count;
+  snapshot->num_pages = table->pager->num_pages;
+  snapshot->free_pages = header->freelist_count;
+  snapshot->cached_pages = page_cache_num_pages();
+  snapshot->cache_budget = page_cache_budget() / PAGE_SIZE;
+  snapshot->page_size = PAGE_SIZE;
+  snapshot->cache_arena = page_cache_arena_kind();
+  snapshot->result_cache_used = result_cache_used();
+  snapshot->result_cache_budget = result_cache_budget();
+}
+
+void stats_reset()
+{
+#ifdef DB_STATS
+  memset(&db_stats, 0, sizeof(Stats));
+#endif
+}
+
+void print_stats(Table *table)
+{
+  StatsSnapshot snapshot;
+  stats_snapshot(table, &snapshot);
+
+  printf("tree height: %d\t rows: %lu\n", snapshot.tree_height, snapshot.num_rows);
+  printf("pages: %d\t free: %d\n", snapshot.num_pages, snapshot.free_pages);
+  static const char *arena_names[] = {"normal", "thp", "hugetlb"};
+  printf("cache: %d / %d pages\t page size: %u\t arena: %s\n", snapshot.cached_pages, snapshot.cache_budget,
+         snapshot.page_size, arena_names[snapshot.cache_arena]);
+  printf("result cache: %lu / %lu KB\n", snapshot.result_cache_used / 1024, snapshot.result_cache_budget / 1024);
+#ifdef DB_STATS
+  PagerStats *pager = &snapshot.counters.pager;
+  TreeStats *tree = &snapshot.counters.tree;
+  printf("page hits: %lu\t misses: %lu\n", pager->page_hits, pager->page_misses);
+  printf("page reads: %lu\t writes: %lu\t evictions: %lu\n", pager->page_reads, pager->page_writes, pager->page_evictions);
+  printf("bytes read: %lu\t flushed: %lu\t commits: %lu\n", pager->bytes_read, pager->bytes_flushed, pager->commits);
+  printf("splits: leaf %lu\t internal %lu\t root %lu\n",
+         tree->leaf_splits, tree->internal_splits, tree->root_splits);
+  printf("inserts: append %lu\t filter skips %lu\n", tree->append_inserts, tree->filter_skips);
+  QueryStats *query = &snapshot.counters.query;
+  printf("result cache hits: %lu\t misses: %lu\t evictions: %lu\n",
+         query->result_hits, query->result_misses, query->result_evictions);
+
+  for (uint32_t type = 0; type < STATS_STMT_TYPES; ++type)
+  {
+    LatencyHistogram *histogram = &snapshot.counters.latency[type];
+    if (histogram->count == 0)
+    {
+      continue;
+    }
+    printf("%s: count %lu\t avg %lu us\t max %lu us\n", statement_names[type],
+           histogram->count, histogram->total_us / histogram->count, histogram->max_us);
+    for (uint32_t i = 0; i < STATS_LATENCY_BUCKETS; ++i)
+    {
+      if (histogram->buckets[i])
+      {
+        printf("\t[%lu, %lu) us: %lu\n", i ? (1UL << i) : 0, 1UL << (i + 1), histogram->buckets[i]);
+      }
+    }
+  }
+#else
+  printf("counters disabled (build with DB_STATS)\n");
+#endif
+}
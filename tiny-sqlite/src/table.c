@@ -1,55 +1,136 @@
 #include "../include/table.h"
 #include "../include/tree_node.h"
+#include "../include/text_tree.h"
 
 Table* db_open(const char* file_name) {
+    return db_open_keyed(file_name, KEY_TYPE_INTEGER);
+}
+
+// 沿最左路径下降计算树高
+static uint32_t table_tree_height(Table* table) {
+    uint32_t height = 1;
+    void* node = get_page(table->pager, table->root_page_num);
+    while (true) {
+        NodeType type = get_node_type(node);
+        if (type == NODE_INTERNAL) {
+            node = get_page(table->pager, *internal_node_child(node, 0));
+        } else if (type == NODE_TEXT_INTERNAL) {
+            node = get_page(table->pager, text_node_child(node, 0));
+        } else {
+            break;
+        }
+        height += 1;
+    }
+    return height;
+}
+
+static uint64_t table_count_rows(Table* table) {
+    uint64_t num_rows = 0;
+    if (table->key_type == KEY_TYPE_TEXT) {
+        TextCursor cursor;
+        for (text_tree_start(table->pager, table->root_page_num, &cursor); !cursor.end_of_tree; text_cursor_advance(&cursor)) {
+            num_rows += 1;
+        }
+        return num_rows;
+    }
+    Cursor* cursor = table_start(table);
+    while (!cursor->end_of_table) {
+        num_rows += 1;
+        cursor_advance(cursor);
+    }
+    free(cursor);
+    return num_rows;
+}
+
+// 旧格式文件: 一次性扫描得到行数和树高, 之后由增删维护
+static void table_upgrade_header(Table* table, DbHeader* header) {
+    pager_mark_dirty(table->pager, 0);
+    header->row_count = table_count_rows(table);
+    header->tree_height = table_tree_height(table);
+    header->page_size = PAGE_SIZE;
+    header->format_version = DB_FORMAT_VERSION;
+}
+
+Table* db_open_keyed(const char* file_name, KeyType key_type) {
     Pager* pager = pager_open(file_name);
-    
+    if (pager == NULL) {
+        return NULL;
+    }
+
     Table *table = (Table*)malloc(sizeof(Table));
     table->pager = pager;
-    table->root_page_num = 0;
-    
-    if (pager->num_pages == 0) {
-        void* root_node = get_page(pager, 0);
-        initial_leaf_node(root_node);
-        set_node_is_root(root_node, true);
+
+    DbHeader* header = pager_header(pager);
+    if (header->root_page_num == 0) {
+        // 新建数据库: page 0 为文件头, 根节点从 page 1 开始
+        uint32_t root_page_num = get_unused_page_num(pager);
+        if (key_type == KEY_TYPE_TEXT) {
+            text_tree_init(pager, root_page_num);
+        } else {
+            void* root_node = get_page_for_write(pager, root_page_num);
+            initial_leaf_node(root_node);
+            set_node_is_root(root_node, true);
+        }
+        pager_mark_dirty(pager, 0);
+        header->root_page_num = root_page_num;
+        header->key_type = key_type;
+        header->tree_height = 1;
+    }
+    table->root_page_num = header->root_page_num;
+    table->key_type = header->key_type;
+    if (header->format_version == 0) {
+        table_upgrade_header(table, header);
     }
     return table;
 }
 
 void db_close(Table* table) {
-    Pager* pager = table->pager;
-   
-    for (u_int32_t i = 0; i < pager->num_pages; ++i) {
-        if (pager->pages[i] == NULL) continue;
+    pager_close(table->pager);
+    free(table);
+}
 
-        pager_flush(pager, i);
-        free(pager->pages[i]);
-        pager->pages[i] = NULL;
+// 扫描全表重建 Bloom filter, 容量取当前行数 (文件头中维护) 的两倍, 为后续插入留出空间
+static BloomFilter* table_build_key_filter(Table* table) {
+    uint64_t num_rows = pager_header(table->pager)->row_count;
+    BloomFilter* filter = bloom_new(num_rows * 2 > 1024 ? num_rows * 2 : 1024);
+    Cursor* cursor = table_start(table);
+    while (!cursor->end_of_table) {
+        void* node = get_page(table->pager, cursor->page_num);
+        bloom_add(filter, *leaf_node_key(node, cursor->cell_num));
+        cursor_advance(cursor);
     }
+    free(cursor);
+    return filter;
+}
 
+bool table_key_may_exist(Table* table, uint64_t key) {
+    Pager* pager = table->pager;
+    BloomFilter* filter = pager->key_filter;
+    // 超出容量或删除过多时误判率上升, 重建
+    if (filter == NULL || filter->num_keys > filter->capacity || filter->num_removed > filter->num_keys / 2) {
+        bloom_free(filter);
+        filter = pager->key_filter = table_build_key_filter(table);
+    }
+    return bloom_may_contain(filter, key);
+}
 
-    int result = close(pager->file_descirptor);
-    if (result == -1) {
-        ERROR("close file error!");
-        exit(EXIT_FAILURE);
+void table_key_inserted(Table* table, uint64_t key) {
+    if (table->pager->key_filter) {
+        bloom_add(table->pager->key_filter, key);
     }
+}
 
-    for (uint32_t i = 0; i < TABLE_MAX_PAGES; ++i) {
-        void* page = pager->pages[i];
-        if (page) {
-            free(page);
-            pager->pages[i] = NULL;
-        }
+void table_key_deleted(Table* table, uint64_t key) {
+    if (table->pager->key_filter) {
+        table->pager->key_filter->num_removed += 1;
     }
-    free(pager);
-    free(table);
 }
 
 void *row_slot(Table* table, uint32_t row_num) {
     const uint32_t row_count_per_page = PAGE_SIZE / ROW_SIZE;
 
     uint32_t page_num = row_num / row_count_per_page;
-    void *page = get_page(table->pager, page_num);
+    void *page = get_page_for_write(table->pager, page_num);
 
     uint32_t row_offset = row_num % row_count_per_page;
     uint32_t byte_offset = row_offset * ROW_SIZE; // 该行所在的字节偏移
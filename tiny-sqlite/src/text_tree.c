@@ -0,0 +1,775 @@
+#include "../include/text_tree.h"
+#include "../include/stats.h"
+
+#define TEXT_TREE_MAX_DEPTH 32
+
+// 解码后的 cell: 完整 key + value (叶子) 或孩子页号 (内部节点)
+typedef struct {
+  const uint8_t *key;
+  uint32_t key_size;
+  const uint8_t *value;
+  uint32_t value_size;
+  uint32_t child;
+} TextEntry;
+
+static uint16_t *text_node_num_cells(void *node)
+{
+  return node + TEXT_NODE_NUM_CELLS_OFFSET;
+}
+
+static uint32_t *text_node_right(void *node)
+{
+  return node + TEXT_NODE_RIGHT_OFFSET;
+}
+
+static uint16_t *text_node_prefix_size(void *node)
+{
+  return node + TEXT_NODE_PREFIX_SIZE_OFFSET;
+}
+
+static uint32_t *text_node_content_start(void *node)
+{
+  return node + TEXT_NODE_CONTENT_START_OFFSET;
+}
+
+static uint8_t *text_node_prefix(void *node)
+{
+  return node + TEXT_NODE_HEADER_SIZE;
+}
+
+static uint16_t *text_node_offsets(void *node)
+{
+  return (void *)text_node_prefix(node) + *text_node_prefix_size(node);
+}
+
+static uint8_t *text_node_cell(void *node, uint32_t cell_num)
+{
+  return node + text_node_offsets(node)[cell_num];
+}
+
+static bool text_node_is_leaf(void *node)
+{
+  return get_node_type(node) == NODE_TEXT_LEAF;
+}
+
+static void text_node_init(void *node, NodeType type)
+{
+  set_node_type(node, type);
+  *text_node_num_cells(node) = 0;
+  *text_node_right(node) = 0;
+  *text_node_prefix_size(node) = 0;
+  *text_node_content_start(node) = PAGE_SIZE;
+}
+
+// cell 中存放的 key 后缀
+static uint32_t text_cell_suffix(void *node, uint32_t cell_num, const uint8_t **suffix)
+{
+  uint8_t *cell = text_node_cell(node, cell_num);
+  if (text_node_is_leaf(node))
+  {
+    *suffix = cell + TEXT_LEAF_CELL_HEADER_SIZE;
+    return *(uint16_t *)cell;
+  }
+  *suffix = cell + TEXT_INTERNAL_CELL_HEADER_SIZE;
+  return *(uint16_t *)(cell + sizeof(uint32_t));
+}
+
+static uint32_t text_leaf_value(void *node, uint32_t cell_num, const uint8_t **value)
+{
+  uint8_t *cell = text_node_cell(node, cell_num);
+  *value = cell + TEXT_LEAF_CELL_HEADER_SIZE + *(uint16_t *)cell;
+  return *(uint16_t *)(cell + sizeof(uint16_t));
+}
+
+uint32_t text_node_child(void *node, uint32_t child_num)
+{
+  if (child_num == *text_node_num_cells(node))
+  {
+    return *text_node_right(node);
+  }
+  return *(uint32_t *)text_node_cell(node, child_num);
+}
+
+static void text_node_set_child(void *node, uint32_t child_num, uint32_t page_num)
+{
+  if (child_num == *text_node_num_cells(node))
+  {
+    *text_node_right(node) = page_num;
+  }
+  else
+  {
+    *(uint32_t *)text_node_cell(node, child_num) = page_num;
+  }
+}
+
+static int text_key_compare(const uint8_t *a, uint32_t a_size, const uint8_t *b, uint32_t b_size)
+{
+  int cmp = memcmp(a, b, a_size < b_size ? a_size : b_size);
+  if (cmp != 0)
+  {
+    return cmp;
+  }
+  return (a_size > b_size) - (a_size < b_size);
+}
+
+static uint32_t text_common_prefix(const uint8_t *a, uint32_t a_size, const uint8_t *b, uint32_t b_size)
+{
+  uint32_t n = a_size < b_size ? a_size : b_size;
+  uint32_t i = 0;
+  while (i < n && a[i] == b[i])
+  {
+    i++;
+  }
+  return i;
+}
+
+/*
+  返回首个 >= key 的 cell 下标, found 表示是否相等:
+  先与节点前缀比较, 前缀不同说明 key 落在整个节点之前或之后; 否则只在后缀上二分
+*/
+static uint32_t text_node_search(void *node, const uint8_t *key, uint32_t key_size, bool *found)
+{
+  uint32_t num_cells = *text_node_num_cells(node);
+  uint32_t prefix_size = *text_node_prefix_size(node);
+  *found = false;
+
+  int cmp = memcmp(key, text_node_prefix(node), key_size < prefix_size ? key_size : prefix_size);
+  if (cmp < 0 || (cmp == 0 && key_size < prefix_size))
+  {
+    return 0;
+  }
+  if (cmp > 0)
+  {
+    return num_cells;
+  }
+
+  const uint8_t *suffix = key + prefix_size;
+  uint32_t suffix_size = key_size - prefix_size;
+  uint32_t left_index = 0, right_index = num_cells;
+  while (left_index != right_index)
+  {
+    uint32_t mid_index = (left_index + right_index) / 2;
+    const uint8_t *cell_suffix;
+    uint32_t cell_suffix_size = text_cell_suffix(node, mid_index, &cell_suffix);
+    cmp = text_key_compare(suffix, suffix_size, cell_suffix, cell_suffix_size);
+    if (cmp == 0)
+    {
+      *found = true;
+      return mid_index;
+    }
+    if (cmp < 0)
+    {
+      right_index = mid_index;
+    }
+    else
+    {
+      left_index = mid_index + 1;
+    }
+  }
+  return left_index;
+}
+
+// 孩子 i 中的 key 都小于分隔 key i, 等于分隔 key 时进入右侧孩子
+static uint32_t text_node_find_child(void *node, const uint8_t *key, uint32_t key_size)
+{
+  bool found;
+  uint32_t index = text_node_search(node, key, key_size, &found);
+  return found ? index + 1 : index;
+}
+
+static uint32_t text_node_free_space(void *node)
+{
+  uint32_t used = TEXT_NODE_HEADER_SIZE + *text_node_prefix_size(node) +
+                  *text_node_num_cells(node) * TEXT_NODE_OFFSET_SIZE;
+  return *text_node_content_start(node) - used;
+}
+
+static uint32_t text_entry_cell_size(TextEntry *entry, uint32_t prefix_size, bool is_leaf)
+{
+  uint32_t suffix_size = entry->key_size - prefix_size;
+  if (is_leaf)
+  {
+    return TEXT_LEAF_CELL_HEADER_SIZE + suffix_size + entry->value_size;
+  }
+  return TEXT_INTERNAL_CELL_HEADER_SIZE + suffix_size;
+}
+
+static void text_entry_write(uint8_t *cell, TextEntry *entry, uint32_t prefix_size, bool is_leaf)
+{
+  uint32_t suffix_size = entry->key_size - prefix_size;
+  if (is_leaf)
+  {
+    *(uint16_t *)cell = suffix_size;
+    *(uint16_t *)(cell + sizeof(uint16_t)) = entry->value_size;
+    memcpy(cell + TEXT_LEAF_CELL_HEADER_SIZE, entry->key + prefix_size, suffix_size);
+    memcpy(cell + TEXT_LEAF_CELL_HEADER_SIZE + suffix_size, entry->value, entry->value_size);
+  }
+  else
+  {
+    *(uint32_t *)cell = entry->child;
+    *(uint16_t *)(cell + sizeof(uint32_t)) = suffix_size;
+    memcpy(cell + TEXT_INTERNAL_CELL_HEADER_SIZE, entry->key + prefix_size, suffix_size);
+  }
+}
+
+// 解出节点中所有 cell 并还原完整 key, key 与 value 复制到 scratch 中
+static uint32_t text_node_decode(void *node, TextEntry *entries, uint8_t *scratch)
+{
+  uint32_t num_cells = *text_node_num_cells(node);
+  uint32_t prefix_size = *text_node_prefix_size(node);
+  bool is_leaf = text_node_is_leaf(node);
+  for (uint32_t i = 0; i < num_cells; i++)
+  {
+    const uint8_t *suffix;
+    uint32_t suffix_size = text_cell_suffix(node, i, &suffix);
+    memcpy(scratch, text_node_prefix(node), prefix_size);
+    memcpy(scratch + prefix_size, suffix, suffix_size);
+    entries[i].key = scratch;
+    entries[i].key_size = prefix_size + suffix_size;
+    scratch += entries[i].key_size;
+
+    if (is_leaf)
+    {
+      const uint8_t *value;
+      entries[i].value_size = text_leaf_value(node, i, &value);
+      memcpy(scratch, value, entries[i].value_size);
+      entries[i].value = scratch;
+      scratch += entries[i].value_size;
+    }
+    else
+    {
+      entries[i].child = text_node_child(node, i);
+    }
+  }
+  return num_cells;
+}
+
+static size_t text_node_scratch_size(void *node)
+{
+  return (size_t)*text_node_num_cells(node) * *text_node_prefix_size(node) + PAGE_SIZE;
+}
+
+/*
+  用有序的 entries 重建节点, 节点前缀取首尾 key 的公共前缀;
+  放不下时返回 false, 节点内容不变
+*/
+static bool text_node_build(void *node, NodeType type, TextEntry *entries, uint32_t num_entries, uint32_t right)
+{
+  bool is_leaf = (type == NODE_TEXT_LEAF);
+  uint32_t prefix_size = 0;
+  if (num_entries > 1)
+  {
+    prefix_size = text_common_prefix(entries[0].key, entries[0].key_size,
+                                     entries[num_entries - 1].key, entries[num_entries - 1].key_size);
+  }
+
+  uint32_t total = TEXT_NODE_HEADER_SIZE + prefix_size + num_entries * TEXT_NODE_OFFSET_SIZE;
+  for (uint32_t i = 0; i < num_entries; i++)
+  {
+    total += text_entry_cell_size(&entries[i], prefix_size, is_leaf);
+  }
+  if (total > PAGE_SIZE)
+  {
+    return false;
+  }
+
+  uint8_t page[PAGE_SIZE_MAX];
+  memcpy(page, node, COMMON_NODE_HEADER_SIZE);
+  text_node_init(page, type);
+  *text_node_num_cells(page) = num_entries;
+  *text_node_right(page) = right;
+  *text_node_prefix_size(page) = prefix_size;
+  if (num_entries > 0)
+  {
+    memcpy(text_node_prefix(page), entries[0].key, prefix_size);
+  }
+
+  uint16_t *offsets = text_node_offsets(page);
+  uint32_t content_start = PAGE_SIZE;
+  for (uint32_t i = 0; i < num_entries; i++)
+  {
+    content_start -= text_entry_cell_size(&entries[i], prefix_size, is_leaf);
+    offsets[i] = content_start;
+    text_entry_write(page + content_start, &entries[i], prefix_size, is_leaf);
+  }
+  *text_node_content_start(page) = content_start;
+  memcpy(node, page, PAGE_SIZE);
+  return true;
+}
+
+// 快速路径: key 带有节点前缀且剩余空间足够时, 直接写入 cell 并插入偏移
+static bool text_node_insert_in_place(void *node, uint32_t index, TextEntry *entry)
+{
+  uint32_t prefix_size = *text_node_prefix_size(node);
+  if (entry->key_size < prefix_size || memcmp(entry->key, text_node_prefix(node), prefix_size) != 0)
+  {
+    return false;
+  }
+  uint32_t cell_size = text_entry_cell_size(entry, prefix_size, text_node_is_leaf(node));
+  if (text_node_free_space(node) < cell_size + TEXT_NODE_OFFSET_SIZE)
+  {
+    return false;
+  }
+
+  uint32_t num_cells = *text_node_num_cells(node);
+  uint32_t content_start = *text_node_content_start(node) - cell_size;
+  text_entry_write((uint8_t *)node + content_start, entry, prefix_size, text_node_is_leaf(node));
+
+  uint16_t *offsets = text_node_offsets(node);
+  memmove(offsets + index + 1, offsets + index, (num_cells - index) * TEXT_NODE_OFFSET_SIZE);
+  offsets[index] = content_start;
+  *text_node_content_start(node) = content_start;
+  *text_node_num_cells(node) = num_cells + 1;
+  return true;
+}
+
+static void text_node_remove_cell(void *node, uint32_t index)
+{
+  uint32_t num_cells = *text_node_num_cells(node);
+  uint16_t *offsets = text_node_offsets(node);
+  memmove(offsets + index, offsets + index + 1, (num_cells - index - 1) * TEXT_NODE_OFFSET_SIZE);
+  *text_node_num_cells(node) = num_cells - 1;
+}
+
+// 申请并清空一个新页 (复用的空闲 trunk 页中可能残留数据)
+static void *text_new_page(Pager *pager, uint32_t *page_num)
+{
+  *page_num = get_unused_page_num(pager);
+  void *node = get_page_for_write(pager, *page_num);
+  memset(node, 0, PAGE_SIZE);
+  return node;
+}
+
+// 按字节数把 num_entries 个 entry 分为两半, 返回右半部分起始下标 (两侧至少各一个)
+static uint32_t text_split_point(TextEntry *entries, uint32_t num_entries, bool is_leaf)
+{
+  uint32_t total = 0;
+  for (uint32_t i = 0; i < num_entries; i++)
+  {
+    total += text_entry_cell_size(&entries[i], 0, is_leaf);
+  }
+  uint32_t left = 0, split = 0;
+  while (split < num_entries - 1 && left < total / 2)
+  {
+    left += text_entry_cell_size(&entries[split], 0, is_leaf);
+    split++;
+  }
+  return split ? split : 1;
+}
+
+// 文件头只记录主键树的高度, 二级索引树 (见 secondary_index.h) 不记录
+static bool text_tree_is_primary(Pager *pager, uint32_t root_page_num)
+{
+  return pager_header(pager)->root_page_num == root_page_num;
+}
+
+void text_tree_init(Pager *pager, uint32_t root_page_num)
+{
+  void *root = get_page_for_write(pager, root_page_num);
+  memset(root, 0, PAGE_SIZE);
+  text_node_init(root, NODE_TEXT_LEAF);
+  set_node_is_root(root, true);
+}
+
+/*
+  path[depth] 中下标为 path_index[depth] 的孩子 left_page_num 分裂出了右兄弟 right_page_num:
+  原指向 left 的指针改为指向 right, 并在其前插入 (separator, left);
+  节点放不下时分裂, 中间的分隔 key 上移到父节点
+*/
+static void text_internal_insert(Pager *pager, uint32_t *path, uint32_t *path_index, int32_t depth,
+                                 const uint8_t *separator, uint32_t separator_size,
+                                 uint32_t left_page_num, uint32_t right_page_num)
+{
+  uint32_t page_num = path[depth];
+  uint32_t index = path_index[depth];
+  void *node = get_page_for_write(pager, page_num);
+  TextEntry entry = {separator, separator_size, NULL, 0, left_page_num};
+
+  text_node_set_child(node, index, right_page_num);
+  if (text_node_insert_in_place(node, index, &entry))
+  {
+    return;
+  }
+
+  uint32_t num_cells = *text_node_num_cells(node);
+  uint32_t right = *text_node_right(node);
+  TextEntry *entries = malloc((num_cells + 1) * sizeof(TextEntry));
+  uint8_t *scratch = malloc(text_node_scratch_size(node));
+  text_node_decode(node, entries, scratch);
+  memmove(entries + index + 1, entries + index, (num_cells - index) * sizeof(TextEntry));
+  entries[index] = entry;
+  uint32_t num_entries = num_cells + 1;
+
+  if (!text_node_build(node, NODE_TEXT_INTERNAL, entries, num_entries, right))
+  {
+    STATS_INC(tree, internal_splits);
+    // 左: [0, m) + right child entries[m].child; entries[m].key 上移; 右: [m + 1, n) + right
+    uint32_t m = text_split_point(entries, num_entries, false);
+    if (m == num_entries - 1)
+    {
+      m -= 1;
+    }
+    uint8_t promoted[TEXT_KEY_MAX_SIZE];
+    uint32_t promoted_size = entries[m].key_size;
+    memcpy(promoted, entries[m].key, promoted_size);
+
+    if (is_node_root(node))
+    {
+      STATS_INC(tree, root_splits);
+      if (text_tree_is_primary(pager, page_num))
+      {
+        pager_header_for_write(pager)->tree_height += 1;
+      }
+      uint32_t left_child_page_num, right_child_page_num;
+      void *left_child = text_new_page(pager, &left_child_page_num);
+      text_node_build(left_child, NODE_TEXT_INTERNAL, entries, m, entries[m].child);
+      void *right_child = text_new_page(pager, &right_child_page_num);
+      text_node_build(right_child, NODE_TEXT_INTERNAL, entries + m + 1, num_entries - m - 1, right);
+
+      TextEntry root_entry = {promoted, promoted_size, NULL, 0, left_child_page_num};
+      text_node_build(node, NODE_TEXT_INTERNAL, &root_entry, 1, right_child_page_num);
+    }
+    else
+    {
+      uint32_t new_page_num;
+      void *new_node = text_new_page(pager, &new_page_num);
+      text_node_build(new_node, NODE_TEXT_INTERNAL, entries + m + 1, num_entries - m - 1, right);
+      text_node_build(node, NODE_TEXT_INTERNAL, entries, m, entries[m].child);
+      text_internal_insert(pager, path, path_index, depth - 1, promoted, promoted_size, page_num, new_page_num);
+    }
+  }
+  free(scratch);
+  free(entries);
+}
+
+bool text_tree_insert(Pager *pager, uint32_t root_page_num, const void *key, uint32_t key_size,
+                      const void *value, uint32_t value_size)
+{
+  uint32_t path[TEXT_TREE_MAX_DEPTH];
+  uint32_t path_index[TEXT_TREE_MAX_DEPTH];
+  int32_t depth = 0;
+
+  uint32_t page_num = root_page_num;
+  void *node = get_page(pager, page_num);
+  while (get_node_type(node) == NODE_TEXT_INTERNAL)
+  {
+    uint32_t index = text_node_find_child(node, key, key_size);
+    path[depth] = page_num;
+    path_index[depth++] = index;
+    page_num = text_node_child(node, index);
+    node = get_page(pager, page_num);
+  }
+
+  bool found;
+  uint32_t index = text_node_search(node, key, key_size, &found);
+  if (found)
+  {
+    return false;
+  }
+
+  pager_mark_dirty(pager, page_num);
+  TextEntry entry = {key, key_size, value, value_size, 0};
+  if (text_node_insert_in_place(node, index, &entry))
+  {
+    return true;
+  }
+
+  uint32_t num_cells = *text_node_num_cells(node);
+  uint32_t next_leaf = *text_node_right(node);
+  TextEntry *entries = malloc((num_cells + 1) * sizeof(TextEntry));
+  uint8_t *scratch = malloc(text_node_scratch_size(node));
+  text_node_decode(node, entries, scratch);
+  memmove(entries + index + 1, entries + index, (num_cells - index) * sizeof(TextEntry));
+  entries[index] = entry;
+  uint32_t num_entries = num_cells + 1;
+
+  if (!text_node_build(node, NODE_TEXT_LEAF, entries, num_entries, next_leaf))
+  {
+    STATS_INC(tree, leaf_splits);
+    // 分隔 key 截断为右侧最小 key 中能与左侧最大 key 区分的最短前缀
+    uint32_t m = text_split_point(entries, num_entries, true);
+    uint8_t separator[TEXT_KEY_MAX_SIZE];
+    uint32_t separator_size = text_common_prefix(entries[m - 1].key, entries[m - 1].key_size,
+                                                 entries[m].key, entries[m].key_size) + 1;
+    memcpy(separator, entries[m].key, separator_size);
+
+    if (page_num == root_page_num)
+    {
+      STATS_INC(tree, root_splits);
+      if (text_tree_is_primary(pager, root_page_num))
+      {
+        pager_header_for_write(pager)->tree_height += 1;
+      }
+      uint32_t left_child_page_num, right_child_page_num;
+      void *left_child = text_new_page(pager, &left_child_page_num);
+      void *right_child = text_new_page(pager, &right_child_page_num);
+      text_node_build(left_child, NODE_TEXT_LEAF, entries, m, right_child_page_num);
+      text_node_build(right_child, NODE_TEXT_LEAF, entries + m, num_entries - m, 0);
+
+      TextEntry root_entry = {separator, separator_size, NULL, 0, left_child_page_num};
+      text_node_build(node, NODE_TEXT_INTERNAL, &root_entry, 1, right_child_page_num);
+    }
+    else
+    {
+      uint32_t new_page_num;
+      void *new_node = text_new_page(pager, &new_page_num);
+      text_node_build(new_node, NODE_TEXT_LEAF, entries + m, num_entries - m, next_leaf);
+      text_node_build(node, NODE_TEXT_LEAF, entries, m, new_page_num);
+      text_internal_insert(pager, path, path_index, depth - 1, separator, separator_size, page_num, new_page_num);
+    }
+  }
+  free(scratch);
+  free(entries);
+  return true;
+}
+
+// 沿查找路径找到 page_num 的前一个叶子 (左侧兄弟子树中的最右叶子), 将其从叶子链表中摘除
+static void text_leaf_unlink(Pager *pager, uint32_t page_num, uint32_t *path, uint32_t *path_index, int32_t depth)
+{
+  // 路径上最深的一个不是从最左孩子进入的祖先
+  while (depth > 0 && path_index[depth - 1] == 0)
+  {
+    depth--;
+  }
+  if (depth == 0)
+  {
+    return; // 最左叶子, 没有前一个叶子
+  }
+
+  void *node = get_page(pager, page_num);
+  uint32_t cur_page_num = text_node_child(get_page(pager, path[depth - 1]), path_index[depth - 1] - 1);
+  void *cur = get_page(pager, cur_page_num);
+  while (get_node_type(cur) == NODE_TEXT_INTERNAL)
+  {
+    cur_page_num = *text_node_right(cur);
+    cur = get_page(pager, cur_page_num);
+  }
+  pager_mark_dirty(pager, cur_page_num);
+  *text_node_right(cur) = *text_node_right(node);
+}
+
+// 根节点只剩 right child 时将其上提为根
+static void text_collapse_root(Pager *pager, uint32_t root_page_num)
+{
+  void *root = get_page_for_write(pager, root_page_num);
+  while (get_node_type(root) == NODE_TEXT_INTERNAL && *text_node_num_cells(root) == 0)
+  {
+    uint32_t child_page_num = *text_node_right(root);
+    memcpy(root, get_page(pager, child_page_num), PAGE_SIZE);
+    set_node_is_root(root, true);
+    pager_free_page(pager, child_page_num);
+    if (text_tree_is_primary(pager, root_page_num))
+    {
+      pager_header_for_write(pager)->tree_height -= 1;
+    }
+  }
+}
+
+// 移除 path[depth] 中下标为 path_index[depth] 的孩子, 节点被删空时继续向上移除
+static void text_internal_remove(Pager *pager, uint32_t root_page_num, uint32_t *path, uint32_t *path_index, int32_t depth)
+{
+  uint32_t page_num = path[depth];
+  uint32_t index = path_index[depth];
+  void *node = get_page_for_write(pager, page_num);
+  uint32_t num_cells = *text_node_num_cells(node);
+
+  if (num_cells == 0)
+  {
+    if (page_num == root_page_num)
+    {
+      text_node_init(node, NODE_TEXT_LEAF);
+      if (text_tree_is_primary(pager, root_page_num))
+      {
+        pager_header_for_write(pager)->tree_height = 1;
+      }
+      return;
+    }
+    text_internal_remove(pager, root_page_num, path, path_index, depth - 1);
+    pager_free_page(pager, page_num);
+    return;
+  }
+
+  if (index == num_cells)
+  {
+    *text_node_right(node) = text_node_child(node, num_cells - 1);
+    index = num_cells - 1;
+  }
+  text_node_remove_cell(node, index);
+
+  if (page_num == root_page_num)
+  {
+    text_collapse_root(pager, root_page_num);
+  }
+}
+
+bool text_tree_delete(Pager *pager, uint32_t root_page_num, const void *key, uint32_t key_size)
+{
+  uint32_t path[TEXT_TREE_MAX_DEPTH];
+  uint32_t path_index[TEXT_TREE_MAX_DEPTH];
+  int32_t depth = 0;
+
+  uint32_t page_num = root_page_num;
+  void *node = get_page(pager, page_num);
+  while (get_node_type(node) == NODE_TEXT_INTERNAL)
+  {
+    uint32_t index = text_node_find_child(node, key, key_size);
+    path[depth] = page_num;
+    path_index[depth++] = index;
+    page_num = text_node_child(node, index);
+    node = get_page(pager, page_num);
+  }
+
+  bool found;
+  uint32_t index = text_node_search(node, key, key_size, &found);
+  if (!found)
+  {
+    return false;
+  }
+
+  // 只删除偏移, cell 占用的空间在下次重建节点时回收
+  pager_mark_dirty(pager, page_num);
+  text_node_remove_cell(node, index);
+  if (*text_node_num_cells(node) == 0 && page_num != root_page_num)
+  {
+    text_leaf_unlink(pager, page_num, path, path_index, depth);
+    text_internal_remove(pager, root_page_num, path, path_index, depth - 1);
+    pager_free_page(pager, page_num);
+  }
+  return true;
+}
+
+void text_tree_free(Pager *pager, uint32_t root_page_num)
+{
+  void *node = get_page(pager, root_page_num);
+  if (!text_node_is_leaf(node))
+  {
+    uint32_t num_cells = *text_node_num_cells(node);
+    for (uint32_t i = 0; i <= num_cells; i++)
+    {
+      text_tree_free(pager, text_node_child(node, i));
+    }
+  }
+  pager_free_page(pager, root_page_num);
+}
+
+static void *text_tree_find_leaf(Pager *pager, uint32_t root_page_num, const void *key, uint32_t key_size,
+                                 uint32_t *page_num)
+{
+  *page_num = root_page_num;
+  void *node = get_page(pager, *page_num);
+  while (get_node_type(node) == NODE_TEXT_INTERNAL)
+  {
+    *page_num = text_node_child(node, text_node_find_child(node, key, key_size));
+    node = get_page(pager, *page_num);
+  }
+  return node;
+}
+
+int32_t text_tree_get(Pager *pager, uint32_t root_page_num, const void *key, uint32_t key_size, void *value)
+{
+  uint32_t page_num;
+  void *node = text_tree_find_leaf(pager, root_page_num, key, key_size, &page_num);
+  bool found;
+  uint32_t index = text_node_search(node, key, key_size, &found);
+  if (!found)
+  {
+    return -1;
+  }
+  const uint8_t *cell_value;
+  uint32_t value_size = text_leaf_value(node, index, &cell_value);
+  memcpy(value, cell_value, value_size);
+  return value_size;
+}
+
+// 越过当前叶子末尾时跳到下一个叶子
+static void text_cursor_normalize(TextCursor *cursor)
+{
+  void *node = get_page(cursor->pager, cursor->page_num);
+  while (cursor->cell_num >= *text_node_num_cells(node))
+  {
+    uint32_t next_page_num = *text_node_right(node);
+    if (next_page_num == 0)
+    {
+      cursor->end_of_tree = true;
+      return;
+    }
+    cursor->page_num = next_page_num;
+    cursor->cell_num = 0;
+    node = get_page(cursor->pager, next_page_num);
+  }
+}
+
+void text_tree_seek(Pager *pager, uint32_t root_page_num, const void *key, uint32_t key_size, TextCursor *cursor)
+{
+  bool found;
+  cursor->pager = pager;
+  void *node = text_tree_find_leaf(pager, root_page_num, key, key_size, &cursor->page_num);
+  cursor->cell_num = text_node_search(node, key, key_size, &found);
+  cursor->end_of_tree = false;
+  text_cursor_normalize(cursor);
+}
+
+void text_tree_start(Pager *pager, uint32_t root_page_num, TextCursor *cursor)
+{
+  text_tree_seek(pager, root_page_num, "", 0, cursor);
+}
+
+void text_cursor_advance(TextCursor *cursor)
+{
+  cursor->cell_num += 1;
+  text_cursor_normalize(cursor);
+}
+
+uint32_t text_cursor_key(TextCursor *cursor, void *key)
+{
+  void *node = get_page(cursor->pager, cursor->page_num);
+  uint32_t prefix_size = *text_node_prefix_size(node);
+  const uint8_t *suffix;
+  uint32_t suffix_size = text_cell_suffix(node, cursor->cell_num, &suffix);
+  memcpy(key, text_node_prefix(node), prefix_size);
+  memcpy(key + prefix_size, suffix, suffix_size);
+  return prefix_size + suffix_size;
+}
+
+void *text_cursor_value(TextCursor *cursor, uint32_t *value_size)
+{
+  void *node = get_page(cursor->pager, cursor->page_num);
+  const uint8_t *value;
+  *value_size = text_leaf_value(node, cursor->cell_num, &value);
+  return (void *)value;
+}
+
+static void print_text_key(void *node, uint32_t cell_num)
+{
+  const uint8_t *suffix;
+  uint32_t suffix_size = text_cell_suffix(node, cell_num, &suffix);
+  printf("%.*s%.*s\n", *text_node_prefix_size(node), text_node_prefix(node), suffix_size, suffix);
+}
+
+void print_text_tree(Pager *pager, uint32_t page_num, uint32_t indentation_level)
+{
+  void *node = get_page(pager, page_num);
+  uint32_t num_cells = *text_node_num_cells(node);
+  indent(indentation_level);
+  if (text_node_is_leaf(node))
+  {
+    printf("- text leaf (size %d, prefix %d)\n", num_cells, *text_node_prefix_size(node));
+    for (uint32_t i = 0; i < num_cells; i++)
+    {
+      indent(indentation_level + 1);
+      printf("- ");
+      print_text_key(node, i);
+    }
+    return;
+  }
+
+  printf("- text internal (size %d, prefix %d)\n", num_cells, *text_node_prefix_size(node));
+  for (uint32_t i = 0; i < num_cells; i++)
+  {
+    print_text_tree(pager, text_node_child(node, i), indentation_level + 1);
+    indent(indentation_level + 1);
+    printf("- key ");
+    print_text_key(node, i);
+  }
+  print_text_tree(pager, *text_node_right(node), indentation_level + 1);
+}
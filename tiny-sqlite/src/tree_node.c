@@ -1,4 +1,7 @@
 #include "../include/tree_node.h"
+#include "../include/stats.h"
+#include "../include/overflow.h"
+#include "../include/hash_index.h"
 
 
 NodeType get_node_type(void *node)
@@ -31,26 +34,43 @@ uint32_t* node_parent(void* node) {
 */
 void create_new_root(Table *table, uint32_t right_page_num)
 {
-  void *root = get_page(table->pager, table->root_page_num);
-  void *right_child = get_page(table->pager, right_page_num);
+  STATS_INC(tree, root_splits);
+  pager_header_for_write(table->pager)->tree_height += 1;
+  void *root = get_page_for_write(table->pager, table->root_page_num);
+  void *right_child = get_page_for_write(table->pager, right_page_num);
 
   uint32_t left_child_page_num = get_unused_page_num(table->pager);
-  void *left_child = get_page(table->pager, left_child_page_num);
+  void *left_child = get_page_for_write(table->pager, left_child_page_num);
 
   // 申请空白的页面 left_child，并将原root页面中的内容复制给 left_child
   // 原 root 已经分裂出了 right_page_num
   memcpy(left_child, root, PAGE_SIZE);
   set_node_is_root(left_child, false);
+  if (get_node_type(left_child) == NODE_INTERNAL)
+  {
+    // 原 root 为内部节点时, 其孩子的父节点改为 left_child
+    for (uint32_t i = 0; i <= *internal_node_num_keys(left_child); i++)
+    {
+      void *child = get_page_for_write(table->pager, *internal_node_child(left_child, i));
+      *node_parent(child) = left_child_page_num;
+    }
+  }
 
   // 更新 root 节点信息
   initial_internal_node(root);
   set_node_is_root(root, true);
   *internal_node_num_keys(root) = 1;
   *internal_node_child(root, 0) = left_child_page_num;        // 设置首个cell 的 child 页号
-  *internal_node_key(root, 0) = get_node_max_key(left_child); // 设置首个cell 的 key 值 = 左叶子上最大值
+  *internal_node_key(root, 0) = get_node_max_key(table->pager, left_child); // 设置首个cell 的 key 值 = 左子树最大值
   *internal_node_right_child(root) = right_page_num;          // 设置右侧 child 的页号
   *node_parent(left_child) = table->root_page_num;
   *node_parent(right_child) = table->root_page_num;
+
+  if (get_node_type(left_child) == NODE_LEAF && hash_index_enabled(table->pager))
+  {
+    // 原根叶子中的 cell 整体移到了 left_child
+    hash_index_put_leaf(table->pager, left_child_page_num);
+  }
 }
 
 void set_node_type(void *node, NodeType type)
@@ -70,7 +90,7 @@ void *leaf_node_cell(void *node, uint32_t cell_num)
   return node + LEAF_NODE_HEADER_SIZE + cell_num * LEAF_NODE_CELL_SIZE;
 }
 
-uint32_t *leaf_node_key(void *node, uint32_t cell_num)
+uint64_t *leaf_node_key(void *node, uint32_t cell_num)
 {
   return leaf_node_cell(node, cell_num);
 }
@@ -82,7 +102,45 @@ uint32_t *leaf_node_next_leaf(void *node)
 
 void *leaf_node_value(void *node, uint32_t cell_num)
 {
-  return leaf_node_cell(node, cell_num) + LEAF_NODE_KEY_SIZE;
+  return leaf_node_cell(node, cell_num) + LEAF_NODE_VALUE_OFFSET;
+}
+
+uint32_t *leaf_node_payload_size(void *node, uint32_t cell_num)
+{
+  return leaf_node_cell(node, cell_num) + LEAF_NODE_PAYLOAD_SIZE_OFFSET;
+}
+
+uint32_t *leaf_node_overflow(void *node, uint32_t cell_num)
+{
+  return leaf_node_cell(node, cell_num) + LEAF_NODE_OVERFLOW_OFFSET;
+}
+
+void leaf_node_write_cell(Pager *pager, void *node, uint32_t cell_num, uint64_t key, Row *value)
+{
+  uint8_t payload[ROW_SIZE];
+  uint32_t size = serialize_row(value, payload);
+  uint32_t inline_size = size < LEAF_NODE_VALUE_SIZE ? size : LEAF_NODE_VALUE_SIZE;
+
+  *leaf_node_key(node, cell_num) = key;
+  *leaf_node_payload_size(node, cell_num) = size;
+  memcpy(leaf_node_value(node, cell_num), payload, inline_size);
+  *leaf_node_overflow(node, cell_num) = overflow_write(pager, payload + inline_size, size - inline_size);
+}
+
+uint32_t leaf_node_read_payload(Pager *pager, void *node, uint32_t cell_num, void *buffer, uint32_t size)
+{
+  uint32_t payload_size = *leaf_node_payload_size(node, cell_num);
+  if (size > payload_size)
+  {
+    size = payload_size;
+  }
+  uint32_t inline_size = size < LEAF_NODE_VALUE_SIZE ? size : LEAF_NODE_VALUE_SIZE;
+  memcpy(buffer, leaf_node_value(node, cell_num), inline_size);
+  if (size > inline_size)
+  {
+    overflow_read(pager, *leaf_node_overflow(node, cell_num), buffer + inline_size, size - inline_size);
+  }
+  return size;
 }
 
 void initial_leaf_node(void *node)
@@ -100,7 +158,7 @@ void initial_internal_node(void *node)
   *leaf_node_num_cells(node) = 0;
 }
 
-Cursor *leaf_node_find(Table *table, uint32_t page_num, uint32_t key)
+Cursor *leaf_node_find(Table *table, uint32_t page_num, uint64_t key)
 {
   void *node = get_page(table->pager, page_num);
   uint32_t num_cells = *leaf_node_num_cells(node);
@@ -114,7 +172,7 @@ Cursor *leaf_node_find(Table *table, uint32_t page_num, uint32_t key)
   while (left_index != right_index)
   {
     uint32_t mid_index = (left_index + right_index) / 2;
-    uint32_t key_mid = *leaf_node_key(node, mid_index);
+    uint64_t key_mid = *leaf_node_key(node, mid_index);
     if (key == key_mid)
     {
       cursor->cell_num = mid_index;
@@ -133,9 +191,10 @@ Cursor *leaf_node_find(Table *table, uint32_t page_num, uint32_t key)
   return cursor;
 }
 
-void leaf_node_insert(Cursor *cursor, uint32_t key, Row *value)
+void leaf_node_insert(Cursor *cursor, uint64_t key, Row *value)
 {
-  void *node = get_page(cursor->table->pager, cursor->page_num);
+  table_key_inserted(cursor->table, key);
+  void *node = get_page_for_write(cursor->table->pager, cursor->page_num);
   uint32_t num_cells = *leaf_node_num_cells(node);
   if (num_cells >= LEAF_NODE_MAX_CELLS)
   {
@@ -152,8 +211,11 @@ void leaf_node_insert(Cursor *cursor, uint32_t key, Row *value)
     }
   }
   *(leaf_node_num_cells(node)) += 1;
-  *(leaf_node_key(node, cursor->cell_num)) = key;
-  serialize_row(value, leaf_node_value(node, cursor->cell_num));
+  leaf_node_write_cell(cursor->table->pager, node, cursor->cell_num, key, value);
+  if (hash_index_enabled(cursor->table->pager))
+  {
+    hash_index_put(cursor->table->pager, key, cursor->page_num);
+  }
 }
 
 /*
@@ -167,37 +229,44 @@ void leaf_node_insert(Cursor *cursor, uint32_t key, Row *value)
             /   |    \
 {1:v1, 3:v3}   {5:v5}  {12:v12}
 */
-void leaf_node_split_and_insert(Cursor *cursor, uint32_t key, Row *value)
+void leaf_node_split_and_insert(Cursor *cursor, uint64_t key, Row *value)
 {
-  void *old_node = get_page(cursor->table->pager, cursor->page_num);
-  uint32_t old_max = get_node_max_key(old_node);
+  STATS_INC(tree, leaf_splits);
+  void *old_node = get_page_for_write(cursor->table->pager, cursor->page_num);
+  uint64_t old_max = get_node_max_key(cursor->table->pager, old_node);
+
+  // 在最右叶子末尾追加 (单调递增 key): 按 90/10 分裂, 左侧保持接近写满
+  bool append = (cursor->cell_num == LEAF_NODE_MAX_CELLS && *leaf_node_next_leaf(old_node) == 0);
+  uint32_t left_count = append ? LEAF_NODE_APPEND_LEFT_SPLIT_COUNT : LEAF_NODE_LEFT_SPLIT_COUNT;
 
   // 获取首个未被使用的 page 索引
   uint32_t new_page_num = get_unused_page_num(cursor->table->pager); 
-  void *new_node = get_page(cursor->table->pager, new_page_num);
+  void *new_node = get_page_for_write(cursor->table->pager, new_page_num);
   initial_leaf_node(new_node);
   *node_parent(new_node) = *node_parent(old_node); // 为分裂出的新页设置同一父节点
   *leaf_node_next_leaf(new_node) = *leaf_node_next_leaf(old_node);
   *leaf_node_next_leaf(old_node) = new_page_num;
+  if (*leaf_node_next_leaf(new_node) == 0)
+  {
+    cursor->table->pager->rightmost_leaf = new_page_num;
+  }
 
   /*
-    LEAF_NODE_MAX_CELLS = 13
-    当 cursor->cell_num = 13 时，0-6 会映射到 old_node; 7-13 会映射到 new_node上, i = [0, 6];
-
+    原有 cell 加上新 cell 共 LEAF_NODE_MAX_CELLS + 1 个, 从后往前逐个放置:
+    下标 [0, left_count) 留在 old_node, [left_count, MAX] 写入 new_node 的 [0, MAX + 1 - left_count)
   */
   for (int32_t i = LEAF_NODE_MAX_CELLS; i >= 0; i--)
   {
-    void *destination_node = (i >= LEAF_NODE_LEFT_SPLIT_COUNT) ? new_node : old_node;
+    void *destination_node = (i >= left_count) ? new_node : old_node;
 
-    uint32_t index = i % LEAF_NODE_LEFT_SPLIT_COUNT; // 写入新页的 cell 索引
+    uint32_t index = (i >= left_count) ? i - left_count : i; // 写入目标页的 cell 索引
     void *des_cell_addr = leaf_node_cell(destination_node, index);
 
-    printf("cur i = %d\t, cursor->cell_num = %d\t, index = %d\n", i, cursor->cell_num, index);
+    DEBUGS("cur i = %d\t, cursor->cell_num = %d\t, index = %d", i, cursor->cell_num, index);
 
     if (i == cursor->cell_num)
     {
-      serialize_row(value, leaf_node_value(destination_node, index));
-      *leaf_node_key(destination_node, index) = key;
+      leaf_node_write_cell(cursor->table->pager, destination_node, index, key, value);
     }
     else if (i > cursor->cell_num)
     {
@@ -211,8 +280,18 @@ void leaf_node_split_and_insert(Cursor *cursor, uint32_t key, Row *value)
     }
   }
   // 更新 新 & 旧 页的cell 数
-  *(leaf_node_num_cells(old_node)) = (uint32_t)LEAF_NODE_LEFT_SPLIT_COUNT;
-  *(leaf_node_num_cells(new_node)) = (uint32_t)LEAF_NODE_RIGHT_SPLIT_COUNT;
+  *(leaf_node_num_cells(old_node)) = left_count;
+  *(leaf_node_num_cells(new_node)) = LEAF_NODE_MAX_CELLS + 1 - left_count;
+
+  if (hash_index_enabled(cursor->table->pager))
+  {
+    // 右半部分移到了新页, 新 key 可能落在任意一侧
+    hash_index_put_leaf(cursor->table->pager, new_page_num);
+    if (cursor->cell_num < left_count)
+    {
+      hash_index_put(cursor->table->pager, key, cursor->page_num);
+    }
+  }
 
   if (is_node_root(old_node))
   {
@@ -223,13 +302,82 @@ void leaf_node_split_and_insert(Cursor *cursor, uint32_t key, Row *value)
   {
     // 当前节点非根节点
     uint32_t parent_page_num = *node_parent(old_node); 
-    uint32_t new_max = get_node_max_key(old_node); // 这里最大key是根据 cell 数计算出来的
-    void* parent = get_page(cursor->table->pager, parent_page_num);
+    uint64_t new_max = get_node_max_key(cursor->table->pager, old_node); // 这里最大key是根据 cell 数计算出来的
+    void* parent = get_page_for_write(cursor->table->pager, parent_page_num);
 
     // 更新 父节点的 key
     update_internal_node_key(parent, old_max, new_max);
     internal_node_insert(cursor->table, parent_page_num, new_page_num);
-    exit(EXIT_FAILURE);
+  }
+}
+
+// 经父节点找到 page_num 的前一个叶子 (左侧兄弟子树中的最右叶子), 将其从叶子链表中摘除
+static void leaf_node_unlink(Table *table, uint32_t page_num)
+{
+  Pager *pager = table->pager;
+  void *node = get_page(pager, page_num);
+
+  // 向上找到第一个不是从最左孩子进入的祖先
+  uint32_t child_page_num = page_num;
+  void *child = node;
+  void *parent = NULL;
+  uint32_t index = 0;
+  while (!is_node_root(child))
+  {
+    uint32_t parent_page_num = *node_parent(child);
+    parent = get_page(pager, parent_page_num);
+    index = internal_node_child_index(parent, child_page_num);
+    if (index > 0)
+    {
+      break;
+    }
+    child_page_num = parent_page_num;
+    child = parent;
+  }
+  if (index == 0)
+  {
+    return; // 最左叶子, 没有前一个叶子
+  }
+
+  uint32_t cur_page_num = *internal_node_child(parent, index - 1);
+  void *cur = get_page(pager, cur_page_num);
+  while (get_node_type(cur) == NODE_INTERNAL)
+  {
+    cur_page_num = *internal_node_right_child(cur);
+    cur = get_page(pager, cur_page_num);
+  }
+  pager_mark_dirty(pager, cur_page_num);
+  *leaf_node_next_leaf(cur) = *leaf_node_next_leaf(node);
+}
+
+/*
+  删除游标所指的 cell:
+  不做节点合并, 只有叶子被删空时才将其从树中摘除并放回空闲链表,
+  父节点 key 作为子树上界仍然有效, 因此无需更新
+*/
+void leaf_node_delete(Cursor *cursor)
+{
+  Table *table = cursor->table;
+  void *node = get_page_for_write(table->pager, cursor->page_num);
+  uint32_t num_cells = *leaf_node_num_cells(node);
+
+  table_key_deleted(table, *leaf_node_key(node, cursor->cell_num));
+  if (hash_index_enabled(table->pager))
+  {
+    hash_index_delete(table->pager, *leaf_node_key(node, cursor->cell_num));
+  }
+  overflow_free(table->pager, *leaf_node_overflow(node, cursor->cell_num));
+  for (uint32_t i = cursor->cell_num; i + 1 < num_cells; i++)
+  {
+    memcpy(leaf_node_cell(node, i), leaf_node_cell(node, i + 1), LEAF_NODE_CELL_SIZE);
+  }
+  *leaf_node_num_cells(node) = num_cells - 1;
+
+  if (num_cells - 1 == 0 && !is_node_root(node))
+  {
+    leaf_node_unlink(table, cursor->page_num);
+    internal_node_remove_child(table, *node_parent(node), cursor->page_num);
+    pager_free_page(table->pager, cursor->page_num);
   }
 }
 
@@ -240,8 +388,8 @@ void print_leaf_node(void *node)
 
   for (uint32_t i = 0; i < num_cells; ++i)
   {
-    uint32_t key = *leaf_node_key(node, i);
-    printf("\tkey = %d\n", key);
+    uint64_t key = *leaf_node_key(node, i);
+    printf("\tkey = %lu\n", key);
   }
 }
 
@@ -282,19 +430,19 @@ uint32_t *internal_node_child(void *node, uint32_t child_num)
   }
 }
 
-uint32_t*internal_node_key(void *node, uint32_t key_num)
+uint64_t *internal_node_key(void *node, uint32_t key_num)
 {
   return (void*)internal_node_cell(node, key_num) + INTERNAL_NODE_CHILD_SIZE;
 }
 
-uint32_t internal_node_find_child(void* node, uint32_t key) 
+uint32_t internal_node_find_child(void* node, uint64_t key) 
 {
   uint32_t num_keys = *internal_node_num_keys(node);
   uint32_t left_index = 0, right_index = num_keys;
   while (left_index != right_index)
   {
     uint32_t index = (left_index + right_index) / 2;
-    uint32_t key_index = *internal_node_key(node, index);
+    uint64_t key_index = *internal_node_key(node, index);
     if (key_index >= key)
     {
       right_index = index;
@@ -307,7 +455,7 @@ uint32_t internal_node_find_child(void* node, uint32_t key)
   return left_index;
 }
 
-Cursor *internal_node_find(Table *table, uint32_t page_num, uint32_t key)
+Cursor *internal_node_find(Table *table, uint32_t page_num, uint64_t key)
 {
   void* node = get_page(table->pager, page_num);
   uint32_t child_index = internal_node_find_child(node, key);
@@ -316,32 +464,33 @@ Cursor *internal_node_find(Table *table, uint32_t page_num, uint32_t key)
   switch (get_node_type(child)) {
     case NODE_LEAF:
       return leaf_node_find(table, child_page_num, key);
-    case NODE_INTERNAL:
+    default:
       return internal_node_find(table, child_page_num, key);
   }
 }
 
 void internal_node_insert(Table* table, uint32_t parent_page_num, uint32_t child_page_num) {
-  void* parent = get_page(table->pager, parent_page_num);
-  void* child = get_page(table->pager, child_page_num);
-  uint32_t child_max_key = get_node_max_key(child);
+  void* parent = get_page_for_write(table->pager, parent_page_num);
+  void* child = get_page_for_write(table->pager, child_page_num);
+  uint64_t child_max_key = get_node_max_key(table->pager, child);
   uint32_t index = internal_node_find_child(parent, child_max_key);
 
   uint32_t original_num_keys = *internal_node_num_keys(parent);
-  *internal_node_num_keys(parent) = original_num_keys + 1;
-
   if (original_num_keys >= INTERNAL_NODE_MAX_CELLS) {
-    printf("Need to implement splitting internal node\n");
-    exit(EXIT_FAILURE);
+    internal_node_split_and_insert(table, parent_page_num, child_page_num);
+    return;
   }
+  *internal_node_num_keys(parent) = original_num_keys + 1;
+  *node_parent(child) = parent_page_num;
 
   uint32_t right_child_page_num = *internal_node_right_child(parent);
   void* right_child = get_page(table->pager, right_child_page_num);
+  uint64_t right_child_max_key = get_node_max_key(table->pager, right_child);
 
-  if (child_max_key > get_node_max_key(right_child)) {
+  if (child_max_key > right_child_max_key) {
     /* Replace right child */
     *internal_node_child(parent, original_num_keys) = right_child_page_num;
-    *internal_node_key(parent, original_num_keys) = get_node_max_key(right_child);
+    *internal_node_key(parent, original_num_keys) = right_child_max_key;
     *internal_node_right_child(parent) = child_page_num;
   } else {
     /* Make room for the new cell */
@@ -355,20 +504,212 @@ void internal_node_insert(Table* table, uint32_t parent_page_num, uint32_t child
   }
 }
 
-void update_internal_node_key(void* node, uint32_t old_key, uint32_t new_key) 
+// 用 children[0..count) 及对应的 keys 重建内部节点 page_num
+static void internal_node_fill(Pager *pager, uint32_t page_num, uint32_t *children, uint64_t *keys, uint32_t count)
+{
+  void *node = get_page_for_write(pager, page_num);
+  *internal_node_num_keys(node) = count - 1;
+  for (uint32_t i = 0; i + 1 < count; i++)
+  {
+    *internal_node_child(node, i) = children[i];
+    *internal_node_key(node, i) = keys[i];
+  }
+  *internal_node_right_child(node) = children[count - 1];
+
+  for (uint32_t i = 0; i < count; i++)
+  {
+    *node_parent(get_page_for_write(pager, children[i])) = page_num;
+  }
+}
+
+// 从 page_num 到根的每一层都是父节点的 right child, 即该节点位于树的最右路径上
+static bool internal_node_is_rightmost(Pager *pager, uint32_t page_num)
+{
+  void *node = get_page(pager, page_num);
+  while (!is_node_root(node))
+  {
+    uint32_t parent_page_num = *node_parent(node);
+    void *parent = get_page(pager, parent_page_num);
+    if (*internal_node_right_child(parent) != page_num)
+    {
+      return false;
+    }
+    page_num = parent_page_num;
+    node = parent;
+  }
+  return true;
+}
+
+/*
+  内部节点已满时分裂:
+  1. 按 key 顺序收集原有 MAX + 1 个孩子以及新孩子;
+  2. 前一半留在原节点, 后一半写入新申请的节点;
+     新孩子追加在最右内部节点末尾时 (单调递增 key) 与叶子一样按 90/10 划分, 左侧保持接近写满;
+  3. 原节点为根时创建新根, 否则把新节点插入父节点 (可能继续向上分裂)
+*/
+void internal_node_split_and_insert(Table *table, uint32_t page_num, uint32_t child_page_num)
+{
+  STATS_INC(tree, internal_splits);
+  Pager *pager = table->pager;
+  void *old_node = get_page(pager, page_num);
+  uint32_t num_keys = *internal_node_num_keys(old_node);
+  uint64_t child_max_key = get_node_max_key(pager, get_page(pager, child_page_num));
+
+  // 扇出随页大小变化 (64KB 页约 5k 个 cell), 临时数组放在堆上
+  uint32_t *children = malloc((INTERNAL_NODE_MAX_CELLS + 2) * sizeof(uint32_t));
+  uint64_t *keys = malloc((INTERNAL_NODE_MAX_CELLS + 2) * sizeof(uint64_t));
+  uint32_t total = 0;
+  bool inserted = false;
+  for (uint32_t i = 0; i <= num_keys; i++)
+  {
+    uint32_t cur_page_num = *internal_node_child(old_node, i);
+    uint64_t cur_key = (i < num_keys) ? *internal_node_key(old_node, i)
+                                      : get_node_max_key(pager, get_page(pager, cur_page_num));
+    if (!inserted && child_max_key < cur_key)
+    {
+      children[total] = child_page_num;
+      keys[total++] = child_max_key;
+      inserted = true;
+    }
+    children[total] = cur_page_num;
+    keys[total++] = cur_key;
+  }
+  if (!inserted)
+  {
+    children[total] = child_page_num;
+    keys[total++] = child_max_key;
+  }
+
+  bool append = !inserted && internal_node_is_rightmost(pager, page_num);
+  uint32_t left_count = append ? INTERNAL_NODE_APPEND_LEFT_SPLIT_COUNT : total / 2;
+  uint32_t new_page_num = get_unused_page_num(pager);
+  void *new_node = get_page_for_write(pager, new_page_num);
+  initial_internal_node(new_node);
+
+  internal_node_fill(pager, page_num, children, keys, left_count);
+  internal_node_fill(pager, new_page_num, children + left_count, keys + left_count, total - left_count);
+  uint64_t left_max_key = keys[left_count - 1];
+  free(children);
+  free(keys);
+
+  if (is_node_root(old_node))
+  {
+    create_new_root(table, new_page_num);
+  }
+  else
+  {
+    uint32_t parent_page_num = *node_parent(old_node);
+    void *parent = get_page_for_write(pager, parent_page_num);
+    uint32_t index = internal_node_child_index(parent, page_num);
+    if (index < *internal_node_num_keys(parent))
+    {
+      *internal_node_key(parent, index) = left_max_key;
+    }
+    internal_node_insert(table, parent_page_num, new_page_num);
+  }
+}
+
+uint32_t internal_node_child_index(void *node, uint32_t child_page_num)
+{
+  uint32_t num_keys = *internal_node_num_keys(node);
+  for (uint32_t i = 0; i <= num_keys; i++)
+  {
+    if (*internal_node_child(node, i) == child_page_num)
+    {
+      return i;
+    }
+  }
+  printf("error: page %d is not a child of this node\n", child_page_num);
+  exit(EXIT_FAILURE);
+}
+
+// 根节点只剩一个孩子时, 将孩子上提为根, 树高减一 (孩子同样只有一个孩子时继续上提)
+static void collapse_root(Table *table)
+{
+  void *root = get_page_for_write(table->pager, table->root_page_num);
+  while (get_node_type(root) == NODE_INTERNAL && *internal_node_num_keys(root) == 0)
+  {
+    uint32_t child_page_num = *internal_node_right_child(root);
+    void *child = get_page(table->pager, child_page_num);
+
+    memcpy(root, child, PAGE_SIZE);
+    set_node_is_root(root, true);
+    if (get_node_type(root) == NODE_INTERNAL)
+    {
+      for (uint32_t i = 0; i <= *internal_node_num_keys(root); i++)
+      {
+        *node_parent(get_page_for_write(table->pager, *internal_node_child(root, i))) = table->root_page_num;
+      }
+    }
+    else if (hash_index_enabled(table->pager))
+    {
+      hash_index_put_leaf(table->pager, table->root_page_num);
+    }
+    pager_free_page(table->pager, child_page_num);
+    pager_header_for_write(table->pager)->tree_height -= 1;
+  }
+}
+
+void internal_node_remove_child(Table *table, uint32_t page_num, uint32_t child_page_num)
+{
+  void *node = get_page_for_write(table->pager, page_num);
+  uint32_t num_keys = *internal_node_num_keys(node);
+  uint32_t index = internal_node_child_index(node, child_page_num);
+
+  if (num_keys == 0)
+  {
+    if (is_node_root(node))
+    {
+      initial_leaf_node(node);
+      set_node_is_root(node, true);
+      pager_header_for_write(table->pager)->tree_height = 1;
+      return;
+    }
+    // 最后一个孩子也被删除, 该内部节点随之从父节点中摘除
+    internal_node_remove_child(table, *node_parent(node), page_num);
+    pager_free_page(table->pager, page_num);
+    return;
+  }
+
+  if (index == num_keys)
+  {
+    *internal_node_right_child(node) = *internal_node_child(node, num_keys - 1);
+  }
+  else
+  {
+    for (uint32_t i = index; i + 1 < num_keys; i++)
+    {
+      memcpy(internal_node_cell(node, i), internal_node_cell(node, i + 1), INTERNAL_NODE_CELL_SIZE);
+    }
+  }
+  *internal_node_num_keys(node) = num_keys - 1;
+
+  if (num_keys - 1 == 0 && is_node_root(node))
+  {
+    collapse_root(table);
+  }
+}
+
+void update_internal_node_key(void* node, uint64_t old_key, uint64_t new_key) 
 {
   uint32_t old_child_index = internal_node_find_child(node, old_key);
-  *internal_node_key(node, old_child_index) = new_key;
+  if (old_child_index < *internal_node_num_keys(node))
+  {
+    // right child 没有对应的 key
+    *internal_node_key(node, old_child_index) = new_key;
+  }
 }
 
-uint32_t get_node_max_key(void *node)
+uint64_t get_node_max_key(Pager *pager, void *node)
 {
   switch (get_node_type(node))
   {
   case NODE_INTERNAL:
-    return *internal_node_key(node, *internal_node_num_keys(node) - 1);
+    return get_node_max_key(pager, get_page(pager, *internal_node_right_child(node)));
   case NODE_LEAF:
     return *leaf_node_key(node, *leaf_node_num_cells(node) - 1);
+  default:
+    return 0;
   }
 }
 
@@ -385,7 +726,7 @@ void print_tree(Pager *pager, uint32_t page_num, uint32_t indentation_level)
     for (uint32_t i = 0; i < num_keys; i++)
     {
       indent(indentation_level + 1);
-      printf("- %d\n", *leaf_node_key(node, i));
+      printf("- %lu\n", *leaf_node_key(node, i));
     }
     break;
   case (NODE_INTERNAL):
@@ -398,11 +739,13 @@ void print_tree(Pager *pager, uint32_t page_num, uint32_t indentation_level)
       print_tree(pager, child, indentation_level + 1);
 
       indent(indentation_level + 1);
-      printf("- key %d\n", *internal_node_key(node, i));
+      printf("- key %lu\n", *internal_node_key(node, i));
     }
     child = *internal_node_right_child(node);
     print_tree(pager, child, indentation_level + 1);
     break;
+  default:
+    break;
   }
 }
 
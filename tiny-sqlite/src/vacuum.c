@@ -0,0 +1,277 @@
+#include <libgen.h>
+
+#include "../include/vacuum.h"
+#include "../include/cursor.h"
+#include "../include/tree_node.h"
+#include "../include/stats.h"
+#include "../include/overflow.h"
+#include "../include/page_cache.h"
+#include "../include/hash_index.h"
+#include "../include/secondary_index.h"
+#include "../include/io.h"
+
+#define VACUUM_MAX_LEVELS 32
+
+static bool vacuum_write_page(int fd, uint32_t page_num, void *page)
+{
+  ssize_t bytes_written = io_pwrite(fd, page, PAGE_SIZE, (off_t)page_num * PAGE_SIZE);
+  if (bytes_written != PAGE_SIZE)
+  {
+    ERROR("vacuum write error!");
+    return false;
+  }
+  STATS_INC(pager, page_writes);
+  STATS_ADD(pager, bytes_flushed, bytes_written);
+  return true;
+}
+
+static uint32_t vacuum_overflow_pages(uint32_t payload_size)
+{
+  if (payload_size <= LEAF_NODE_VALUE_SIZE)
+  {
+    return 0;
+  }
+  return (payload_size - LEAF_NODE_VALUE_SIZE + OVERFLOW_PAGE_DATA_SIZE - 1) / OVERFLOW_PAGE_DATA_SIZE;
+}
+
+// 把 cell 的溢出页链表连续复制到新文件 next_page_num 处, 并改写 cell 中的溢出页号
+static bool vacuum_copy_overflow(Pager *pager, int fd, void *node, uint32_t cell_num, uint32_t *next_page_num)
+{
+  uint32_t payload_size = *leaf_node_payload_size(node, cell_num);
+  uint32_t num_pages = vacuum_overflow_pages(payload_size);
+  if (num_pages == 0)
+  {
+    return true;
+  }
+
+  uint8_t data[ROW_SIZE];
+  uint32_t size = payload_size - LEAF_NODE_VALUE_SIZE;
+  overflow_read(pager, *leaf_node_overflow(node, cell_num), data, size);
+  *leaf_node_overflow(node, cell_num) = *next_page_num;
+
+  uint8_t page[PAGE_SIZE_MAX];
+  for (uint32_t i = 0; i < num_pages; i++)
+  {
+    uint32_t chunk = size < OVERFLOW_PAGE_DATA_SIZE ? size : OVERFLOW_PAGE_DATA_SIZE;
+    memset(page, 0, PAGE_SIZE);
+    *(uint32_t *)page = (i + 1 < num_pages) ? *next_page_num + 1 : 0;
+    memcpy(page + OVERFLOW_PAGE_NEXT_SIZE, data + i * OVERFLOW_PAGE_DATA_SIZE, chunk);
+    if (!vacuum_write_page(fd, *next_page_num, page))
+    {
+      return false;
+    }
+    *next_page_num += 1;
+    size -= chunk;
+  }
+  return true;
+}
+
+// 第 group 组孩子的起始下标: count 个孩子均匀分到 groups 个父节点
+static uint32_t vacuum_group_start(uint32_t group, uint32_t count, uint32_t groups)
+{
+  return (uint32_t)(((uint64_t)group * count + groups - 1) / groups);
+}
+
+/*
+  新文件布局:
+  page 0: 文件头;
+  page 1 .. L: 叶子, 按 key 顺序写满;
+  其后: 逐层向上的内部节点, 根;
+  最后: 按 key 顺序排列的溢出页
+*/
+static bool vacuum_write_tree(Table *table, int fd)
+{
+  uint32_t num_rows = 0;
+  Cursor *cursor = table_start(table);
+  while (!cursor->end_of_table)
+  {
+    num_rows += 1;
+    cursor_advance(cursor);
+  }
+  free(cursor);
+
+  // 规划各层节点数以及起始页号
+  uint32_t level_counts[VACUUM_MAX_LEVELS];
+  uint32_t level_first_page[VACUUM_MAX_LEVELS];
+  uint32_t num_levels = 1;
+  level_counts[0] = num_rows ? (num_rows + LEAF_NODE_MAX_CELLS - 1) / LEAF_NODE_MAX_CELLS : 1;
+  level_first_page[0] = 1;
+  while (level_counts[num_levels - 1] > 1)
+  {
+    uint32_t count = level_counts[num_levels - 1];
+    level_counts[num_levels] = (count + INTERNAL_NODE_MAX_CELLS) / (INTERNAL_NODE_MAX_CELLS + 1);
+    level_first_page[num_levels] = level_first_page[num_levels - 1] + count;
+    num_levels += 1;
+  }
+  uint32_t root_page_num = level_first_page[num_levels - 1];
+  uint32_t next_overflow_page_num = root_page_num + 1;
+
+  uint64_t *max_keys = malloc(level_counts[0] * sizeof(uint64_t));
+  void *page = malloc(PAGE_SIZE);
+  bool ok = true;
+
+  // 写叶子层: 顺序扫描, 每 LEAF_NODE_MAX_CELLS 个 cell 写满一页
+  uint32_t num_leaves = level_counts[0];
+  uint32_t parent_groups = num_levels > 1 ? level_counts[1] : 0;
+  cursor = table_start(table);
+  for (uint32_t leaf = 0; leaf < num_leaves && ok; leaf++)
+  {
+    // 旧树的页只在复制单个 cell 时使用, 每写一页叶子解除一次 pin, 大表也不会撑满缓存
+    page_cache_unpin_all();
+    memset(page, 0, PAGE_SIZE);
+    initial_leaf_node(page);
+    if (num_levels == 1)
+    {
+      set_node_is_root(page, true);
+    }
+    else
+    {
+      *node_parent(page) = level_first_page[1] + (uint32_t)((uint64_t)leaf * parent_groups / num_leaves);
+    }
+    *leaf_node_next_leaf(page) = (leaf + 1 < num_leaves) ? level_first_page[0] + leaf + 1 : 0;
+
+    uint32_t num_cells = 0;
+    while (num_cells < LEAF_NODE_MAX_CELLS && !cursor->end_of_table)
+    {
+      void *source = get_page(table->pager, cursor->page_num);
+      memcpy(leaf_node_cell(page, num_cells), leaf_node_cell(source, cursor->cell_num), LEAF_NODE_CELL_SIZE);
+      ok = ok && vacuum_copy_overflow(table->pager, fd, page, num_cells, &next_overflow_page_num);
+      num_cells += 1;
+      cursor_advance(cursor);
+    }
+    *leaf_node_num_cells(page) = num_cells;
+    max_keys[leaf] = num_cells ? *leaf_node_key(page, num_cells - 1) : 0;
+    ok = ok && vacuum_write_page(fd, level_first_page[0] + leaf, page);
+  }
+  free(cursor);
+
+  // 逐层构建内部节点, max_keys 原地替换为本层各节点的最大 key
+  for (uint32_t level = 1; level < num_levels && ok; level++)
+  {
+    uint32_t child_count = level_counts[level - 1];
+    uint32_t groups = level_counts[level];
+    uint32_t upper_groups = level + 1 < num_levels ? level_counts[level + 1] : 0;
+    for (uint32_t group = 0; group < groups && ok; group++)
+    {
+      uint32_t start = vacuum_group_start(group, child_count, groups);
+      uint32_t end = vacuum_group_start(group + 1, child_count, groups);
+
+      memset(page, 0, PAGE_SIZE);
+      initial_internal_node(page);
+      if (level + 1 == num_levels)
+      {
+        set_node_is_root(page, true);
+      }
+      else
+      {
+        *node_parent(page) = level_first_page[level + 1] + (uint32_t)((uint64_t)group * upper_groups / groups);
+      }
+      *internal_node_num_keys(page) = end - start - 1;
+      for (uint32_t i = start; i + 1 < end; i++)
+      {
+        *internal_node_child(page, i - start) = level_first_page[level - 1] + i;
+        *internal_node_key(page, i - start) = max_keys[i];
+      }
+      *internal_node_right_child(page) = level_first_page[level - 1] + end - 1;
+      max_keys[group] = max_keys[end - 1];
+      ok = vacuum_write_page(fd, level_first_page[level] + group, page);
+    }
+  }
+
+  if (ok)
+  {
+    memset(page, 0, PAGE_SIZE);
+    DbHeader *header = page;
+    strncpy(header->magic, DB_HEADER_MAGIC, DB_HEADER_MAGIC_SIZE);
+    header->root_page_num = root_page_num;
+    header->format_version = DB_FORMAT_VERSION;
+    header->page_size = PAGE_SIZE;
+    header->page_count = next_overflow_page_num;
+    header->tree_height = num_levels;
+    header->row_count = num_rows;
+    ok = vacuum_write_page(fd, 0, page);
+  }
+  free(page);
+  free(max_keys);
+  return ok;
+}
+
+// rename 之后同步目录项, 保证替换本身落盘
+static void vacuum_sync_dir(const char *file_name)
+{
+  char *path = strdup(file_name);
+  int dir_fd = open(dirname(path), O_RDONLY);
+  if (dir_fd != -1)
+  {
+    fsync(dir_fd);
+    close(dir_fd);
+  }
+  free(path);
+}
+
+bool db_vacuum(Table *table)
+{
+  if (table->key_type == KEY_TYPE_TEXT)
+  {
+    ERROR("vacuum: text-keyed tables are not supported!");
+    return false;
+  }
+  Pager *pager = table->pager;
+  if (pager->ref_count > 1)
+  {
+    ERROR("vacuum: database is opened by other handles!");
+    return false;
+  }
+  if (pager->backup != NULL)
+  {
+    ERROR("vacuum: a backup is in progress!");
+    return false;
+  }
+  if (pager->shadow != NULL)
+  {
+    ERROR("vacuum: not supported in shadow commit mode!");
+    return false;
+  }
+  size_t name_len = strlen(pager->file_name);
+  char *tmp_name = malloc(name_len + sizeof("-vacuum"));
+  memcpy(tmp_name, pager->file_name, name_len);
+  memcpy(tmp_name + name_len, "-vacuum", sizeof("-vacuum"));
+
+  bool hash_index = hash_index_enabled(pager);
+  const ColumnInfo *index_column = secondary_index_column(pager);
+  uint32_t index_include = pager_header(pager)->index_include;
+  int fd = open(tmp_name, O_RDWR | O_CREAT | O_TRUNC, S_IWUSR | S_IRUSR);
+  if (fd == -1)
+  {
+    ERROR("vacuum: unable to create temp file!");
+    free(tmp_name);
+    return false;
+  }
+
+  bool ok = vacuum_write_tree(table, fd) && io_fsync(fd) == 0;
+  close(fd);
+  if (!ok || rename(tmp_name, pager->file_name) == -1)
+  {
+    ERROR("vacuum failed!");
+    unlink(tmp_name);
+    free(tmp_name);
+    return false;
+  }
+  vacuum_sync_dir(pager->file_name);
+  free(tmp_name);
+
+  // 旧缓存页的内容已全部写入新文件
+  pager_reload(pager);
+  table->root_page_num = pager_header(pager)->root_page_num;
+  if (hash_index)
+  {
+    // 叶子页号全部改变, 索引在新文件中重建
+    hash_index_create(table);
+  }
+  if (index_column)
+  {
+    // 新文件只包含主键树, 二级索引同样重建
+    secondary_index_create(table, index_column, index_include);
+  }
+  return true;
+}
@@ -0,0 +1,710 @@
+#include <sys/wait.h>
+#include <time.h>
+
+#include "../include/io.h"
+#include "../include/page_cache.h"
+#include "../include/statement.h"
+#include "../include/tree_node.h"
+
+/*
+  崩溃恢复压力测试:
+  crash-test [--seeds=N] [--stride=N] [--ops=N]
+  - 按种子生成确定的 insert / delete / select 序列, 同时在内存模型中重放;
+  - 数据库文件的 pwrite / fsync 经过替换的 I/O 层 (见 io.h), 每次写和刷盘都是一个边界,
+    在第 k 个边界处模拟掉电: 上次刷盘之后的每个写随机保留、丢失或只写入前若干个 512 字节扇区;
+  - 每个 k 在子进程中执行, 之后另一个子进程用系统 I/O 打开并检查:
+    树结构 (key 有序、父指针、叶子深度与文件头高度一致、叶子链表), 页没有被重复使用,
+    文件头行数, 以及内容等于最后一次已确认提交或其下一次提交时的模型;
+    再插入若干行并重新打开, 确认恢复后的库可以继续使用;
+  - 最后不注入故障, 分别测量原地写回、影子分页逐条提交、影子分页分组提交的吞吐
+  只有影子分页承诺崩溃一致性, 原地写回只参与吞吐测试
+*/
+
+#define MAX_ID       400
+#define SECTOR_SIZE  512
+#define EXTRA_ROWS   20
+
+typedef enum {
+  OP_INSERT,
+  OP_DELETE,
+  OP_SELECT,
+} OpType;
+
+typedef struct {
+  OpType type;
+  uint32_t id;
+  uint32_t email_len;
+} Op;
+
+typedef struct {
+  bool present[MAX_ID + 1];
+  uint32_t email_len[MAX_ID + 1];
+} Model;
+
+typedef struct {
+  const char *name;
+  CommitMode mode;
+  uint32_t page_size;
+  uint32_t group; // 每 group 条语句提交一次
+} Config;
+
+// 模拟掉电的 I/O 层: 记录上次刷盘之后的写
+typedef struct {
+  int fd;
+  off_t offset;
+  size_t size;
+  uint8_t *old_data;
+  uint8_t *new_data;
+} PendingWrite;
+
+static struct {
+  uint64_t crash_at; // 0 表示不注入
+  uint64_t boundaries;
+  unsigned int seed;
+  PendingWrite *pending;
+  uint32_t num_pending;
+  uint32_t pending_capacity;
+} shim;
+
+static char db_path[64];
+
+static uint64_t now_us()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void shim_clear_pending()
+{
+  for (uint32_t i = 0; i < shim.num_pending; i++)
+  {
+    free(shim.pending[i].old_data);
+    free(shim.pending[i].new_data);
+  }
+  shim.num_pending = 0;
+}
+
+/*
+  掉电: 先撤销上次刷盘之后的全部写, 再按顺序重放其中 "保留" 的写和 "撕裂" 的写的前半部分,
+  同一位置的多次写因此以最后一次落盘的为准
+*/
+static void shim_crash()
+{
+  for (uint32_t i = shim.num_pending; i > 0; i--)
+  {
+    PendingWrite *write = &shim.pending[i - 1];
+    pwrite(write->fd, write->old_data, write->size, write->offset);
+  }
+  for (uint32_t i = 0; i < shim.num_pending; i++)
+  {
+    PendingWrite *write = &shim.pending[i];
+    switch (rand_r(&shim.seed) % 3)
+    {
+    case 0: // 保留
+      pwrite(write->fd, write->new_data, write->size, write->offset);
+      break;
+    case 1: // 丢失
+      break;
+    case 2: // 撕裂
+    {
+      size_t sectors = write->size / SECTOR_SIZE;
+      size_t torn = sectors > 1 ? (1 + rand_r(&shim.seed) % (sectors - 1)) * SECTOR_SIZE : 0;
+      pwrite(write->fd, write->new_data, torn, write->offset);
+      break;
+    }
+    }
+  }
+  _exit(EXIT_SUCCESS);
+}
+
+static void shim_boundary()
+{
+  shim.boundaries += 1;
+  if (shim.boundaries == shim.crash_at)
+  {
+    shim_crash();
+  }
+}
+
+static ssize_t shim_pwrite(int fd, const void *buffer, size_t size, off_t offset)
+{
+  shim_boundary();
+  if (shim.num_pending == shim.pending_capacity)
+  {
+    shim.pending_capacity = shim.pending_capacity ? shim.pending_capacity * 2 : 64;
+    shim.pending = realloc(shim.pending, shim.pending_capacity * sizeof(PendingWrite));
+  }
+  PendingWrite *write = &shim.pending[shim.num_pending++];
+  write->fd = fd;
+  write->offset = offset;
+  write->size = size;
+  write->old_data = calloc(1, size); // 越过文件末尾的部分按 0 处理
+  write->new_data = malloc(size);
+  pread(fd, write->old_data, size, offset);
+  memcpy(write->new_data, buffer, size);
+  return pwrite(fd, buffer, size, offset);
+}
+
+// 刷盘之前的写都已落盘; 真正的 fsync 不影响模拟结果, 跳过以加快测试
+static int shim_fsync(int fd)
+{
+  shim_boundary();
+  shim_clear_pending();
+  return 0;
+}
+
+static const IoMethods shim_methods = {pread, shim_pwrite, shim_fsync, shim_fsync};
+
+static void generate_ops(Op *ops, uint32_t num_ops, unsigned int seed)
+{
+  for (uint32_t i = 0; i < num_ops; i++)
+  {
+    uint32_t choice = rand_r(&seed) % 10;
+    ops[i].type = choice < 6 ? OP_INSERT : choice < 9 ? OP_DELETE : OP_SELECT;
+    ops[i].id = 1 + rand_r(&seed) % MAX_ID;
+    ops[i].email_len = 1 + rand_r(&seed) % (COLUMN_EMAIL_SIZE - 1);
+  }
+}
+
+static uint64_t model_num_rows(Model *model)
+{
+  uint64_t num_rows = 0;
+  for (uint32_t id = 1; id <= MAX_ID; id++)
+  {
+    num_rows += model->present[id];
+  }
+  return num_rows;
+}
+
+// 执行前 count 条语句后的模型
+static void model_replay(Model *model, Op *ops, int64_t count)
+{
+  memset(model, 0, sizeof(Model));
+  for (int64_t i = 0; i < count; i++)
+  {
+    Op *op = &ops[i];
+    if (op->type == OP_INSERT && !model->present[op->id])
+    {
+      model->present[op->id] = true;
+      model->email_len[op->id] = op->email_len;
+    }
+    else if (op->type == OP_DELETE)
+    {
+      model->present[op->id] = false;
+    }
+  }
+}
+
+static void make_email(uint64_t id, uint32_t email_len, char *email)
+{
+  for (uint32_t i = 0; i < email_len; i++)
+  {
+    email[i] = 'a' + (id * 7 + i) % 26;
+  }
+  email[email_len] = '\0';
+}
+
+static void discard_row(Row *row, void *arg)
+{
+}
+
+static ExecuteResult run_sql(Table *table, const char *sql)
+{
+  Statement statement;
+  if (prepare_statement(sql, &statement) != PREPARE_SUCCESS)
+  {
+    printf("error: unable to prepare '%s'\n", sql);
+    exit(EXIT_FAILURE);
+  }
+  statement.row_sink = discard_row;
+  page_cache_unpin_all();
+  return execute_statement(&statement, table);
+}
+
+static void run_op(Table *table, Op *op)
+{
+  char sql[COLUMN_EMAIL_SIZE + 64];
+  switch (op->type)
+  {
+  case OP_INSERT:
+  {
+    char email[COLUMN_EMAIL_SIZE];
+    make_email(op->id, op->email_len, email);
+    snprintf(sql, sizeof(sql), "insert %u u%u %s", op->id, op->id, email);
+    break;
+  }
+  case OP_DELETE:
+    snprintf(sql, sizeof(sql), "delete %u", op->id);
+    break;
+  case OP_SELECT:
+    snprintf(sql, sizeof(sql), op->id % 2 ? "select where id = %u" : "select", op->id);
+    break;
+  }
+  run_sql(table, sql);
+}
+
+static Table *open_new_db(Config *config)
+{
+  unlink(db_path);
+  pager_set_commit_mode(config->mode);
+  pager_set_page_size(config->page_size);
+  page_cache_set_budget(24 * config->page_size); // 缓存很小, 事务中途也会淘汰写回
+  return db_open_keyed(db_path, KEY_TYPE_INTEGER);
+}
+
+// 执行 ops, 每次提交后把已提交的语句数写入 report_fd
+static void run_workload(Config *config, Op *ops, uint32_t num_ops, int report_fd)
+{
+  Table *table = open_new_db(config);
+  for (uint32_t i = 0; i < num_ops; i++)
+  {
+    run_op(table, &ops[i]);
+    if ((i + 1) % config->group == 0 || i + 1 == num_ops)
+    {
+      pager_commit(table->pager);
+      uint32_t committed = i + 1;
+      write(report_fd, &committed, sizeof(committed));
+    }
+  }
+  db_close(table);
+}
+
+// ---- 检查 ----
+
+typedef struct {
+  Pager *pager;
+  uint8_t *used;       // 每页被引用的次数
+  uint32_t *leaves;    // 按 key 顺序的叶子页号
+  uint32_t num_leaves;
+  uint32_t leaf_depth;
+  uint64_t num_rows;
+} Checker;
+
+static bool check_fail(const char *message, uint32_t page_num)
+{
+  printf("check failed: %s (page %u)\n", message, page_num);
+  return false;
+}
+
+static bool check_use_page(Checker *checker, uint32_t page_num)
+{
+  if (page_num == 0 || page_num >= checker->pager->num_pages)
+  {
+    return check_fail("page number out of range", page_num);
+  }
+  if (checker->used[page_num]++)
+  {
+    return check_fail("page referenced twice", page_num);
+  }
+  return true;
+}
+
+static bool check_overflow(Checker *checker, uint32_t page_num)
+{
+  while (page_num != 0)
+  {
+    if (!check_use_page(checker, page_num))
+    {
+      return false;
+    }
+    page_num = *(uint32_t *)get_page(checker->pager, page_num);
+  }
+  return true;
+}
+
+// 子树中的 key 都在 (low, high] 内
+static bool check_node(Checker *checker, uint32_t page_num, uint32_t parent, uint32_t depth,
+                       uint64_t low, uint64_t high, bool bounded)
+{
+  if (!check_use_page(checker, page_num))
+  {
+    return false;
+  }
+  void *node = get_page(checker->pager, page_num);
+  if (is_node_root(node) != (parent == 0) || (parent != 0 && *node_parent(node) != parent))
+  {
+    return check_fail("bad root flag or parent pointer", page_num);
+  }
+
+  if (get_node_type(node) == NODE_LEAF)
+  {
+    uint32_t num_cells = *leaf_node_num_cells(node);
+    if (num_cells > LEAF_NODE_MAX_CELLS)
+    {
+      return check_fail("too many cells", page_num);
+    }
+    for (uint32_t i = 0; i < num_cells; i++)
+    {
+      uint64_t key = *leaf_node_key(node, i);
+      if ((i > 0 && key <= *leaf_node_key(node, i - 1)) || key <= low || (bounded && key > high))
+      {
+        return check_fail("leaf key out of order", page_num);
+      }
+      if (!check_overflow(checker, *leaf_node_overflow(node, i)))
+      {
+        return false;
+      }
+    }
+    if (checker->num_leaves > 0 && depth != checker->leaf_depth)
+    {
+      return check_fail("leaves at different depths", page_num);
+    }
+    checker->leaf_depth = depth;
+    checker->leaves[checker->num_leaves++] = page_num;
+    checker->num_rows += num_cells;
+    return true;
+  }
+
+  if (get_node_type(node) != NODE_INTERNAL)
+  {
+    return check_fail("bad node type", page_num);
+  }
+  uint32_t num_keys = *internal_node_num_keys(node);
+  if (num_keys == 0 || num_keys > INTERNAL_NODE_MAX_CELLS)
+  {
+    return check_fail("bad key count", page_num);
+  }
+  uint64_t child_low = low;
+  for (uint32_t i = 0; i <= num_keys; i++)
+  {
+    bool last = (i == num_keys);
+    uint64_t key = last ? high : *internal_node_key(node, i);
+    if (!last && (key <= child_low || (bounded && key > high)))
+    {
+      return check_fail("internal key out of order", page_num);
+    }
+    uint32_t child = last ? *internal_node_right_child(node) : *internal_node_child(node, i);
+    if (!check_node(checker, child, page_num, depth + 1, child_low, key, bounded || !last))
+    {
+      return false;
+    }
+    child_low = key;
+  }
+  return true;
+}
+
+static bool check_freelist(Checker *checker, DbHeader *header)
+{
+  uint32_t count = 0;
+  uint32_t trunk_num = header->freelist_trunk;
+  while (trunk_num != 0)
+  {
+    if (!check_use_page(checker, trunk_num))
+    {
+      return false;
+    }
+    void *trunk = get_page(checker->pager, trunk_num);
+    uint32_t num_leaves = *(uint32_t *)(trunk + FREELIST_TRUNK_COUNT_OFFSET);
+    uint32_t *leaves = trunk + FREELIST_TRUNK_HEADER_SIZE;
+    for (uint32_t i = 0; i < num_leaves; i++)
+    {
+      if (!check_use_page(checker, leaves[i]))
+      {
+        return false;
+      }
+    }
+    count += 1 + num_leaves;
+    trunk_num = *(uint32_t *)(trunk + FREELIST_TRUNK_NEXT_OFFSET);
+  }
+  if (count != header->freelist_count)
+  {
+    printf("check failed: freelist has %u pages, header says %u\n", count, header->freelist_count);
+    return false;
+  }
+  return true;
+}
+
+static bool check_tree(Table *table)
+{
+  Pager *pager = table->pager;
+  Checker checker = {.pager = pager};
+  checker.used = calloc(pager->num_pages + 1, 1);
+  checker.leaves = malloc((pager->num_pages + 1) * sizeof(uint32_t));
+  page_cache_unpin_all();
+  DbHeader header = *pager_header(pager);
+
+  bool ok = check_node(&checker, table->root_page_num, 0, 1, 0, 0, false) && check_freelist(&checker, &header);
+  for (uint32_t i = 0; ok && i < checker.num_leaves; i++)
+  {
+    uint32_t next = i + 1 < checker.num_leaves ? checker.leaves[i + 1] : 0;
+    if (*leaf_node_next_leaf(get_page(pager, checker.leaves[i])) != next)
+    {
+      ok = check_fail("broken leaf chain", checker.leaves[i]);
+    }
+  }
+  if (ok && (checker.leaf_depth != header.tree_height || checker.num_rows != header.row_count))
+  {
+    printf("check failed: height %u rows %lu, header says %u / %lu\n",
+           checker.leaf_depth, checker.num_rows, header.tree_height, header.row_count);
+    ok = false;
+  }
+  free(checker.used);
+  free(checker.leaves);
+  return ok;
+}
+
+static bool check_row(Row *row, uint64_t id, uint32_t email_len)
+{
+  char username[COLUMN_USERNAME_SIZE];
+  char email[COLUMN_EMAIL_SIZE];
+  snprintf(username, sizeof(username), "u%lu", id);
+  make_email(id, email_len, email);
+  return row->id == id && strcmp(row->username, username) == 0 && strcmp(row->email, email) == 0;
+}
+
+static bool check_rows(Table *table, Model *model)
+{
+  page_cache_unpin_all();
+  Cursor *cursor = table_start(table);
+  uint32_t id = 0;
+  bool ok = true;
+  while (ok)
+  {
+    while (id < MAX_ID && !model->present[id + 1])
+    {
+      id += 1;
+    }
+    id += 1;
+    if (cursor->end_of_table || id > MAX_ID)
+    {
+      ok = cursor->end_of_table && id > MAX_ID;
+      break;
+    }
+    Row row;
+    cursor_row(cursor, &row, ROW_SIZE);
+    ok = check_row(&row, id, model->email_len[id]);
+    cursor_advance(cursor);
+  }
+  free(cursor);
+  return ok;
+}
+
+// 库的内容等于 models 中的某一个, 之后继续插入并重新打开也正常
+static bool check_recovered(Model *models, uint32_t num_models)
+{
+  Table *table = db_open_keyed(db_path, KEY_TYPE_INTEGER);
+  bool ok = check_tree(table);
+  Model *matched = NULL;
+  for (uint32_t i = 0; ok && matched == NULL && i < num_models; i++)
+  {
+    matched = check_rows(table, &models[i]) ? &models[i] : NULL;
+  }
+  if (ok && matched == NULL)
+  {
+    printf("check failed: rows match neither the last nor the next commit\n");
+    ok = false;
+  }
+  if (!ok)
+  {
+    return false;
+  }
+
+  char sql[64];
+  for (uint32_t i = 1; i <= EXTRA_ROWS; i++)
+  {
+    snprintf(sql, sizeof(sql), "insert %u u%u x", MAX_ID + i, MAX_ID + i);
+    if (run_sql(table, sql) != EXECUTE_SUCCESS)
+    {
+      printf("check failed: insert after recovery\n");
+      return false;
+    }
+  }
+  db_close(table);
+  table = db_open_keyed(db_path, KEY_TYPE_INTEGER);
+  ok = check_tree(table) && pager_header(table->pager)->row_count == EXTRA_ROWS + model_num_rows(matched);
+  db_close(table);
+  return ok;
+}
+
+// ---- 驱动 ----
+
+#define WORKLOAD_DONE UINT32_MAX
+
+/*
+  在第 crash_at 个边界处崩溃并检查恢复结果; 负载在到达该边界之前执行完时 finished 置为 true
+*/
+static bool crash_point(Config *config, Op *ops, uint32_t num_ops, uint64_t crash_at, bool *finished)
+{
+  int fds[2];
+  if (pipe(fds) == -1)
+  {
+    printf("error: pipe failed!\n");
+    exit(EXIT_FAILURE);
+  }
+  pid_t pid = fork();
+  if (pid == 0)
+  {
+    close(fds[0]);
+    shim.crash_at = crash_at;
+    shim.seed = crash_at * 2654435761u;
+    io_set_methods(&shim_methods);
+    run_workload(config, ops, num_ops, fds[1]);
+    uint32_t done = WORKLOAD_DONE;
+    write(fds[1], &done, sizeof(done));
+    _exit(EXIT_SUCCESS);
+  }
+  close(fds[1]);
+  uint32_t committed = 0;
+  uint32_t report;
+  *finished = false;
+  while (read(fds[0], &report, sizeof(report)) == sizeof(report))
+  {
+    if (report == WORKLOAD_DONE)
+    {
+      *finished = true;
+    }
+    else
+    {
+      committed = report;
+    }
+  }
+  close(fds[0]);
+  int status;
+  waitpid(pid, &status, 0);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+  {
+    printf("%s: workload failed at crash point %lu\n", config->name, crash_at);
+    return false;
+  }
+
+  // 已确认的提交一定可见; 崩溃发生在下一次提交的刷盘之后、确认之前时, 下一次提交也可能可见
+  Model models[2];
+  uint32_t next = committed + config->group < num_ops ? committed + config->group : num_ops;
+  model_replay(&models[0], ops, committed);
+  model_replay(&models[1], ops, next);
+
+  pid = fork();
+  if (pid == 0)
+  {
+    _exit(check_recovered(models, *finished ? 1 : 2) ? EXIT_SUCCESS : EXIT_FAILURE);
+  }
+  waitpid(pid, &status, 0);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+  {
+    printf("%s: recovery failed at crash point %lu (%u statements committed)\n", config->name, crash_at, committed);
+    return false;
+  }
+  return true;
+}
+
+static bool crash_test(Config *config, unsigned int seed, uint32_t num_ops, uint32_t stride)
+{
+  Op *ops = malloc(num_ops * sizeof(Op));
+  generate_ops(ops, num_ops, seed);
+  bool finished = false;
+  uint64_t crash_at = 1;
+  uint32_t crash_points = 0;
+  while (!finished)
+  {
+    if (!crash_point(config, ops, num_ops, crash_at, &finished))
+    {
+      printf("%s: seed %u\n", config->name, seed);
+      free(ops);
+      return false;
+    }
+    crash_points += 1;
+    crash_at += stride;
+  }
+  printf("%s, seed %u: %u crash points recovered\n", config->name, seed, crash_points);
+  free(ops);
+  return true;
+}
+
+// 不注入故障, 使用真实的刷盘, 结束后同样检查结果
+static bool throughput_test(Config *config, unsigned int seed, uint32_t num_ops)
+{
+  Op *ops = malloc(num_ops * sizeof(Op));
+  generate_ops(ops, num_ops, seed);
+  uint64_t start = now_us();
+  pid_t pid = fork();
+  if (pid == 0)
+  {
+    int null_fd = open("/dev/null", O_WRONLY);
+    run_workload(config, ops, num_ops, null_fd);
+    _exit(EXIT_SUCCESS);
+  }
+  int status;
+  waitpid(pid, &status, 0);
+  uint64_t elapsed = now_us() - start;
+
+  Model model;
+  model_replay(&model, ops, num_ops);
+  free(ops);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+  {
+    printf("%s: workload failed\n", config->name);
+    return false;
+  }
+  pid = fork();
+  if (pid == 0)
+  {
+    _exit(check_recovered(&model, 1) ? EXIT_SUCCESS : EXIT_FAILURE);
+  }
+  waitpid(pid, &status, 0);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+  {
+    printf("%s: final state check failed\n", config->name);
+    return false;
+  }
+  printf("throughput %-24s %8.0f statements/s\n", config->name, num_ops * 1e6 / (elapsed ? elapsed : 1));
+  return true;
+}
+
+int main(int argc, char *argv[])
+{
+  uint32_t seeds = 1;
+  uint32_t stride = 1;
+  uint32_t num_ops = 200;
+  for (int i = 1; i < argc; i++)
+  {
+    if (sscanf(argv[i], "--seeds=%u", &seeds) != 1 && sscanf(argv[i], "--stride=%u", &stride) != 1 &&
+        sscanf(argv[i], "--ops=%u", &num_ops) != 1)
+    {
+      printf("usage: crash-test [--seeds=N] [--stride=N] [--ops=N]\n");
+      return EXIT_FAILURE;
+    }
+  }
+  if (stride == 0 || num_ops == 0)
+  {
+    printf("error: stride and ops must be positive!\n");
+    return EXIT_FAILURE;
+  }
+
+  char dir[] = "/tmp/crash-test-XXXXXX";
+  if (mkdtemp(dir) == NULL)
+  {
+    printf("error: unable to create temp dir!\n");
+    return EXIT_FAILURE;
+  }
+  snprintf(db_path, sizeof(db_path), "%s/test.db", dir);
+
+  Config crash_configs[] = {
+      {"shadow 4KB autocommit", COMMIT_SHADOW, 4096, 1},
+      {"shadow 4KB group of 8", COMMIT_SHADOW, 4096, 8},
+      {"shadow 16KB autocommit", COMMIT_SHADOW, 16384, 1},
+  };
+  Config throughput_configs[] = {
+      {"in-place", COMMIT_IN_PLACE, 4096, 1},
+      {"shadow autocommit", COMMIT_SHADOW, 4096, 1},
+      {"shadow group of 32", COMMIT_SHADOW, 4096, 32},
+  };
+
+  bool ok = true;
+  for (uint32_t seed = 1; ok && seed <= seeds; seed++)
+  {
+    for (uint32_t i = 0; ok && i < sizeof(crash_configs) / sizeof(Config); i++)
+    {
+      ok = crash_test(&crash_configs[i], seed * 100 + i, num_ops, stride);
+    }
+  }
+  for (uint32_t i = 0; ok && i < sizeof(throughput_configs) / sizeof(Config); i++)
+  {
+    ok = throughput_test(&throughput_configs[i], 1, num_ops * 10);
+  }
+
+  unlink(db_path);
+  rmdir(dir);
+  printf(ok ? "crash test passed\n" : "crash test FAILED\n");
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,168 @@
+#include "../include/page_cache.h"
+#include "../include/secondary_index.h"
+#include "../include/statement.h"
+
+/*
+  二级索引测试:
+  - 被索引的列取最大长度 (email 255 字节、username 32 字节, 末尾没有 '\0'), key 为 列值 + '\0' + id,
+    正好用满 TEXT_KEY_MAX_SIZE;
+  - 分别建立普通索引和覆盖索引, 插入列值相同与不同的行, 按列值查找得到的 id 与整行内容正确;
+  - 删除后索引同步更新, 关闭后重新打开结果不变
+*/
+
+#define SAME_VALUE_ROWS 5
+#define DISTINCT_ROWS   200
+
+typedef struct {
+  uint64_t ids[SAME_VALUE_ROWS + DISTINCT_ROWS];
+  uint32_t num_ids;
+  const char *username;
+  const char *email;
+  bool ok;
+} Lookup;
+
+static Row make_row(uint64_t id, char fill)
+{
+  Row row;
+  row.id = id;
+  memset(row.username, fill, COLUMN_USERNAME_SIZE);
+  memset(row.email, fill, COLUMN_EMAIL_SIZE);
+  row.username[0] = 'u';
+  row.email[COLUMN_EMAIL_SIZE - 1] = 'e';
+  return row;
+}
+
+static void run_statement(Table *table, Statement *statement)
+{
+  page_cache_unpin_all();
+  if (execute_statement(statement, table) != EXECUTE_SUCCESS)
+  {
+    printf("error: statement failed\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+static void insert_row(Table *table, Row *row)
+{
+  Statement statement;
+  memset(&statement, 0, sizeof(statement));
+  statement.type = STATEMENT_INSERT;
+  statement.row_to_insert = *row;
+  run_statement(table, &statement);
+}
+
+static void delete_row(Table *table, uint64_t id)
+{
+  Statement statement;
+  char sql[64];
+  snprintf(sql, sizeof(sql), "delete %lu", id);
+  if (prepare_statement(sql, &statement) != PREPARE_SUCCESS)
+  {
+    printf("error: unable to prepare '%s'\n", sql);
+    exit(EXIT_FAILURE);
+  }
+  run_statement(table, &statement);
+}
+
+static void collect_row(Row *row, void *arg)
+{
+  Lookup *lookup = arg;
+  if (strncmp(row->username, lookup->username, COLUMN_USERNAME_SIZE) != 0 ||
+      strncmp(row->email, lookup->email, COLUMN_EMAIL_SIZE) != 0)
+  {
+    printf("check failed: row %lu does not match the indexed value\n", row->id);
+    lookup->ok = false;
+  }
+  lookup->ids[lookup->num_ids++] = row->id;
+}
+
+// 按 row 的索引列查找, 期望得到 ids[0..num_ids) (按 id 递增)
+static bool check_lookup(Table *table, const ColumnInfo *column, Row *row, uint64_t *ids, uint32_t num_ids)
+{
+  // 查找值需以 '\0' 结尾
+  char value[COLUMN_EMAIL_SIZE + 1] = {0};
+  memcpy(value, (char *)row + column->offset, column->size);
+  Lookup lookup = {.username = row->username, .email = row->email, .ok = true};
+  page_cache_unpin_all();
+  uint32_t num_rows = secondary_index_lookup(table, value, collect_row, &lookup);
+  if (!lookup.ok)
+  {
+    return false;
+  }
+  if (num_rows != num_ids || lookup.num_ids != num_ids || memcmp(lookup.ids, ids, num_ids * sizeof(uint64_t)) != 0)
+  {
+    printf("check failed: %s lookup returned %u rows, expected %u\n", column->name, num_rows, num_ids);
+    return false;
+  }
+  return true;
+}
+
+// 相同列值的行 id 为 1..SAME_VALUE_ROWS; 其余每行列值不同, 删除 id 为偶数的行之后再检查一遍
+static bool index_test(const char *db_path, const char *column_name, uint32_t include)
+{
+  unlink(db_path);
+  Table *table = db_open(db_path);
+  const ColumnInfo *column = find_column(row_columns, row_num_columns, column_name);
+  if (!secondary_index_create(table, column, include))
+  {
+    printf("error: unable to create index on %s\n", column_name);
+    exit(EXIT_FAILURE);
+  }
+
+  Row same = make_row(0, 'a');
+  uint64_t same_ids[SAME_VALUE_ROWS];
+  for (uint32_t i = 0; i < SAME_VALUE_ROWS; i++)
+  {
+    same.id = same_ids[i] = i + 1;
+    insert_row(table, &same);
+  }
+  for (uint32_t i = 0; i < DISTINCT_ROWS; i++)
+  {
+    Row row = make_row(1000 + i, 'b' + i % 24);
+    row.username[1] = row.email[1] = '0' + i / 24;
+    insert_row(table, &row);
+  }
+
+  bool ok = check_lookup(table, column, &same, same_ids, SAME_VALUE_ROWS);
+  for (uint32_t i = 0; ok && i < DISTINCT_ROWS; i++)
+  {
+    Row row = make_row(1000 + i, 'b' + i % 24);
+    row.username[1] = row.email[1] = '0' + i / 24;
+    ok = check_lookup(table, column, &row, &row.id, 1);
+  }
+
+  delete_row(table, 2);
+  uint64_t remaining_ids[] = {1, 3, 4, 5};
+  ok = ok && check_lookup(table, column, &same, remaining_ids, 4);
+  db_close(table);
+
+  table = db_open(db_path);
+  ok = ok && check_lookup(table, column, &same, remaining_ids, 4);
+  db_close(table);
+  printf("%s index%s: %s\n", column_name, include ? " (covering)" : "", ok ? "ok" : "FAILED");
+  return ok;
+}
+
+int main(int argc, char *argv[])
+{
+  char dir[] = "/tmp/index-test-XXXXXX";
+  if (mkdtemp(dir) == NULL)
+  {
+    printf("error: unable to create temp dir!\n");
+    return EXIT_FAILURE;
+  }
+  char db_path[sizeof(dir) + 16];
+  snprintf(db_path, sizeof(db_path), "%s/test.db", dir);
+
+  const ColumnInfo *username = find_column(row_columns, row_num_columns, "username");
+  const ColumnInfo *email = find_column(row_columns, row_num_columns, "email");
+  bool ok = index_test(db_path, "email", 0) &&
+            index_test(db_path, "email", 1u << (username - row_columns)) &&
+            index_test(db_path, "username", 0) &&
+            index_test(db_path, "username", 1u << (email - row_columns));
+
+  unlink(db_path);
+  rmdir(dir);
+  printf(ok ? "index test passed\n" : "index test FAILED\n");
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,94 @@
+#include "../include/page_cache.h"
+#include "../include/statement.h"
+
+/*
+  页大小测试:
+  - 新建 16KB 页的数据库, 关闭后再以默认页大小新建并保持打开另一个数据库;
+  - 此时打开 16KB 页的数据库以及格式错误的文件都返回 NULL, 不会退出进程;
+  - 已打开的数据库不受影响, 仍可继续读写
+*/
+
+static bool run_sql(Table *table, const char *sql)
+{
+  Statement statement;
+  if (prepare_statement(sql, &statement) != PREPARE_SUCCESS)
+  {
+    printf("error: unable to prepare '%s'\n", sql);
+    exit(EXIT_FAILURE);
+  }
+  page_cache_unpin_all();
+  return execute_statement(&statement, table) == EXECUTE_SUCCESS;
+}
+
+static bool create_db(const char *db_path, uint32_t page_size)
+{
+  unlink(db_path);
+  pager_set_page_size(page_size);
+  Table *table = db_open(db_path);
+  if (table == NULL)
+  {
+    printf("check failed: unable to create %s with %u byte pages\n", db_path, page_size);
+    return false;
+  }
+  bool ok = run_sql(table, "insert 1 u1 e1");
+  db_close(table);
+  return ok;
+}
+
+static bool page_size_test(const char *dir)
+{
+  char big_path[64], small_path[64], bad_path[64];
+  snprintf(big_path, sizeof(big_path), "%s/big.db", dir);
+  snprintf(small_path, sizeof(small_path), "%s/small.db", dir);
+  snprintf(bad_path, sizeof(bad_path), "%s/bad.db", dir);
+
+  // 格式错误的文件: 不足一页
+  int fd = open(bad_path, O_RDWR | O_CREAT | O_TRUNC, S_IWUSR | S_IRUSR);
+  bool ok = fd != -1 && write(fd, "not a db", 8) == 8;
+  close(fd);
+
+  ok = ok && create_db(big_path, PAGE_SIZE_MIN * 4) && create_db(small_path, PAGE_SIZE_MIN);
+  Table *table = ok ? db_open(small_path) : NULL;
+  if (table == NULL)
+  {
+    printf("check failed: unable to open %s\n", small_path);
+    return false;
+  }
+  if (db_open(big_path) != NULL)
+  {
+    printf("check failed: opened a db with a different page size\n");
+    ok = false;
+  }
+  if (db_open(bad_path) != NULL)
+  {
+    printf("check failed: opened a malformed db file\n");
+    ok = false;
+  }
+  if (!run_sql(table, "insert 2 u2 e2") || !run_sql(table, "select where id = 1"))
+  {
+    printf("check failed: the opened db is not usable\n");
+    ok = false;
+  }
+  db_close(table);
+
+  unlink(big_path);
+  unlink(small_path);
+  unlink(bad_path);
+  return ok;
+}
+
+int main(int argc, char *argv[])
+{
+  char dir[] = "/tmp/page-size-test-XXXXXX";
+  if (mkdtemp(dir) == NULL)
+  {
+    printf("error: unable to create temp dir!\n");
+    return EXIT_FAILURE;
+  }
+
+  bool ok = page_size_test(dir);
+
+  rmdir(dir);
+  printf(ok ? "page size test passed\n" : "page size test FAILED\n");
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,161 @@
+#include "../include/page_cache.h"
+#include "../include/statement.h"
+#include "../include/tree_node.h"
+
+/*
+  B+ 树布局测试:
+  tree-test [--rows=N]
+  - 按 id 递增顺序插入 N 行, 全部走追加快速路径, 叶子和内部节点都在最右路径末尾分裂;
+  - 检查除每层最右节点外, 叶子和内部节点都按 90/10 分裂保持接近写满,
+    文件头树高不超过按该填充率装满所需的层数;
+  - 关闭后重新打开, 行数与树高不变
+*/
+
+#define DEFAULT_ROWS 60000
+
+typedef struct {
+  uint32_t leaves;
+  uint32_t internal_nodes;
+  uint32_t height;
+} Layout;
+
+static bool check_fail(const char *message, uint32_t page_num)
+{
+  printf("check failed: %s (page %u)\n", message, page_num);
+  return false;
+}
+
+static void run_sql(Table *table, const char *sql)
+{
+  Statement statement;
+  if (prepare_statement(sql, &statement) != PREPARE_SUCCESS)
+  {
+    printf("error: unable to prepare '%s'\n", sql);
+    exit(EXIT_FAILURE);
+  }
+  page_cache_unpin_all();
+  if (execute_statement(&statement, table) != EXECUTE_SUCCESS)
+  {
+    printf("error: '%s' failed\n", sql);
+    exit(EXIT_FAILURE);
+  }
+}
+
+// rightmost: 节点位于树的最右路径上, 只有这些节点允许不满
+static bool check_fill(Pager *pager, uint32_t page_num, bool rightmost, uint32_t depth, Layout *layout)
+{
+  void *node = get_page(pager, page_num);
+  if (get_node_type(node) == NODE_LEAF)
+  {
+    layout->leaves += 1;
+    layout->height = depth;
+    if (!rightmost && *leaf_node_num_cells(node) < LEAF_NODE_APPEND_LEFT_SPLIT_COUNT)
+    {
+      return check_fail("leaf is less than 90% full", page_num);
+    }
+    return true;
+  }
+
+  layout->internal_nodes += 1;
+  uint32_t num_keys = *internal_node_num_keys(node);
+  if (!rightmost && num_keys + 1 < INTERNAL_NODE_APPEND_LEFT_SPLIT_COUNT)
+  {
+    return check_fail("internal node is less than 90% full", page_num);
+  }
+  for (uint32_t i = 0; i <= num_keys; i++)
+  {
+    node = get_page(pager, page_num);
+    if (!check_fill(pager, *internal_node_child(node, i), rightmost && i == num_keys, depth + 1, layout))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+// 每个节点按 90/10 装满时 num_rows 行所需的层数
+static uint32_t expected_height(uint64_t num_rows)
+{
+  uint64_t count = (num_rows + LEAF_NODE_APPEND_LEFT_SPLIT_COUNT - 1) / LEAF_NODE_APPEND_LEFT_SPLIT_COUNT;
+  uint32_t height = 1;
+  while (count > 1)
+  {
+    count = (count + INTERNAL_NODE_APPEND_LEFT_SPLIT_COUNT - 1) / INTERNAL_NODE_APPEND_LEFT_SPLIT_COUNT;
+    height += 1;
+  }
+  return height;
+}
+
+static bool sequential_load_test(const char *db_path, uint32_t num_rows)
+{
+  unlink(db_path);
+  Table *table = db_open(db_path);
+  char sql[64];
+  for (uint32_t id = 1; id <= num_rows; id++)
+  {
+    snprintf(sql, sizeof(sql), "insert %u u%u e%u", id, id, id);
+    run_sql(table, sql);
+  }
+
+  page_cache_unpin_all();
+  Layout layout = {0};
+  bool ok = check_fill(table->pager, table->root_page_num, true, 1, &layout);
+  DbHeader header = *pager_header(table->pager);
+  if (ok && (layout.height != header.tree_height || header.row_count != num_rows))
+  {
+    printf("check failed: height %u, header says %u / %lu rows\n", layout.height, header.tree_height, header.row_count);
+    ok = false;
+  }
+  if (ok && layout.height > expected_height(num_rows))
+  {
+    printf("check failed: height %u, expected at most %u\n", layout.height, expected_height(num_rows));
+    ok = false;
+  }
+  uint32_t num_pages = table->pager->num_pages;
+  db_close(table);
+  if (!ok)
+  {
+    return false;
+  }
+
+  table = db_open(db_path);
+  header = *pager_header(table->pager);
+  db_close(table);
+  if (header.tree_height != layout.height || header.row_count != num_rows)
+  {
+    printf("check failed: reopened with height %u / %lu rows\n", header.tree_height, header.row_count);
+    return false;
+  }
+  printf("sequential load of %u rows: height %u, %u leaves, %u internal nodes, %u pages\n",
+         num_rows, layout.height, layout.leaves, layout.internal_nodes, num_pages);
+  return true;
+}
+
+int main(int argc, char *argv[])
+{
+  uint32_t num_rows = DEFAULT_ROWS;
+  for (int i = 1; i < argc; i++)
+  {
+    if (sscanf(argv[i], "--rows=%u", &num_rows) != 1)
+    {
+      printf("usage: tree-test [--rows=N]\n");
+      return EXIT_FAILURE;
+    }
+  }
+
+  char dir[] = "/tmp/tree-test-XXXXXX";
+  if (mkdtemp(dir) == NULL)
+  {
+    printf("error: unable to create temp dir!\n");
+    return EXIT_FAILURE;
+  }
+  char db_path[sizeof(dir) + 16];
+  snprintf(db_path, sizeof(db_path), "%s/test.db", dir);
+
+  bool ok = sequential_load_test(db_path, num_rows);
+
+  unlink(db_path);
+  rmdir(dir);
+  printf(ok ? "tree test passed\n" : "tree test FAILED\n");
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,319 @@
+#include <errno.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+
+#include "../include/protocol.h"
+#include "../include/statement.h"
+
+/*
+  服务端压测客户端:
+  db-loadgen <socket> [--clients=N] [--ops=N] [--read=百分比] [--batch=N] [--start=ID]
+  每个客户端一个线程、一条连接, 预编译 insert / 点查后按比例混合执行:
+  - 插入的 id 为 start + 客户端编号 + 客户端数 * n, 各客户端互不重复;
+  - 点查从本客户端已插入的 id 中随机选取;
+  - batch > 1 时插入以 BATCH 发送, 每个请求包含 batch 行。
+  结束后输出总吞吐 (行 / 秒) 和请求延迟分位数
+*/
+
+typedef struct
+{
+  const char *socket_path;
+  uint32_t client_num;
+  uint32_t clients;
+  uint32_t ops;
+  uint32_t read_percent;
+  uint32_t batch;
+  uint64_t start_id;
+
+  uint32_t *latencies_us; // 每个请求的延迟
+  uint32_t num_requests;
+  uint32_t rows_written;
+  uint32_t rows_read;
+  uint32_t failures;
+} Client;
+
+static uint64_t now_us()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int client_connect(const char *socket_path)
+{
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, socket_path, sizeof(address.sun_path) - 1);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd == -1 || connect(fd, (struct sockaddr *)&address, sizeof(address)) == -1)
+  {
+    printf("error: connect %s failed: %s\n", socket_path, strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+  return fd;
+}
+
+static void send_all(int fd, ByteBuffer *request)
+{
+  size_t sent = 0;
+  while (sent < request->length)
+  {
+    ssize_t n = send(fd, request->data + sent, request->length - sent, MSG_NOSIGNAL);
+    if (n <= 0)
+    {
+      ERROR("send failed!");
+      exit(EXIT_FAILURE);
+    }
+    sent += n;
+  }
+  request->length = 0;
+}
+
+// 阻塞读取下一帧, 返回帧类型; 上一帧在下次调用时才从缓冲区移除
+static uint8_t receive_frame(int fd, ByteBuffer *input, size_t *consumed, FrameReader *reader)
+{
+  buffer_consume(input, *consumed);
+  size_t frame_size;
+  while ((frame_size = frame_complete(input->data, input->length)) == 0)
+  {
+    buffer_reserve(input, 64 * 1024);
+    ssize_t n = recv(fd, input->data + input->length, input->capacity - input->length, 0);
+    if (n <= 0)
+    {
+      ERROR("connection closed by server!");
+      exit(EXIT_FAILURE);
+    }
+    input->length += n;
+  }
+  *consumed = frame_size;
+  reader_init(reader, input->data + PROTOCOL_LENGTH_SIZE, frame_size - PROTOCOL_LENGTH_SIZE);
+  return reader_u8(reader);
+}
+
+// 读取响应直到 DONE / OK / PREPARED / ERROR, 返回最后一帧的类型
+static uint8_t receive_response(Client *client, int fd, ByteBuffer *input, size_t *consumed, FrameReader *reader)
+{
+  while (true)
+  {
+    uint8_t type = receive_frame(fd, input, consumed, reader);
+    if (type == FRAME_ROW)
+    {
+      client->rows_read += 1;
+      continue;
+    }
+    if (type == FRAME_ERROR)
+    {
+      client->failures += 1;
+    }
+    return type;
+  }
+}
+
+static uint32_t client_prepare(Client *client, int fd, ByteBuffer *request, ByteBuffer *input, size_t *consumed,
+                               const char *sql)
+{
+  size_t frame = frame_begin(request, FRAME_PREPARE);
+  buffer_put(request, sql, strlen(sql));
+  frame_end(request, frame);
+  send_all(fd, request);
+
+  FrameReader reader;
+  if (receive_response(client, fd, input, consumed, &reader) != FRAME_PREPARED)
+  {
+    printf("error: prepare '%s' failed!\n", sql);
+    exit(EXIT_FAILURE);
+  }
+  return reader_u32(&reader);
+}
+
+static void put_insert_params(Client *client, ByteBuffer *request, uint64_t id)
+{
+  char text[64];
+  buffer_put_u8(request, PARAM_INT);
+  buffer_put_u64(request, id);
+  buffer_put_u8(request, PARAM_TEXT);
+  buffer_put_text(request, text, snprintf(text, sizeof(text), "user%lu", id));
+  buffer_put_u8(request, PARAM_TEXT);
+  buffer_put_text(request, text, snprintf(text, sizeof(text), "user%lu@example.com", id));
+}
+
+static void *client_run(void *arg)
+{
+  Client *client = arg;
+  int fd = client_connect(client->socket_path);
+  ByteBuffer request = {0};
+  ByteBuffer input = {0};
+  size_t consumed = 0;
+  FrameReader reader;
+
+  uint32_t insert_id = client_prepare(client, fd, &request, &input, &consumed, "insert ? ? ?");
+  uint32_t select_id = client_prepare(client, fd, &request, &input, &consumed, "select where id = ?");
+  unsigned int seed = client->client_num * 7919 + 1;
+  client->latencies_us = malloc(sizeof(uint32_t) * (client->ops + 1));
+
+  uint32_t done = 0;
+  uint32_t inserted = 0;
+  while (done < client->ops)
+  {
+    uint64_t start_us = now_us();
+    if (inserted > 0 && (uint32_t)(rand_r(&seed) % 100) < client->read_percent)
+    {
+      // BIND + STEP 一起发出, 读取两个响应
+      uint64_t n = rand_r(&seed) % inserted;
+      size_t frame = frame_begin(&request, FRAME_BIND);
+      buffer_put_u32(&request, select_id);
+      buffer_put_u16(&request, 0);
+      buffer_put_u8(&request, PARAM_INT);
+      buffer_put_u64(&request, client->start_id + client->client_num + client->clients * n);
+      frame_end(&request, frame);
+      frame = frame_begin(&request, FRAME_STEP);
+      buffer_put_u32(&request, select_id);
+      frame_end(&request, frame);
+      send_all(fd, &request);
+
+      receive_response(client, fd, &input, &consumed, &reader);
+      if (receive_response(client, fd, &input, &consumed, &reader) == FRAME_DONE && reader_u8(&reader) != EXECUTE_SUCCESS)
+      {
+        client->failures += 1;
+      }
+      done += 1;
+    }
+    else
+    {
+      uint32_t count = client->batch;
+      if (count > client->ops - done)
+      {
+        count = client->ops - done;
+      }
+      size_t frame = frame_begin(&request, FRAME_BATCH);
+      buffer_put_u32(&request, insert_id);
+      buffer_put_u32(&request, count);
+      for (uint32_t i = 0; i < count; i++)
+      {
+        put_insert_params(client, &request, client->start_id + client->client_num + client->clients * (uint64_t)inserted++);
+      }
+      frame_end(&request, frame);
+      send_all(fd, &request);
+
+      if (receive_response(client, fd, &input, &consumed, &reader) == FRAME_DONE)
+      {
+        reader_u8(&reader);
+        uint32_t succeeded = reader_u32(&reader);
+        client->rows_written += succeeded;
+        client->failures += count - succeeded;
+      }
+      done += count;
+    }
+    client->latencies_us[client->num_requests++] = now_us() - start_us;
+  }
+
+  close(fd);
+  buffer_free(&request);
+  buffer_free(&input);
+  return NULL;
+}
+
+static int compare_u32(const void *a, const void *b)
+{
+  uint32_t x = *(const uint32_t *)a;
+  uint32_t y = *(const uint32_t *)b;
+  return (x > y) - (x < y);
+}
+
+static void usage(void)
+{
+  ERROR("usage: db-loadgen <socket> [--clients=N] [--ops=N] [--read=PCT] [--batch=N] [--start=ID]");
+  exit(EXIT_FAILURE);
+}
+
+// arg 为 name 开头时解析其后的数字写入 value; 数字不合法时打印用法并退出
+static bool parse_option(const char *arg, const char *name, uint32_t *value)
+{
+  size_t length = strlen(name);
+  if (strncmp(arg, name, length) != 0)
+  {
+    return false;
+  }
+  char *end;
+  unsigned long number = strtoul(arg + length, &end, 10);
+  if (end == arg + length || *end != '\0' || number > UINT32_MAX)
+  {
+    usage();
+  }
+  *value = number;
+  return true;
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc < 2)
+  {
+    usage();
+  }
+  uint32_t clients = 4, ops = 100000, read_percent = 50, batch = 1, start_id = 1;
+  for (int i = 2; i < argc; i++)
+  {
+    if (!parse_option(argv[i], "--clients=", &clients) &&
+        !parse_option(argv[i], "--ops=", &ops) &&
+        !parse_option(argv[i], "--read=", &read_percent) &&
+        !parse_option(argv[i], "--batch=", &batch) &&
+        !parse_option(argv[i], "--start=", &start_id))
+    {
+      usage();
+    }
+  }
+  if (clients == 0 || batch == 0)
+  {
+    ERROR("clients and batch must be positive!");
+    exit(EXIT_FAILURE);
+  }
+
+  Client *all = calloc(clients, sizeof(Client));
+  pthread_t *threads = malloc(sizeof(pthread_t) * clients);
+  uint64_t start_us = now_us();
+  for (uint32_t i = 0; i < clients; i++)
+  {
+    all[i] = (Client){.socket_path = argv[1], .client_num = i, .clients = clients,
+                      .ops = ops / clients + (i < ops % clients), .read_percent = read_percent,
+                      .batch = batch, .start_id = start_id};
+    pthread_create(&threads[i], NULL, client_run, &all[i]);
+  }
+
+  uint32_t num_requests = 0, rows_written = 0, rows_read = 0, failures = 0;
+  for (uint32_t i = 0; i < clients; i++)
+  {
+    pthread_join(threads[i], NULL);
+    num_requests += all[i].num_requests;
+    rows_written += all[i].rows_written;
+    rows_read += all[i].rows_read;
+    failures += all[i].failures;
+  }
+  uint64_t elapsed_us = now_us() - start_us;
+
+  uint32_t *latencies = malloc(sizeof(uint32_t) * (num_requests + 1));
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < clients; i++)
+  {
+    memcpy(latencies + count, all[i].latencies_us, sizeof(uint32_t) * all[i].num_requests);
+    count += all[i].num_requests;
+    free(all[i].latencies_us);
+  }
+  qsort(latencies, count, sizeof(uint32_t), compare_u32);
+
+  double seconds = elapsed_us / 1e6;
+  printf("clients: %u, requests: %u, elapsed: %.3f s\n", clients, num_requests, seconds);
+  printf("rows written: %u, rows read: %u, failures: %u\n", rows_written, rows_read, failures);
+  printf("throughput: %.0f ops/s\n", ops / (seconds > 0 ? seconds : 1));
+  if (count > 0)
+  {
+    printf("latency us: p50 %u, p95 %u, p99 %u, max %u\n", latencies[count * 50 / 100], latencies[count * 95 / 100],
+           latencies[count * 99 / 100], latencies[count - 1]);
+  }
+  free(latencies);
+  free(threads);
+  free(all);
+  return 0;
+}